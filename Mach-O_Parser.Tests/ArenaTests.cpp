@@ -0,0 +1,51 @@
+#include "Arena.h"
+#include "Decoder.h"
+#include "Fixture.h"
+#include "Test.h"
+
+TEST(arenaOversizedAllocationKeepsCurrentBlock)
+{
+	Arena arena(256);
+	char* first = static_cast<char*>(arena.allocate(16, 1));
+	char* oversized = static_cast<char*>(arena.allocate(4096, 64));
+	char* second = static_cast<char*>(arena.allocate(16, 1));
+
+	CHECK(second == first + 16);
+	CHECK_EQUAL(uintptr_t(0), reinterpret_cast<uintptr_t>(oversized) % 64);
+	CHECK_EQUAL(size_t(16 + 4096 + 16), arena.bytesAllocated());
+
+	/*Filling the regular block still moves on to a fresh one*/
+	char* third = static_cast<char*>(arena.allocate(240, 1));
+	CHECK(third != second + 16);
+
+	arena.reset();
+	CHECK_EQUAL(size_t(0), arena.bytesAllocated());
+	CHECK(arena.allocate(8, 8) != nullptr);
+}
+
+TEST(arenaOversizedFirstAllocation)
+{
+	Arena arena(256);
+	char* oversized = static_cast<char*>(arena.allocate(1024, 1));
+	char* small = static_cast<char*>(arena.allocate(8, 1));
+
+	CHECK(small < oversized || small >= oversized + 1024);
+}
+
+TEST(machImageInternsSegmentAndSectionNames)
+{
+	MachOBuilder builder(MH_OBJECT);
+	builder.segment(makeSegment("", 0, 0x20, 0, 0), {
+		makeSection("__TEXT", "__text", 0x0, 0x10, 0),
+		makeSection("__DATA", "__mod_init_func1", 0x10, 0x10, 0) });
+	DecodedFixture fixture(builder.write("names.o"));
+
+	CHECK_EQUAL(size_t(1), fixture.image.segments.size());
+	CHECK_EQUAL(size_t(2), fixture.image.sections.size());
+	CHECK_EQUAL(std::string_view("__TEXT"), corpusNames().name(fixture.image.sections[0].segmentName));
+
+	/*A full 16 character name has no terminator in the file*/
+	CHECK_EQUAL(std::string_view("__mod_init_func1"), corpusNames().name(fixture.image.sections[1].name));
+	CHECK(findSection(fixture.image, "__mod_init_func1") == &fixture.image.sections[1]);
+	CHECK(fixture.image.sections[0].segmentName != fixture.image.sections[1].segmentName);
+}
@@ -0,0 +1,148 @@
+#include <cstddef>
+#include <utility>
+#include "ChainedFixups.h"
+#include "Fixture.h"
+#include "Streaming.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t LoadAddress = 0x100000000;
+	const uint64_t DataAddress = LoadAddress + 0x1000;
+
+	/*__TEXT maps the header, __DATA is one 0x1000 byte page holding the given raw pointers, and
+	__LINKEDIT holds an LC_DYLD_CHAINED_FIXUPS payload with two imports whose only chain starts at
+	the first pointer*/
+	std::string chainedImage(const std::string& name, uint16_t pointerFormat, const std::vector<std::pair<uint32_t, uint64_t>>& pointers)
+	{
+		MachOBuilder builder(MH_EXECUTE);
+
+		ByteWriter page;
+		page.zeros(0x1000);
+		for (const auto& pointer : pointers)
+		{
+			page.patch(pointer.first, pointer.second);
+		}
+		const uint32_t dataOffset = builder.append(page, 0x1000);
+
+		ByteWriter blob;
+		blob.zeros(sizeof(dyld_chained_fixups_header)).align(8);
+
+		dyld_chained_fixups_header header = {};
+		header.starts_offset = static_cast<uint32_t>(blob.size());
+		blob.u32(3).u32(0).u32(16).u32(0);	/*only __DATA has chains*/
+
+		blob.u32(offsetof(dyld_chained_starts_in_segment, page_start) + sizeof(uint16_t));
+		blob.u16(0x1000).u16(pointerFormat).u64(0x1000).u32(0).u16(1).u16(static_cast<uint16_t>(pointers.front().first));
+		blob.align(4);
+
+		header.imports_offset = static_cast<uint32_t>(blob.size());
+		header.imports_count = 2;
+		header.imports_format = DYLD_CHAINED_IMPORT;
+		blob.u32(1 | 1u << 9);				/*libSystem, "_malloc"*/
+		blob.u32(1 | 1u << 8 | 9u << 9);	/*libSystem, weak "_free"*/
+
+		header.symbols_offset = static_cast<uint32_t>(blob.size());
+		blob.u8(0).cstring("_malloc").cstring("_free");
+		blob.patch(0, header);
+		const uint32_t blobOffset = builder.append(blob);
+
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x1000, 0, 0x1000));
+		builder.segment(makeSegment("__DATA", DataAddress, 0x1000, dataOffset, 0x1000));
+		builder.segment(makeSegment("__LINKEDIT", DataAddress + 0x1000, 0x1000, blobOffset, blob.size()));
+
+		linkedit_data_command fixups = {};
+		fixups.cmd = LC_DYLD_CHAINED_FIXUPS;
+		fixups.dataoff = blobOffset;
+		fixups.datasize = static_cast<uint32_t>(blob.size());
+		builder.command(fixups);
+
+		return builder.write(name);
+	}
+
+	ChainedFixups decodeFixture(const std::string& fileName)
+	{
+		DecodedFixture fixture(fileName);
+		return decodeChainedFixups(fixture.fin, fixture.image, *findLinkeditData(fixture.image, LC_DYLD_CHAINED_FIXUPS));
+	}
+}
+
+TEST(chainedFixups64OffsetRebasesAndBinds)
+{
+	const ChainedFixups fixups = decodeFixture(chainedImage("fixups-64-offset", DYLD_CHAINED_PTR_64_OFFSET, {
+		{ 0x10, 0x3f00 | uint64_t(2) << 51 },								/*rebase, next 8 bytes on*/
+		{ 0x18, uint64_t(1) << 63 | 1 | uint64_t(5) << 24 | uint64_t(4) << 51 },	/*bind _free + 5, next 16 bytes on*/
+		{ 0x28, 0x10 | uint64_t(0x80) << 36 },								/*rebase with high8, ends the chain*/
+		{ 0x30, 0x20 },														/*not reached*/
+	}));
+
+	CHECK_EQUAL(size_t(2), fixups.imports.size());
+	CHECK_EQUAL(std::string_view("_malloc"), fixups.importName(0));
+	CHECK_EQUAL(std::string_view("_free"), fixups.importName(1));
+	CHECK(fixups.imports[1].weakImport);
+	CHECK_EQUAL(1, fixups.imports[1].libOrdinal);
+
+	CHECK_EQUAL(size_t(2), fixups.rebaseAddress.size());
+	CHECK_EQUAL(DataAddress + 0x10, fixups.rebaseAddress[0]);
+	CHECK_EQUAL(LoadAddress + 0x3f00, fixups.rebaseTarget[0]);
+	CHECK_EQUAL(DataAddress + 0x28, fixups.rebaseAddress[1]);
+	CHECK_EQUAL((LoadAddress + 0x10) | uint64_t(0x80) << 56, fixups.rebaseTarget[1]);
+
+	CHECK_EQUAL(size_t(1), fixups.bindAddress.size());
+	CHECK_EQUAL(DataAddress + 0x18, fixups.bindAddress[0]);
+	CHECK_EQUAL(1u, fixups.bindImport[0]);
+	CHECK_EQUAL(int64_t(5), fixups.bindAddend[0]);
+}
+
+TEST(chainedFixupsArm64ePointerFormats)
+{
+	const ChainedFixups fixups = decodeFixture(chainedImage("fixups-arm64e", DYLD_CHAINED_PTR_ARM64E, {
+		{ 0x0, (LoadAddress + 0x40) | uint64_t(1) << 51 },									/*plain rebase to a vmaddr*/
+		{ 0x8, uint64_t(1) << 63 | 0x80 | uint64_t(1) << 51 },								/*authenticated rebase, an offset*/
+		{ 0x10, uint64_t(1) << 62 | (uint64_t(-2) & 0x7ffff) << 32 | uint64_t(1) << 51 },	/*bind _malloc - 2*/
+		{ 0x18, uint64_t(3) << 62 | 1 },													/*authenticated bind _free*/
+	}));
+
+	CHECK_EQUAL(size_t(2), fixups.rebaseTarget.size());
+	CHECK_EQUAL(LoadAddress + 0x40, fixups.rebaseTarget[0]);
+	CHECK_EQUAL(LoadAddress + 0x80, fixups.rebaseTarget[1]);
+	CHECK_EQUAL(DataAddress + 0x8, fixups.rebaseAddress[1]);
+
+	CHECK_EQUAL(size_t(2), fixups.bindImport.size());
+	CHECK_EQUAL(0u, fixups.bindImport[0]);
+	CHECK_EQUAL(int64_t(-2), fixups.bindAddend[0]);
+	CHECK_EQUAL(1u, fixups.bindImport[1]);
+	CHECK_EQUAL(int64_t(0), fixups.bindAddend[1]);
+}
+
+TEST(chainedFixupsStreamedMatchInMemory)
+{
+	const std::string fileName = chainedImage("fixups-streamed", DYLD_CHAINED_PTR_64_OFFSET, {
+		{ 0x0, 0x100 | uint64_t(2) << 51 },
+		{ 0x8, uint64_t(1) << 63 | uint64_t(2) << 51 },
+		{ 0x10, 0x200 },
+	});
+	const ChainedFixups inMemory = decodeFixture(fileName);
+
+	DecodedFixture fixture(fileName);
+	StreamOptions options;
+	options.memoryLimit = 0x4000;
+	options.windowSize = 0x1000;
+	StreamScheduler scheduler(fileName, options);
+
+	/*The payload is retained by one pass, the pages are walked by the next*/
+	const linkedit_data_command& command = *findLinkeditData(fixture.image, LC_DYLD_CHAINED_FIXUPS);
+	ArenaVector<uint8_t> blob{ ArenaAllocator<uint8_t>(workerArena()) };
+	CHECK(scheduler.retain(command.dataoff, command.datasize, blob));
+	scheduler.run();
+
+	ChainedFixups streamed;
+	scheduleChainedFixups(blob, fixture.image, scheduler, streamed);
+	scheduler.run();
+
+	CHECK(inMemory.rebaseAddress == streamed.rebaseAddress);
+	CHECK(inMemory.rebaseTarget == streamed.rebaseTarget);
+	CHECK(inMemory.bindAddress == streamed.bindAddress);
+	CHECK(inMemory.bindImport == streamed.bindImport);
+	CHECK_EQUAL(size_t(2), streamed.rebaseAddress.size());
+}
@@ -0,0 +1,248 @@
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <optional>
+#include <string>
+#include "Daemon.h"
+#include "Fixture.h"
+#include "Sockets.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t LoadAddress = 0x100000000;
+
+	struct Reply
+	{
+		DaemonStatus	status;
+		std::string		payload;
+	};
+
+	/*A dylib exporting _daemon from a one entry trie*/
+	std::string exportingImage(const std::string& name)
+	{
+		MachOBuilder builder(MH_DYLIB);
+
+		ByteWriter trie;
+		trie.u8(0).u8(1).cstring("_daemon").uleb(11);
+		trie.uleb(2).uleb(0).uleb(0x20).u8(0);
+		const uint32_t trieOffset = builder.append(trie);
+
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x1000, 0, 0x1000));
+
+		linkedit_data_command exportsTrie = {};
+		exportsTrie.cmd = LC_DYLD_EXPORTS_TRIE;
+		exportsTrie.dataoff = trieOffset;
+		exportsTrie.datasize = static_cast<uint32_t>(trie.size());
+		builder.command(exportsTrie);
+
+		return builder.write(name);
+	}
+
+	std::string frame(DaemonOpcode opcode, const std::string& payload = std::string())
+	{
+		const uint32_t length = static_cast<uint32_t>(1 + payload.size());
+		std::string bytes(reinterpret_cast<const char*>(&length), sizeof(length));
+		bytes.push_back(static_cast<char>(opcode));
+		return bytes + payload;
+	}
+
+	std::string exportRequest(const std::string& name, const std::string& path)
+	{
+		const uint32_t nameLength = static_cast<uint32_t>(name.size());
+		return std::string(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength)) + name + path;
+	}
+
+	/*The client end of a socket pair whose other end a daemon serves on another thread*/
+	class DaemonConnection
+	{
+	public:
+		DaemonConnection()
+		{
+			SOCKET server;
+			if (!socketPair(client, server))
+			{
+				client = INVALID_SOCKET;
+				return;
+			}
+
+			DaemonOptions options;
+			options.cacheCapacity = 4;
+			served = std::async(std::launch::async, [options, server]() { serveConnection(options, static_cast<uintptr_t>(server)); });
+		}
+
+		~DaemonConnection()
+		{
+			hangUp();
+		}
+
+		bool connected() const { return client != INVALID_SOCKET; }
+
+		void send(const std::string& bytes)
+		{
+			for (size_t done = 0; done < bytes.size();)
+			{
+				const int sent = ::send(client, bytes.data() + done, static_cast<int>(bytes.size() - done), 0);
+				if (sent <= 0)
+				{
+					return;
+				}
+				done += sent;
+			}
+		}
+
+		/*The next reply, nothing once the daemon has closed the connection*/
+		std::optional<Reply> read()
+		{
+			uint32_t length;
+			std::string header;
+			if (!receive(header, sizeof(length)))
+			{
+				return std::nullopt;
+			}
+			memcpy(&length, header.data(), sizeof(length));
+
+			std::string body;
+			if (length == 0 || !receive(body, length))
+			{
+				return std::nullopt;
+			}
+			return Reply{ static_cast<DaemonStatus>(body[0]), body.substr(1) };
+		}
+
+		std::optional<Reply> request(DaemonOpcode opcode, const std::string& payload = std::string())
+		{
+			send(frame(opcode, payload));
+			return read();
+		}
+
+		/*Whether serveConnection has returned, waiting a little for it*/
+		bool finished()
+		{
+			return served.valid() && served.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+		}
+
+		void hangUp()
+		{
+			if (client != INVALID_SOCKET)
+			{
+				closesocket(client);
+				client = INVALID_SOCKET;
+			}
+			if (served.valid())
+			{
+				served.wait();
+			}
+		}
+
+	private:
+		bool receive(std::string& into, size_t size)
+		{
+			into.resize(size);
+			for (size_t done = 0; done < size;)
+			{
+				const int received = recv(client, &into[done], static_cast<int>(size - done), 0);
+				if (received <= 0)
+				{
+					return false;
+				}
+				done += received;
+			}
+			return true;
+		}
+
+		SocketLibrary		sockets;
+		SOCKET				client = INVALID_SOCKET;
+		std::future<void>	served;
+	};
+}
+
+TEST(daemonAnswersFramesSplitAcrossWrites)
+{
+	const std::string image = exportingImage("daemon-split");
+	DaemonConnection daemon;
+	CHECK(daemon.connected());
+
+	/*A frame's length prefix and body arriving in pieces are put back together*/
+	const std::string describe = frame(DaemonOpcode::Describe, image);
+	daemon.send(describe.substr(0, 2));
+	daemon.send(describe.substr(2, 3));
+	daemon.send(describe.substr(5));
+	const std::optional<Reply> description = daemon.read();
+	CHECK(description && description->status == DaemonStatus::Ok);
+	CHECK(description && description->payload.find("Export : _daemon") != std::string::npos);
+
+	const std::optional<Reply> found = daemon.request(DaemonOpcode::LookupExport, exportRequest("_daemon", image));
+	CHECK(found && found->status == DaemonStatus::Ok && found->payload.size() == sizeof(uint64_t));
+	if (found && found->payload.size() == sizeof(uint64_t))
+	{
+		uint64_t address;
+		memcpy(&address, found->payload.data(), sizeof(address));
+		CHECK_EQUAL(LoadAddress + 0x20, address);
+	}
+
+	const std::optional<Reply> missing = daemon.request(DaemonOpcode::LookupExport, exportRequest("_missing", image));
+	CHECK(missing && missing->status == DaemonStatus::NotFound);
+
+	const std::optional<Reply> unknown = daemon.request(static_cast<DaemonOpcode>(0x7f));
+	CHECK(unknown && unknown->status == DaemonStatus::BadRequest);
+
+	const std::optional<Reply> failed = daemon.request(DaemonOpcode::Describe, fixturePath("daemon-no-such-file"));
+	CHECK(failed && failed->status == DaemonStatus::Failed && !failed->payload.empty());
+}
+
+TEST(daemonRepliesInRequestOrder)
+{
+	const std::string image = exportingImage("daemon-order");
+	DaemonConnection daemon;
+
+	/*The describe and export lookup go to workers, the stats are answered on the loop straight away,
+	yet the replies still come back in the order the requests were sent*/
+	daemon.send(frame(DaemonOpcode::Describe, image) + frame(DaemonOpcode::Stats)
+		+ frame(DaemonOpcode::LookupExport, exportRequest("_daemon", image)) + frame(DaemonOpcode::Stats));
+
+	const std::optional<Reply> description = daemon.read();
+	CHECK(description && description->payload.find("Export : _daemon") != std::string::npos);
+
+	const std::optional<Reply> stats = daemon.read();
+	CHECK(stats && stats->status == DaemonStatus::Ok);
+	CHECK(stats && stats->payload.find("Requests In Flight : ") != std::string::npos);
+
+	const std::optional<Reply> found = daemon.read();
+	CHECK(found && found->status == DaemonStatus::Ok && found->payload.size() == sizeof(uint64_t));
+
+	const std::optional<Reply> laterStats = daemon.read();
+	CHECK(laterStats && laterStats->payload.find("Requests : ") == 0);
+
+	/*Both image requests were answered by now, so the image is cached*/
+	const std::optional<Reply> cached = daemon.request(DaemonOpcode::Stats);
+	CHECK(cached && cached->payload.find("Cached Images : 1") != std::string::npos);
+}
+
+TEST(daemonClosesOversizedRequests)
+{
+	DaemonConnection daemon;
+
+	/*Only the length prefix is sent, the daemon refuses it without waiting for a 1 MiB body*/
+	const uint32_t length = (1 << 20) + 1;
+	daemon.send(std::string(reinterpret_cast<const char*>(&length), sizeof(length)) + std::string(1, char(DaemonOpcode::Describe)));
+	CHECK(!daemon.read());
+
+	/*Its only client gone, the daemon returns*/
+	CHECK(daemon.finished());
+}
+
+TEST(daemonShutsDownAfterReplying)
+{
+	DaemonConnection daemon;
+
+	const std::optional<Reply> stats = daemon.request(DaemonOpcode::Stats);
+	CHECK(stats && stats->payload.find("Clients : 1") != std::string::npos);
+
+	const std::optional<Reply> shutdown = daemon.request(DaemonOpcode::Shutdown);
+	CHECK(shutdown && shutdown->status == DaemonStatus::Ok && shutdown->payload.empty());
+
+	/*Returns while the client is still connected, and closes the connection on the way out*/
+	CHECK(daemon.finished());
+	CHECK(!daemon.read());
+}
@@ -0,0 +1,304 @@
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "DwarfLines.h"
+#include "Fixture.h"
+#include "Test.h"
+#include "dwarf.h"
+
+namespace
+{
+	const uint64_t DwarfAddress = 0x100000000;
+	const uint8_t OpcodeBase = 13;
+	const int8_t LineBase = -5;
+	const uint8_t LineRange = 14;
+
+	/*The __DWARF sections of a dSYM, empty ones are left out of the image*/
+	struct DwarfSections
+	{
+		ByteWriter	info;
+		ByteWriter	abbrev;
+		ByteWriter	line;
+		ByteWriter	str;
+		ByteWriter	lineStr;
+		ByteWriter	strOffsets;
+		ByteWriter	addr;
+	};
+
+	std::string dsymImage(const std::string& name, const DwarfSections& dwarf)
+	{
+		MachOBuilder builder(MH_EXECUTE);
+		std::vector<section_64> sections;
+		uint64_t address = DwarfAddress;
+		uint32_t first = 0;
+		uint32_t last = 0;
+
+		const std::pair<const char*, const ByteWriter*> contents[] = {
+			{ "__debug_info", &dwarf.info }, { "__debug_abbrev", &dwarf.abbrev }, { "__debug_line", &dwarf.line },
+			{ "__debug_str", &dwarf.str }, { "__debug_line_str", &dwarf.lineStr }, { "__debug_str_offs", &dwarf.strOffsets },
+			{ "__debug_addr", &dwarf.addr } };
+		for (const auto& content : contents)
+		{
+			if (content.second->size() == 0)
+			{
+				continue;
+			}
+
+			const uint32_t offset = builder.append(*content.second);
+			sections.push_back(makeSection("__DWARF", content.first, address, content.second->size(), offset));
+			address += content.second->size();
+			first = first ? first : offset;
+			last = offset + static_cast<uint32_t>(content.second->size());
+		}
+
+		builder.segment(makeSegment("__DWARF", DwarfAddress, address - DwarfAddress, first, last - first), sections);
+		return builder.write(name);
+	}
+
+	/*The special opcode that moves the address by addressAdvance and the line by lineAdvance*/
+	uint8_t special(uint8_t addressAdvance, int8_t lineAdvance)
+	{
+		return static_cast<uint8_t>(OpcodeBase + (lineAdvance - LineBase) + LineRange * addressAdvance);
+	}
+
+	/*Writes the fields every line program header shares, from minimum_instruction_length to standard_opcode_lengths*/
+	void lineHeaderFields(ByteWriter& line)
+	{
+		line.u8(1).u8(1).u8(1).u8(static_cast<uint8_t>(LineBase)).u8(LineRange).u8(OpcodeBase);
+		for (uint8_t length : { 0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1 })
+		{
+			line.u8(length);
+		}
+	}
+
+	void setAddress(ByteWriter& line, uint64_t address)
+	{
+		line.u8(0).uleb(9).u8(DW_LNE_set_address).u64(address);
+	}
+
+	void endSequence(ByteWriter& line)
+	{
+		line.u8(0).uleb(1).u8(DW_LNE_end_sequence);
+	}
+
+	/*A DWARF 4 unit "main.c" in "/src" covering [0x1000, 0x1100), its line program switches to "inc/util.h" and back*/
+	DwarfSections version4Unit()
+	{
+		DwarfSections dwarf;
+		dwarf.str.u8(0).cstring("main.c");
+
+		dwarf.abbrev.uleb(1).uleb(DW_TAG_compile_unit).u8(0);
+		dwarf.abbrev.uleb(DW_AT_name).uleb(DW_FORM_strp);
+		dwarf.abbrev.uleb(DW_AT_comp_dir).uleb(DW_FORM_string);
+		dwarf.abbrev.uleb(DW_AT_stmt_list).uleb(DW_FORM_sec_offset);
+		dwarf.abbrev.uleb(DW_AT_low_pc).uleb(DW_FORM_addr);
+		dwarf.abbrev.uleb(DW_AT_high_pc).uleb(DW_FORM_data4);
+		dwarf.abbrev.uleb(0).uleb(0).uleb(0);
+
+		dwarf.info.u32(0).u16(4).u32(0).u8(8);
+		dwarf.info.uleb(1).u32(1).cstring("/src").u32(0).u64(0x1000).u32(0x100);
+		dwarf.info.patch(0, static_cast<uint32_t>(dwarf.info.size() - 4));
+
+		ByteWriter& line = dwarf.line;
+		line.u32(0).u16(4).u32(0);
+		const size_t headerStart = line.size();
+		lineHeaderFields(line);
+		line.cstring("inc").u8(0);
+		line.cstring("main.c").uleb(0).uleb(0).uleb(0);
+		line.cstring("util.h").uleb(1).uleb(0).uleb(0);
+		line.u8(0);
+		line.patch(6, static_cast<uint32_t>(line.size() - headerStart));
+
+		setAddress(line, 0x1000);
+		line.u8(DW_LNS_advance_line).sleb(9).u8(DW_LNS_copy);			/*0x1000 line 10*/
+		line.u8(special(4, 1));											/*0x1004 line 11*/
+		line.u8(DW_LNS_set_file).uleb(2).u8(special(8, 0));				/*0x100c util.h line 11*/
+		line.u8(DW_LNS_const_add_pc);									/*0x101d*/
+		line.u8(DW_LNS_set_file).uleb(1).u8(DW_LNS_advance_line).sleb(10).u8(DW_LNS_copy);	/*0x101d line 21*/
+		line.u8(DW_LNS_fixed_advance_pc).u16(0x20);						/*0x103d*/
+		line.u8(DW_LNS_advance_line).sleb(1).u8(DW_LNS_copy);			/*0x103d line 22*/
+		line.u8(DW_LNS_advance_pc).uleb(0xc3);							/*0x1100*/
+		endSequence(line);
+		line.patch(0, static_cast<uint32_t>(line.size() - 4));
+
+		return dwarf;
+	}
+
+	/*A DWARF 5 unit whose name and directory are strx forms and whose low_pc is an addrx, with its bases
+	pointing past a decoy contribution and given after the forms that need them*/
+	DwarfSections version5Unit()
+	{
+		DwarfSections dwarf;
+		dwarf.str.u8(0).cstring("/build").cstring("lib.c");
+		dwarf.lineStr.u8(0).cstring("/build").cstring("sub");
+
+		/*A one entry decoy contribution, then the unit's own: [0] unused, [1] "/build", [2] "lib.c"*/
+		dwarf.strOffsets.u32(8).u16(5).u16(0).u32(0);
+		const uint32_t strOffsetsBase = static_cast<uint32_t>(dwarf.strOffsets.size() + 8);
+		dwarf.strOffsets.u32(16).u16(5).u16(0).u32(0).u32(1).u32(8);
+
+		dwarf.addr.u32(20).u16(5).u8(8).u8(0).u64(0x2000).u64(0x3000);
+
+		dwarf.abbrev.uleb(1).uleb(DW_TAG_compile_unit).u8(0);
+		dwarf.abbrev.uleb(DW_AT_name).uleb(DW_FORM_strx1);
+		dwarf.abbrev.uleb(DW_AT_comp_dir).uleb(DW_FORM_strx);
+		dwarf.abbrev.uleb(DW_AT_stmt_list).uleb(DW_FORM_sec_offset);
+		dwarf.abbrev.uleb(DW_AT_low_pc).uleb(DW_FORM_addrx);
+		dwarf.abbrev.uleb(DW_AT_high_pc).uleb(DW_FORM_data4);
+		dwarf.abbrev.uleb(DW_AT_str_offsets_base).uleb(DW_FORM_sec_offset);
+		dwarf.abbrev.uleb(DW_AT_addr_base).uleb(DW_FORM_sec_offset);
+		dwarf.abbrev.uleb(0).uleb(0).uleb(0);
+
+		dwarf.info.u32(0).u16(5).u8(DW_UT_compile).u8(8).u32(0);
+		dwarf.info.uleb(1).u8(2).uleb(1).u32(0).uleb(1).u32(0x20).u32(strOffsetsBase).u32(8);
+		dwarf.info.patch(0, static_cast<uint32_t>(dwarf.info.size() - 4));
+
+		ByteWriter& line = dwarf.line;
+		line.u32(0).u16(5).u8(8).u8(0).u32(0);
+		const size_t headerStart = line.size();
+		lineHeaderFields(line);
+		line.u8(1).uleb(DW_LNCT_path).uleb(DW_FORM_line_strp);
+		line.uleb(2).u32(1).u32(8);
+		line.u8(2).uleb(DW_LNCT_path).uleb(DW_FORM_string).uleb(DW_LNCT_directory_index).uleb(DW_FORM_udata);
+		line.uleb(2).cstring("lib.c").uleb(0).cstring("part.c").uleb(1);
+		line.patch(8, static_cast<uint32_t>(line.size() - headerStart));
+
+		/*File indexes start at 0 from DWARF 5 on*/
+		setAddress(line, 0x3000);
+		line.u8(DW_LNS_set_file).uleb(0).u8(DW_LNS_advance_line).sleb(4).u8(DW_LNS_copy);	/*0x3000 lib.c line 5*/
+		line.u8(special(4, 1));															/*0x3004 lib.c line 6*/
+		line.u8(DW_LNS_set_file).uleb(1).u8(special(4, 1));								/*0x3008 sub/part.c line 7*/
+		line.u8(DW_LNS_advance_pc).uleb(0x18);
+		endSequence(line);
+		line.patch(0, static_cast<uint32_t>(line.size() - 4));
+
+		return dwarf;
+	}
+
+	std::string lineAt(const DwarfLineIndex& index, uint64_t address)
+	{
+		const LineInfo info = index.lookup(address);
+		if (info.line == 0)
+		{
+			return "?";
+		}
+
+		std::ostringstream text;
+		text << index.path(info.file) << ":" << info.line;
+		return text.str();
+	}
+
+	std::string readWhole(const std::string& fileName)
+	{
+		std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+		std::ostringstream text;
+		text << fin.rdbuf();
+		return text.str();
+	}
+}
+
+TEST(dwarfLineProgramVersion4)
+{
+	const std::string fileName = dsymImage("dwarf-v4", version4Unit());
+	DecodedFixture fixture(fileName);
+	const size_t corpusSize = corpusNames().size();
+
+	const DwarfLineIndex index(fileName, fixture.image);
+	CHECK_EQUAL(size_t(1), index.unitCount());
+
+	CHECK_EQUAL(std::string("?"), lineAt(index, 0xfff));
+	CHECK_EQUAL(std::string("/src/main.c:10"), lineAt(index, 0x1000));
+	CHECK_EQUAL(std::string("/src/main.c:10"), lineAt(index, 0x1003));
+	CHECK_EQUAL(std::string("/src/main.c:11"), lineAt(index, 0x1004));
+	CHECK_EQUAL(std::string("/src/inc/util.h:11"), lineAt(index, 0x100c));
+	CHECK_EQUAL(std::string("/src/inc/util.h:11"), lineAt(index, 0x101c));
+	CHECK_EQUAL(std::string("/src/main.c:21"), lineAt(index, 0x101d));
+	CHECK_EQUAL(std::string("/src/main.c:22"), lineAt(index, 0x10ff));
+	CHECK_EQUAL(std::string("?"), lineAt(index, 0x1100));
+	CHECK_EQUAL(size_t(6), index.rows().size());
+
+	/*Paths live in the index, the corpus never sees them*/
+	CHECK_EQUAL(corpusSize, corpusNames().size());
+}
+
+TEST(dwarfVersion5ResolvesStrxAndAddrx)
+{
+	const std::string fileName = dsymImage("dwarf-v5", version5Unit());
+	DecodedFixture fixture(fileName);
+
+	const DwarfLineIndex index(fileName, fixture.image);
+	CHECK_EQUAL(size_t(1), index.unitCount());
+
+	/*Found through the unit's range, which only exists once low_pc resolves through __debug_addr*/
+	CHECK_EQUAL(std::string("?"), lineAt(index, 0x2000));
+	CHECK_EQUAL(std::string("/build/lib.c:5"), lineAt(index, 0x3000));
+	CHECK_EQUAL(std::string("/build/lib.c:6"), lineAt(index, 0x3004));
+	CHECK_EQUAL(std::string("/build/sub/part.c:7"), lineAt(index, 0x301f));
+	CHECK_EQUAL(std::string("?"), lineAt(index, 0x3020));
+}
+
+TEST(symbolicateReportsInvalidAddresses)
+{
+	const std::string fileName = dsymImage("dwarf-symbolicate", version4Unit());
+	const std::string addressFile = fixturePath("dwarf-symbolicate.addresses");
+	const std::string outputFile = fixturePath("dwarf-symbolicate.txt");
+	const std::string addresses = "0x1004\n  zz\n1000\r\n0x\n\n0x100c 12\n-1\n0X2000\n";
+	writeFile(addressFile, std::vector<uint8_t>(addresses.begin(), addresses.end()));
+
+	symbolicate(fileName, addressFile, outputFile);
+
+	CHECK_EQUAL(std::string(
+		"0x1004 : /src/main.c:11\n"
+		"zz : invalid address\n"
+		"0x1000 : /src/main.c:10\n"
+		"0x : invalid address\n"
+		"0x100c 12 : invalid address\n"
+		"-1 : invalid address\n"
+		"0x2000 : ?\n"), readWhole(outputFile));
+}
+
+TEST(lineIndexForBuildsEachIndexOnce)
+{
+	const std::string fileName = dsymImage("dwarf-shared", version4Unit());
+	DecodedFixture fixture(fileName);
+
+	/*Threads that miss together may each build an index, but all of them get the one that was kept*/
+	std::vector<std::shared_ptr<const DwarfLineIndex>> indexes(8);
+	std::vector<std::thread> threads;
+	for (auto& index : indexes)
+	{
+		threads.emplace_back([&index, &fileName, &fixture]() { index = lineIndexFor(fileName, fixture.image); });
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	const std::shared_ptr<const DwarfLineIndex> kept = lineIndexFor(fileName, fixture.image);
+	for (const auto& index : indexes)
+	{
+		CHECK(index == kept);
+	}
+	CHECK_EQUAL(size_t(1), kept->unitCount());
+}
+
+TEST(symbolicateRefusesImagesWithoutDwarf)
+{
+	MachOBuilder builder(MH_EXECUTE);
+	builder.segment(makeSegment("__TEXT", DwarfAddress, 0x1000, 0, 0x1000));
+	const std::string fileName = builder.write("dwarf-not-dsym");
+	const std::string addressFile = fixturePath("dwarf-not-dsym.addresses");
+	const std::string addresses = "0x1000\n";
+	writeFile(addressFile, std::vector<uint8_t>(addresses.begin(), addresses.end()));
+
+	std::string message;
+	try
+	{
+		symbolicate(fileName, addressFile, fixturePath("dwarf-not-dsym.txt"));
+	}
+	catch (const std::runtime_error& error)
+	{
+		message = error.what();
+	}
+	CHECK(message.find("has no __DWARF segment") != std::string::npos);
+}
@@ -0,0 +1,119 @@
+#include <utility>
+#include "Arena.h"
+#include "ExportsTrie.h"
+#include "Fixture.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t LoadAddress = 0x100000000;
+
+	struct TrieNode
+	{
+		ByteWriter										terminal;	/*flags and payload, empty for interior nodes*/
+		std::vector<std::pair<std::string, size_t>>		children;	/*edge label and index of the child node*/
+	};
+
+	/*Lays nodes out in order, node 0 is the root.  Small tries only, every size and offset must fit one uleb byte.*/
+	ByteWriter layoutTrie(const std::vector<TrieNode>& nodes)
+	{
+		std::vector<size_t> offsets;
+		size_t offset = 0;
+		for (const auto& node : nodes)
+		{
+			offsets.push_back(offset);
+			offset += 1 + node.terminal.size() + 1;
+			for (const auto& child : node.children)
+			{
+				offset += child.first.size() + 1 + 1;
+			}
+		}
+
+		ByteWriter trie;
+		for (const auto& node : nodes)
+		{
+			trie.uleb(node.terminal.size()).raw(node.terminal.data().data(), node.terminal.size());
+			trie.u8(static_cast<uint8_t>(node.children.size()));
+			for (const auto& child : node.children)
+			{
+				trie.cstring(child.first).uleb(offsets[child.second]);
+			}
+		}
+
+		return trie;
+	}
+
+	std::string exportsImage(const std::string& name, const ByteWriter& trie)
+	{
+		MachOBuilder builder(MH_DYLIB);
+		const uint32_t trieOffset = builder.append(trie);
+
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x4000, 0, 0x1000));
+		builder.segment(makeSegment("__LINKEDIT", LoadAddress + 0x4000, 0x1000, trieOffset, trie.size()));
+
+		linkedit_data_command exportsTrie = {};
+		exportsTrie.cmd = LC_DYLD_EXPORTS_TRIE;
+		exportsTrie.dataoff = trieOffset;
+		exportsTrie.datasize = static_cast<uint32_t>(trie.size());
+		builder.command(exportsTrie);
+
+		return builder.write(name);
+	}
+
+	std::vector<ExportedSymbol> decodeFixture(const std::string& fileName)
+	{
+		DecodedFixture fixture(fileName);
+		return decodeExports(fixture.fin, fixture.image);
+	}
+}
+
+TEST(exportsTrieWalkVisitsEveryTerminalInOrder)
+{
+	std::vector<TrieNode> nodes(6);
+	nodes[0].children = { { "_f", 1 }, { "_main", 2 }, { "_abs", 3 } };
+	nodes[1].children = { { "oo", 4 }, { "ree", 5 } };
+	nodes[2].terminal.uleb(EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER).uleb(0x20).uleb(0x30);
+	nodes[3].terminal.uleb(EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE).uleb(0x42);
+	nodes[4].terminal.uleb(EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION).uleb(0x10);
+	nodes[5].terminal.uleb(EXPORT_SYMBOL_FLAGS_REEXPORT).uleb(2).cstring("_free_impl");
+
+	const std::vector<ExportedSymbol> exports = decodeFixture(exportsImage("exports", layoutTrie(nodes)));
+
+	CHECK_EQUAL(size_t(4), exports.size());
+	if (exports.size() != 4)
+	{
+		return;
+	}
+
+	CHECK_EQUAL(std::string_view("_foo"), corpusNames().name(exports[0].name));
+	CHECK_EQUAL(LoadAddress + 0x10, exports[0].address);
+	CHECK_EQUAL(uint64_t(EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION), exports[0].flags);
+
+	CHECK_EQUAL(std::string_view("_free"), corpusNames().name(exports[1].name));
+	CHECK_EQUAL(uint64_t(2), exports[1].other);
+	CHECK_EQUAL(std::string_view("_free_impl"), corpusNames().name(exports[1].importName));
+
+	CHECK_EQUAL(std::string_view("_main"), corpusNames().name(exports[2].name));
+	CHECK_EQUAL(LoadAddress + 0x20, exports[2].address);
+	CHECK_EQUAL(LoadAddress + 0x30, exports[2].other);
+
+	CHECK_EQUAL(std::string_view("_abs"), corpusNames().name(exports[3].name));
+	CHECK_EQUAL(uint64_t(0x42), exports[3].address);
+}
+
+TEST(exportsTrieSurvivesCyclesAndTruncation)
+{
+	std::vector<TrieNode> nodes(2);
+	nodes[0].children = { { "_a", 1 } };
+	nodes[1].terminal.uleb(0).uleb(0x8);
+	nodes[1].children = { { "gain", 0 }, { "b", 1 } };
+	const ByteWriter trie = layoutTrie(nodes);
+
+	const std::vector<ExportedSymbol> exports = decodeFixture(exportsImage("exports-cycle", trie));
+	CHECK_EQUAL(size_t(1), exports.size());
+
+	/*Cut inside the last child edge, the walk stops at the damage instead of reading past it*/
+	ArenaVector<uint8_t> truncated(trie.data().begin(), trie.data().end() - 2, ArenaAllocator<uint8_t>(workerArena()));
+	CHECK_EQUAL(size_t(1), decodeExportsTrie(truncated, LoadAddress).size());
+	workerArena().reset();
+}
@@ -0,0 +1,172 @@
+#include <filesystem>
+#include <stdexcept>
+#include "Fixture.h"
+
+ByteWriter& ByteWriter::uleb(uint64_t value)
+{
+	do
+	{
+		uint8_t byte = value & 0x7f;
+		value >>= 7;
+		bytes.push_back(value ? byte | 0x80 : byte);
+	} while (value);
+
+	return *this;
+}
+
+ByteWriter& ByteWriter::sleb(int64_t value)
+{
+	for (;;)
+	{
+		uint8_t byte = value & 0x7f;
+		value >>= 7;
+		const bool done = (value == 0 && (byte & 0x40) == 0) || (value == -1 && (byte & 0x40) != 0);
+		bytes.push_back(done ? byte : byte | 0x80);
+		if (done)
+		{
+			return *this;
+		}
+	}
+}
+
+ByteWriter& ByteWriter::cstring(std::string_view text)
+{
+	raw(text.data(), text.size());
+	return u8(0);
+}
+
+ByteWriter& ByteWriter::raw(const void* data, size_t size)
+{
+	const uint8_t* first = static_cast<const uint8_t*>(data);
+	bytes.insert(bytes.end(), first, first + size);
+	return *this;
+}
+
+MachOBuilder::MachOBuilder(uint32_t filetype)
+	: filetype(filetype)
+{
+}
+
+uint32_t MachOBuilder::append(const std::vector<uint8_t>& data, size_t alignment)
+{
+	payload.align(alignment);
+	const uint32_t offset = HeaderSpace + static_cast<uint32_t>(payload.size());
+	payload.raw(data.data(), data.size());
+
+	return offset;
+}
+
+void MachOBuilder::commandBytes(const void* structure, size_t size, std::string_view trailing, uint32_t cmdsize)
+{
+	const size_t start = commands.size();
+	commands.raw(structure, size);
+	if (!trailing.empty())
+	{
+		commands.cstring(trailing);
+	}
+	commands.zeros(start + cmdsize - commands.size());
+	++ncmds;
+}
+
+void MachOBuilder::segment(segment_command_64 segment, const std::vector<section_64>& sections)
+{
+	segment.nsects = static_cast<uint32_t>(sections.size());
+	segment.cmdsize = static_cast<uint32_t>(sizeof(segment) + sections.size() * sizeof(section_64));
+
+	commands.put(segment);
+	for (const auto& sect : sections)
+	{
+		commands.put(sect);
+	}
+	++ncmds;
+}
+
+std::vector<uint8_t> MachOBuilder::bytes() const
+{
+	if (sizeof(mach_header_64) + commands.size() > HeaderSpace)
+	{
+		throw std::length_error("fixture load commands overflow the header space");
+	}
+
+	mach_header_64 header = {};
+	header.magic = MH_MAGIC_64;
+	header.cputype = 0x01000007;	/*CPU_TYPE_X86_64*/
+	header.cpusubtype = 3;
+	header.filetype = filetype;
+	header.ncmds = ncmds;
+	header.sizeofcmds = static_cast<uint32_t>(commands.size());
+
+	ByteWriter file;
+	file.put(header);
+	file.raw(commands.data().data(), commands.size());
+	file.zeros(HeaderSpace - file.size());
+	file.raw(payload.data().data(), payload.size());
+
+	return file.data();
+}
+
+std::string MachOBuilder::write(const std::string& name) const
+{
+	const std::string fileName = fixturePath(name);
+	writeFile(fileName, bytes());
+
+	return fileName;
+}
+
+segment_command_64 makeSegment(std::string_view name, uint64_t vmaddr, uint64_t vmsize, uint64_t fileoff, uint64_t filesize)
+{
+	segment_command_64 segment = {};
+	segment.cmd = LC_SEGMENT_64;
+	name.copy(segment.segname, sizeof(segment.segname));
+	segment.vmaddr = vmaddr;
+	segment.vmsize = vmsize;
+	segment.fileoff = fileoff;
+	segment.filesize = filesize;
+	segment.maxprot = segment.initprot = 3;
+
+	return segment;
+}
+
+section_64 makeSection(std::string_view segname, std::string_view sectname, uint64_t addr, uint64_t size, uint32_t offset, uint32_t flags)
+{
+	section_64 sect = {};
+	segname.copy(sect.segname, sizeof(sect.segname));
+	sectname.copy(sect.sectname, sizeof(sect.sectname));
+	sect.addr = addr;
+	sect.size = size;
+	sect.offset = offset;
+	sect.flags = flags;
+
+	return sect;
+}
+
+nlist_64 makeSymbol(uint32_t strx, uint8_t type, uint8_t sect, uint64_t value)
+{
+	nlist_64 symbol = {};
+	symbol.n_strx = strx;
+	symbol.n_type = type;
+	symbol.n_sect = sect;
+	symbol.n_value = value;
+
+	return symbol;
+}
+
+std::string fixturePath(const std::string& name)
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "macho-tests";
+	std::filesystem::create_directories(directory);
+
+	return (directory / name).string();
+}
+
+void writeFile(const std::string& fileName, const std::vector<uint8_t>& bytes)
+{
+	std::ofstream fout(fileName.c_str(), std::ofstream::binary | std::ofstream::trunc);
+	fout.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+DecodedFixture::DecodedFixture(const std::string& fileName)
+	: fin(fileName.c_str(), std::ifstream::binary)
+{
+	image = decodeImage(fin);
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Decoder.h"
+
+/*Little endian byte buffer for assembling fixture tables such as tries, fixup chains and line programs*/
+class ByteWriter
+{
+public:
+	size_t size() const { return bytes.size(); }
+	const std::vector<uint8_t>& data() const { return bytes; }
+
+	ByteWriter& u8(uint8_t value) { return put(value); }
+	ByteWriter& u16(uint16_t value) { return put(value); }
+	ByteWriter& u32(uint32_t value) { return put(value); }
+	ByteWriter& u64(uint64_t value) { return put(value); }
+	ByteWriter& uleb(uint64_t value);
+	ByteWriter& sleb(int64_t value);
+	ByteWriter& cstring(std::string_view text);
+	ByteWriter& raw(const void* data, size_t size);
+	ByteWriter& zeros(size_t count) { bytes.resize(bytes.size() + count); return *this; }
+	ByteWriter& align(size_t alignment) { return zeros((alignment - bytes.size() % alignment) % alignment); }
+
+	/*Copies a plain structure, load commands and nlist entries alike*/
+	template <typename Structure>
+	ByteWriter& put(const Structure& structure) { return raw(&structure, sizeof(structure)); }
+
+	/*Overwrites a value already written at offset, for lengths only known once the body is written*/
+	template <typename Structure>
+	void patch(size_t offset, const Structure& structure) { memcpy(bytes.data() + offset, &structure, sizeof(structure)); }
+
+private:
+	std::vector<uint8_t> bytes;
+};
+
+/*Lays out a 64-bit Mach-O file: the header and load commands in the first HeaderSpace bytes, then
+payloads in the order they were appended, so a payload's file offset is known as soon as it is added*/
+class MachOBuilder
+{
+public:
+	static const uint32_t HeaderSpace = 0x1000;
+
+	explicit MachOBuilder(uint32_t filetype = MH_EXECUTE);
+
+	/*Appends payload bytes after the load command area and returns their file offset*/
+	uint32_t append(const std::vector<uint8_t>& data, size_t alignment = 8);
+	uint32_t append(const ByteWriter& data, size_t alignment = 8) { return append(data.data(), alignment); }
+
+	/*Adds a load command, trailing bytes such as an lc_str follow the structure and cmdsize is rounded up to 8*/
+	template <typename Command>
+	void command(Command structure, std::string_view trailing = std::string_view())
+	{
+		const size_t trailingSize = trailing.empty() ? 0 : trailing.size() + 1;
+		structure.cmdsize = static_cast<uint32_t>((sizeof(structure) + trailingSize + 7) & ~size_t(7));
+		commandBytes(&structure, sizeof(structure), trailing, structure.cmdsize);
+	}
+
+	/*Adds an LC_SEGMENT_64 followed by its sections, nsects and cmdsize are filled in*/
+	void segment(segment_command_64 segment, const std::vector<section_64>& sections = {});
+
+	std::vector<uint8_t> bytes() const;
+
+	/*Writes the image under the test directory and returns its path*/
+	std::string write(const std::string& name) const;
+
+private:
+	void commandBytes(const void* structure, size_t size, std::string_view trailing, uint32_t cmdsize);
+
+	uint32_t filetype;
+	uint32_t ncmds = 0;
+	ByteWriter commands;
+	ByteWriter payload;
+};
+
+segment_command_64 makeSegment(std::string_view name, uint64_t vmaddr, uint64_t vmsize, uint64_t fileoff, uint64_t filesize);
+section_64 makeSection(std::string_view segname, std::string_view sectname, uint64_t addr, uint64_t size, uint32_t offset, uint32_t flags = 0);
+nlist_64 makeSymbol(uint32_t strx, uint8_t type, uint8_t sect, uint64_t value);
+
+/*Path of a scratch file in the test directory, the directory is created on first use*/
+std::string fixturePath(const std::string& name);
+void writeFile(const std::string& fileName, const std::vector<uint8_t>& bytes);
+
+/*A fixture file opened and decoded the way decodeFile does it*/
+struct DecodedFixture
+{
+	explicit DecodedFixture(const std::string& fileName);
+
+	std::ifstream fin;
+	MachImage image;
+};
@@ -0,0 +1,55 @@
+#include "Fixture.h"
+#include "ImageCache.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t LoadAddress = 0x100000000;
+
+	/*A dylib exporting one symbol, name is also its only segment's name so each image brings a string of its own*/
+	std::string exportingImage(const std::string& name, const std::string& symbol)
+	{
+		MachOBuilder builder(MH_DYLIB);
+
+		ByteWriter trie;
+		trie.u8(0).u8(1).cstring(symbol).uleb(static_cast<uint64_t>(4 + symbol.size()));
+		trie.uleb(2).uleb(0).uleb(0x20).u8(0);
+		const uint32_t trieOffset = builder.append(trie);
+
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x1000, 0, 0x1000));
+		builder.segment(makeSegment(name, LoadAddress + 0x1000, 0x1000, 0, 0));
+
+		linkedit_data_command exportsTrie = {};
+		exportsTrie.cmd = LC_DYLD_EXPORTS_TRIE;
+		exportsTrie.dataoff = trieOffset;
+		exportsTrie.datasize = static_cast<uint32_t>(trie.size());
+		builder.command(exportsTrie);
+
+		return builder.write(name);
+	}
+}
+
+TEST(imageCacheKeepsNamesPerImage)
+{
+	const std::string first = exportingImage("__CACHED_A", "_cachedA");
+	const std::string second = exportingImage("__CACHED_B", "_cachedB");
+	const size_t corpusSize = corpusNames().size();
+
+	ImageCache cache(1, DecodeOptions());
+	std::shared_ptr<CachedImage> held = cache.acquire(first);
+	CHECK_EQUAL(LoadAddress + 0x20, cache.findExport(*held, "_cachedA").value_or(0));
+	CHECK(!cache.findExport(*held, "_cachedB"));
+	CHECK(cache.description(*held).find("__CACHED_A") != std::string::npos);
+	CHECK_EQUAL(std::string_view("__CACHED_A"), held->names.name(held->image.segments[1].name));
+
+	/*Decoding the second image evicts the first, which stays usable while it is held*/
+	std::shared_ptr<CachedImage> other = cache.acquire(second);
+	CHECK_EQUAL(size_t(1), cache.size());
+	CHECK_EQUAL(uint64_t(1), cache.evictions());
+	CHECK(!cache.find(first));
+	CHECK(cache.find(second) == other);
+	CHECK_EQUAL(std::string_view("__CACHED_A"), held->names.name(held->image.segments[1].name));
+
+	/*Nothing the cache decoded went into the shared interner*/
+	CHECK_EQUAL(corpusSize, corpusNames().size());
+}
@@ -0,0 +1,224 @@
+#include <cstddef>
+#include "Fixture.h"
+#include "ObjCMetadata.h"
+#include "Reader.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t LoadAddress = 0x100000000;
+	const uint64_t DataAddress = LoadAddress + 0x1000;
+
+	/*Offsets into the single __DATA page every structure lives in*/
+	const uint32_t ClassList = 0x000;
+	const uint32_t CategoryList = 0x008;
+	const uint32_t ProtocolList = 0x010;
+	const uint32_t FooClass = 0x100;
+	const uint32_t FooMetaclass = 0x140;
+	const uint32_t BaseClass = 0x180;
+	const uint32_t FooData = 0x200;
+	const uint32_t FooMetaData = 0x260;
+	const uint32_t BaseData = 0x2c0;
+	const uint32_t FooMethods = 0x300;
+	const uint32_t FooClassMethods = 0x340;
+	const uint32_t SharedSelectorRef = 0x380;
+	const uint32_t ExtrasCategory = 0x400;
+	const uint32_t ExtrasMethods = 0x440;
+	const uint32_t RunnableProtocol = 0x480;
+	const uint32_t Strings = 0x600;
+
+	uint64_t address(uint32_t offset)
+	{
+		return DataAddress + offset;
+	}
+
+	struct ObjCFixture
+	{
+		std::string	fileName;
+		uint32_t	dataOffset;
+	};
+
+	/*Foo : Base with two instance methods in a pointer list and one class method in a relative list,
+	a category adding a method to Foo, and one protocol, all referenced by plain pointers*/
+	ObjCFixture objcImage(const std::string& name)
+	{
+		ByteWriter page;
+		page.zeros(0x1000);
+
+		std::vector<std::pair<std::string, uint32_t>> strings;
+		auto placeString = [&](const std::string& text)
+		{
+			uint32_t offset = Strings;
+			for (const auto& placed : strings)
+			{
+				offset = placed.second + static_cast<uint32_t>(placed.first.size()) + 1;
+			}
+			strings.emplace_back(text, offset);
+			for (size_t idx = 0; idx < text.size(); ++idx)
+			{
+				page.patch(offset + idx, text[idx]);
+			}
+			return address(offset);
+		};
+
+		page.patch(ClassList, address(FooClass));
+		page.patch(CategoryList, address(ExtrasCategory));
+		page.patch(ProtocolList, address(RunnableProtocol));
+
+		objc_class_64 foo = {};
+		foo.isa = address(FooMetaclass);
+		foo.superclass = address(BaseClass);
+		foo.data = address(FooData) | 1;	/*runtime flag bits below FAST_DATA_MASK*/
+		page.patch(FooClass, foo);
+
+		objc_class_64 fooMeta = {};
+		fooMeta.data = address(FooMetaData);
+		page.patch(FooMetaclass, fooMeta);
+
+		objc_class_64 base = {};
+		base.data = address(BaseData);
+		page.patch(BaseClass, base);
+
+		const uint64_t types = placeString("v16@0:8");
+
+		class_ro_64 fooData = {};
+		fooData.name = placeString("Foo");
+		fooData.baseMethods = address(FooMethods);
+		page.patch(FooData, fooData);
+
+		class_ro_64 fooMetaData = {};
+		fooMetaData.flags = RO_META;
+		fooMetaData.baseMethods = address(FooClassMethods);
+		page.patch(FooMetaData, fooMetaData);
+
+		class_ro_64 baseData = {};
+		baseData.flags = RO_ROOT;
+		baseData.name = placeString("Base");
+		page.patch(BaseData, baseData);
+
+		page.patch(FooMethods, entsize_list_64{ sizeof(method_64), 2 });
+		page.patch(FooMethods + sizeof(entsize_list_64), method_64{ placeString("run"), types, LoadAddress + 0xf00 });
+		page.patch(FooMethods + sizeof(entsize_list_64) + sizeof(method_64), method_64{ placeString("stop"), types, LoadAddress + 0xf40 });
+
+		/*Relative entries point at a selector reference, not the selector itself*/
+		const uint32_t relativeEntry = FooClassMethods + sizeof(entsize_list_64);
+		page.patch(FooClassMethods, entsize_list_64{ sizeof(method_relative) | METHOD_LIST_IS_RELATIVE, 1 });
+		page.patch(relativeEntry, method_relative{
+			static_cast<int32_t>(SharedSelectorRef - (relativeEntry + offsetof(method_relative, nameOffset))),
+			static_cast<int32_t>(types - address(relativeEntry + offsetof(method_relative, typesOffset))),
+			0 });
+		page.patch(SharedSelectorRef, placeString("shared"));
+
+		category_64 extras = {};
+		extras.name = placeString("Extras");
+		extras.cls = address(FooClass);
+		extras.instanceMethods = address(ExtrasMethods);
+		page.patch(ExtrasCategory, extras);
+		page.patch(ExtrasMethods, entsize_list_64{ sizeof(method_64), 1 });
+		page.patch(ExtrasMethods + sizeof(entsize_list_64), method_64{ placeString("extra"), types, 0 });
+
+		protocol_64 runnable = {};
+		runnable.name = placeString("Runnable");
+		page.patch(RunnableProtocol, runnable);
+
+		MachOBuilder builder(MH_EXECUTE);
+		const uint32_t dataOffset = builder.append(page, 0x1000);
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x1000, 0, 0x1000));
+		builder.segment(makeSegment("__DATA", DataAddress, 0x1000, dataOffset, 0x1000), {
+			makeSection("__DATA", "__objc_classlist", address(ClassList), 8, dataOffset + ClassList),
+			makeSection("__DATA", "__objc_catlist", address(CategoryList), 8, dataOffset + CategoryList),
+			makeSection("__DATA", "__objc_protolist", address(ProtocolList), 8, dataOffset + ProtocolList),
+			makeSection("__DATA", "__objc_data", address(FooClass), FooData - FooClass, dataOffset + FooClass),
+			makeSection("__DATA", "__objc_const", address(FooData), Strings - FooData, dataOffset + FooData),
+			makeSection("__DATA", "__objc_methname", address(Strings), 0x1000 - Strings, dataOffset + Strings) });
+
+		return { builder.write(name), dataOffset };
+	}
+
+	std::vector<std::string_view> selectors(const std::vector<ObjCMethod>& methods)
+	{
+		std::vector<std::string_view> names;
+		for (const auto& method : methods)
+		{
+			names.push_back(corpusNames().name(method.selector));
+		}
+		return names;
+	}
+
+	void checkMetadata(ObjCMetadata& objc)
+	{
+		CHECK(objc.hasMetadata());
+
+		const std::vector<uint64_t> classes = objc.classAddresses();
+		CHECK_EQUAL(size_t(1), classes.size());
+		if (classes.size() != 1)
+		{
+			return;
+		}
+
+		const ObjCClass& foo = objc.objcClass(classes[0]);
+		CHECK_EQUAL(std::string_view("Foo"), corpusNames().name(foo.name));
+		CHECK_EQUAL(std::string_view("Base"), corpusNames().name(foo.superclass));
+
+		const std::vector<ObjCMethod> instanceMethods = objc.methodList(foo.instanceMethods);
+		CHECK(selectors(instanceMethods) == std::vector<std::string_view>({ "run", "stop" }));
+		if (instanceMethods.size() == 2)
+		{
+			CHECK_EQUAL(std::string_view("v16@0:8"), corpusNames().name(instanceMethods[1].types));
+			CHECK_EQUAL(LoadAddress + 0xf40, instanceMethods[1].implementation);
+		}
+
+		const std::vector<ObjCMethod> classMethods = objc.methodList(foo.classMethods);
+		CHECK(selectors(classMethods) == std::vector<std::string_view>({ "shared" }));
+		if (classMethods.size() == 1)
+		{
+			CHECK_EQUAL(std::string_view("v16@0:8"), corpusNames().name(classMethods[0].types));
+			CHECK_EQUAL(uint64_t(0), classMethods[0].implementation);
+		}
+
+		const std::vector<ObjCCategory> categories = objc.categories();
+		CHECK_EQUAL(size_t(1), categories.size());
+		if (categories.size() == 1)
+		{
+			CHECK_EQUAL(std::string_view("Extras"), corpusNames().name(categories[0].name));
+			CHECK_EQUAL(std::string_view("Foo"), corpusNames().name(categories[0].className));
+		}
+
+		const std::vector<NameId> protocols = objc.protocols();
+		CHECK_EQUAL(size_t(1), protocols.size());
+		if (protocols.size() == 1)
+		{
+			CHECK_EQUAL(std::string_view("Runnable"), corpusNames().name(protocols[0]));
+		}
+
+		std::vector<std::string_view> implemented;
+		for (NameId selector : objc.selectorsImplementedBy(foo.name))
+		{
+			implemented.push_back(corpusNames().name(selector));
+		}
+		CHECK(implemented == std::vector<std::string_view>({ "extra", "run", "shared", "stop" }));
+	}
+}
+
+TEST(objcMetadataDecodesClassesCategoriesAndProtocols)
+{
+	const ObjCFixture fixture = objcImage("objc");
+	DecodedFixture decoded(fixture.fileName);
+	ObjCMetadata objc(decoded.fin, decoded.image);
+
+	checkMetadata(objc);
+}
+
+TEST(objcMetadataReadsResidentSectionsWithoutTheFile)
+{
+	const ObjCFixture fixture = objcImage("objc-resident");
+	DecodedFixture decoded(fixture.fileName);
+	const auto page = readArrayAt<uint8_t>(decoded.fin, fixture.dataOffset, 0x1000, ArenaAllocator<uint8_t>(workerArena()));
+
+	/*A stream that was never opened, every read has to come from the resident copy*/
+	std::ifstream closed;
+	ObjCMetadata objc(closed, decoded.image);
+	objc.addResident(fixture.dataOffset, page);
+
+	checkMetadata(objc);
+}
@@ -0,0 +1,182 @@
+#include <cstring>
+#include <limits>
+#include "Fixture.h"
+#include "Reader.h"
+#include "Relocations.h"
+#include "Test.h"
+
+namespace
+{
+	/*Packs a relocation_info the way the linker lays it out in the file*/
+	void relocation(ByteWriter& table, uint32_t address, uint32_t symbolnum, bool pcrel, uint32_t length, bool isExtern, uint32_t type)
+	{
+		table.u32(address);
+		table.u32(symbolnum | uint32_t(pcrel) << 24 | length << 25 | uint32_t(isExtern) << 27 | type << 28);
+	}
+
+	void scatteredRelocation(ByteWriter& table, uint32_t address, bool pcrel, uint32_t length, uint32_t type, int32_t value)
+	{
+		table.u32(0x80000000 | uint32_t(pcrel) << 30 | length << 28 | type << 24 | address);
+		table.u32(static_cast<uint32_t>(value));
+	}
+
+	/*An object file with __text and __data, two symbols, and one relocation of every target kind on __text.
+	nreloc and nsyms override the counts written into the load commands.*/
+	std::string relocatableObject(const std::string& name, uint32_t nreloc = 7, uint32_t nsyms = 2)
+	{
+		MachOBuilder builder(MH_OBJECT);
+
+		ByteWriter strings;
+		strings.u8(0).cstring("_foo").cstring("_bar");
+		const uint32_t stroff = builder.append(strings);
+
+		ByteWriter symbols;
+		symbols.put(makeSymbol(1, N_SECT | N_EXT, 1, 0x0));
+		symbols.put(makeSymbol(6, N_UNDF | N_EXT, 0, 0x0));
+		const uint32_t symoff = builder.append(symbols);
+
+		ByteWriter relocations;
+		relocation(relocations, 0x4, 1, true, 2, true, 2);
+		relocation(relocations, 0x8, 2, false, 3, false, 0);
+		scatteredRelocation(relocations, 0xc, false, 2, 0, 0x24);
+		scatteredRelocation(relocations, 0x10, false, 2, 0, 0x1000);
+		relocation(relocations, 0x14, 7, false, 3, true, 0);
+		relocation(relocations, 0x18, R_ABS, false, 3, false, 0);
+		relocation(relocations, 0x1c, 9, false, 3, false, 0);
+		const uint32_t reloff = builder.append(relocations);
+
+		section_64 text = makeSection("__TEXT", "__text", 0x0, 0x20, 0);
+		text.reloff = reloff;
+		text.nreloc = nreloc;
+		builder.segment(makeSegment("", 0x0, 0x30, 0, 0), { text, makeSection("__DATA", "__data", 0x20, 0x10, 0) });
+
+		symtab_command symtab = {};
+		symtab.cmd = LC_SYMTAB;
+		symtab.symoff = symoff;
+		symtab.nsyms = nsyms;
+		symtab.stroff = stroff;
+		symtab.strsize = static_cast<uint32_t>(strings.size());
+		builder.command(symtab);
+
+		return builder.write(name);
+	}
+}
+
+TEST(relocationsResolveEveryTargetKind)
+{
+	DecodedFixture fixture(relocatableObject("relocations.o"));
+	SymbolTable symbols(fixture.fin, *findCommand<symtab_command>(fixture.image));
+	const RelocationTable table = decodeRelocations(fixture.fin, fixture.image.sections[0], fixture.image, symbols);
+
+	CHECK_EQUAL(size_t(7), table.size());
+
+	CHECK(table.targetKind[0] == RelocationTarget::Symbol);
+	CHECK_EQUAL(0x4u, table.address[0]);
+	CHECK_EQUAL(1, int(table.pcrel[0]));
+	CHECK_EQUAL(2, int(table.length[0]));
+	CHECK_EQUAL(2, int(table.type[0]));
+	CHECK_EQUAL(std::string_view("_bar"), relocationTargetName(table, 0, fixture.image, symbols));
+
+	CHECK(table.targetKind[1] == RelocationTarget::Section);
+	CHECK_EQUAL(std::string_view("__data"), relocationTargetName(table, 1, fixture.image, symbols));
+
+	/*Scattered entries find their section from the address in r_value*/
+	CHECK_EQUAL(1, int(table.scattered[2]));
+	CHECK_EQUAL(0xcu, table.address[2]);
+	CHECK_EQUAL(0x24, table.value[2]);
+	CHECK(table.targetKind[2] == RelocationTarget::Section);
+	CHECK_EQUAL(2u, table.target[2]);
+
+	CHECK(table.targetKind[3] == RelocationTarget::Absolute);
+	CHECK(table.targetKind[4] == RelocationTarget::Unresolved);
+	CHECK(table.targetKind[5] == RelocationTarget::Absolute);
+	CHECK(table.targetKind[6] == RelocationTarget::Unresolved);
+	CHECK(relocationTargetName(table, 6, fixture.image, symbols).empty());
+}
+
+TEST(relocationIndexFindsEntriesByAddress)
+{
+	DecodedFixture fixture(relocatableObject("relocations-index.o"));
+	SymbolTable symbols(fixture.fin, *findCommand<symtab_command>(fixture.image));
+	RelocationIndex index(fixture.fin, fixture.image, symbols);
+
+	const std::optional<RelocationAt> symbol = index.find(0x4);
+	CHECK(symbol && symbol->entry == 0);
+	CHECK(symbol && relocationTargetName(*symbol->table, symbol->entry, fixture.image, symbols) == "_bar");
+
+	const std::optional<RelocationAt> scattered = index.find(0xc);
+	CHECK(scattered && scattered->table->scattered[scattered->entry]);
+
+	/*Inside __text between entries, and in __data which has no relocations at all*/
+	CHECK(!index.find(0x6));
+	CHECK(!index.find(0x24));
+	CHECK(index.forSection(1) && index.forSection(1)->size() == 0);
+
+	/*A section handed in without a table has none, rather than being read from the file*/
+	index.adopt(0, std::nullopt);
+	CHECK(!index.forSection(0));
+	CHECK(!index.find(0x4));
+}
+
+TEST(arm64AddendsAttachToTheNextEntry)
+{
+	DecodedFixture fixture(relocatableObject("relocations-arm64.o"));
+	SymbolTable symbols(fixture.fin, *findCommand<symtab_command>(fixture.image));
+
+	ByteWriter entries;
+	relocation(entries, 0x8, 0xfffff0, false, 2, false, ARM64_RELOC_ADDEND);
+	relocation(entries, 0x8, 1, true, 2, true, ARM64_RELOC_PAGE21);
+	relocation(entries, 0x4, 0x20, false, 2, false, ARM64_RELOC_ADDEND);
+	relocation(entries, 0x4, 0, false, 2, true, ARM64_RELOC_PAGEOFF12);
+	relocation(entries, 0x0, 1, true, 2, true, ARM64_RELOC_BRANCH26);
+	std::vector<uint32_t> words(entries.size() / sizeof(uint32_t));
+	memcpy(words.data(), entries.data().data(), entries.size());
+
+	fixture.image.header.cputype = CPU_TYPE_ARM64;
+	const RelocationTable table = decodeRelocationWords(words.data(), words.size() / 2, fixture.image, symbols);
+
+	/*r_symbolnum of an addend entry is a signed 24 bit value, not a section ordinal*/
+	CHECK(table.targetKind[0] == RelocationTarget::Addend);
+	CHECK_EQUAL(-16, table.addend[1]);
+	CHECK_EQUAL(std::string_view("_bar"), relocationTargetName(table, 1, fixture.image, symbols));
+	CHECK(table.targetKind[2] == RelocationTarget::Addend);
+	CHECK_EQUAL(0x20, table.addend[3]);
+	CHECK_EQUAL(std::string_view("_foo"), relocationTargetName(table, 3, fixture.image, symbols));
+	CHECK_EQUAL(0, table.addend[4]);
+
+	/*Type 10 means something else on other architectures*/
+	fixture.image.header.cputype = 0x01000007;
+	const RelocationTable x86 = decodeRelocationWords(words.data(), words.size() / 2, fixture.image, symbols);
+	CHECK(x86.targetKind[0] == RelocationTarget::Unresolved);
+	CHECK_EQUAL(0, x86.addend[1]);
+}
+
+TEST(relocationCountsPastEndOfFileAreClipped)
+{
+	const uint32_t huge = std::numeric_limits<uint32_t>::max();
+	DecodedFixture fixture(relocatableObject("relocations-huge.o", huge, huge));
+
+	/*Both tables would need gigabytes if the counts were believed, the file holds 7 relocations and 2 symbols*/
+	SymbolTable symbols(fixture.fin, *findCommand<symtab_command>(fixture.image));
+	const RelocationTable table = decodeRelocations(fixture.fin, fixture.image.sections[0], fixture.image, symbols);
+
+	CHECK_EQUAL(size_t(7), table.size());
+	CHECK(symbols.size() < 100);
+	CHECK_EQUAL(std::string_view("_bar"), relocationTargetName(table, 0, fixture.image, symbols));
+}
+
+TEST(readArrayAtClipsToFileSize)
+{
+	ByteWriter bytes;
+	bytes.u32(1).u32(2).u32(3);
+	const std::string fileName = fixturePath("words.bin");
+	writeFile(fileName, bytes.data());
+	std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+
+	CHECK_EQUAL(size_t(2), readArrayAt<uint32_t>(fin, 4, 2).size());
+	const auto clipped = readArrayAt<uint32_t>(fin, 4, size_t(1) << 40);
+	CHECK_EQUAL(size_t(2), clipped.size());
+	CHECK_EQUAL(3u, clipped[1]);
+	CHECK(readArrayAt<uint32_t>(fin, 1 << 20, size_t(1) << 40).empty());
+	CHECK(fin.good());
+}
@@ -0,0 +1,87 @@
+#include "Fixture.h"
+#include "SectionProfile.h"
+#include "Test.h"
+
+namespace
+{
+	/*__TEXT,__text holds 32 printable and 32 zero bytes.  The other sections have no file contents:
+	zero fill, a dSYM style section at offset 0, and one that runs past its segment's filesize.*/
+	std::string profiledImage(const std::string& name)
+	{
+		MachOBuilder builder(MH_EXECUTE);
+
+		ByteWriter text;
+		for (int idx = 0; idx < 32; ++idx)
+		{
+			text.u8('a');
+		}
+		text.zeros(32);
+		const uint32_t textOffset = builder.append(text, 0x1000);
+		const uint32_t dataOffset = builder.append(ByteWriter().zeros(0x40), 0x1000);
+
+		builder.segment(makeSegment("__TEXT", 0x100000000, 0x2000, 0, textOffset + 0x40), {
+			makeSection("__TEXT", "__text", 0x100001000, 0x40, textOffset) });
+		builder.segment(makeSegment("__DATA", 0x100002000, 0x1000, dataOffset, 0x40), {
+			makeSection("__DATA", "__bss", 0x100002000, 0x100, dataOffset, S_ZEROFILL),
+			makeSection("__DATA", "__const", 0x100002100, 0x40, 0),
+			makeSection("__DATA", "__data", 0x100002200, 0x80, dataOffset) });
+
+		return builder.write(name);
+	}
+}
+
+TEST(sectionProfileSkipsSectionsWithoutFileContents)
+{
+	const std::string fileName = profiledImage("profile");
+	DecodedFixture fixture(fileName);
+
+	CHECK(hasFileContents(fixture.image, 0));
+	CHECK(!hasFileContents(fixture.image, 1));
+	CHECK(!hasFileContents(fixture.image, 2));
+	CHECK(!hasFileContents(fixture.image, 3));
+
+	const std::vector<SectionProfile> profiles = profileSections(fileName, fixture.image);
+	CHECK_EQUAL(size_t(4), profiles.size());
+	CHECK_EQUAL(uint64_t(0x40), profiles[0].size);
+	CHECK_EQUAL(1.0, profiles[0].entropy);
+	CHECK_EQUAL(0.5, profiles[0].printableDensity);
+	CHECK_EQUAL(uint64_t(32), profiles[0].histogram['a']);
+
+	CHECK_EQUAL(uint64_t(0), profiles[1].size);
+	CHECK_EQUAL(uint64_t(0), profiles[2].size);
+	CHECK_EQUAL(uint64_t(0), profiles[3].size);
+}
+
+TEST(sectionProfilerMatchesAcrossPieces)
+{
+	std::vector<uint8_t> bytes;
+	for (int idx = 0; idx < 1000; ++idx)
+	{
+		bytes.push_back(static_cast<uint8_t>(idx % 10 == 0 ? 0 : 'x'));
+	}
+
+	SectionProfiler whole;
+	whole.accumulate(bytes.data(), bytes.size());
+	SectionProfiler pieces;
+	pieces.accumulate(bytes.data(), 7);
+	pieces.accumulate(bytes.data() + 7, bytes.size() - 7);
+
+	const SectionProfile wholeProfile = whole.finish();
+	const SectionProfile piecesProfile = pieces.finish();
+	CHECK(wholeProfile.histogram == piecesProfile.histogram);
+	CHECK_EQUAL(wholeProfile.entropy, piecesProfile.entropy);
+	CHECK_EQUAL(wholeProfile.printableDensity, piecesProfile.printableDensity);
+}
+
+TEST(commonBytesRanksByCount)
+{
+	std::array<uint64_t, 256> histogram = {};
+	histogram[0x00] = 5;
+	histogram[0x41] = 9;
+	histogram[0xff] = 5;
+	histogram[0x10] = 1;
+
+	CHECK(commonBytes(histogram, 3) == std::vector<uint8_t>({ 0x41, 0x00, 0xff }));
+	CHECK(commonBytes(histogram, 8) == std::vector<uint8_t>({ 0x41, 0x00, 0xff, 0x10 }));
+	CHECK(commonBytes(std::array<uint64_t, 256>{}, 3).empty());
+}
@@ -0,0 +1,113 @@
+#include <sstream>
+#include <stdexcept>
+#include "Fixture.h"
+#include "SharedCache.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t CacheAddress = 0x180000000;
+	const uint32_t ImageOffset = 0x4000;
+	const char ImagePath[] = "/usr/lib/libfoo.dylib";
+
+	const uint64_t ExportOffset = 0x20;
+
+	/*A cache with one mapping covering one dylib that exports _foo, optionally claiming sub caches it doesn't ship.
+	Like every cache image the dylib's linkedit offsets are offsets in the cache file, not in the image.*/
+	std::string cacheFile(const std::string& name, uint32_t subCacheCount)
+	{
+		ByteWriter trie;
+		trie.u8(0).u8(1).cstring("_foo").uleb(8);
+		trie.uleb(2).uleb(0).uleb(ExportOffset).u8(0);
+
+		MachOBuilder dylib(MH_DYLIB);
+		const uint32_t trieOffset = dylib.append(trie);
+		dylib.segment(makeSegment("__TEXT", CacheAddress, 0x2000, ImageOffset, 0x2000));
+		dylib_command id = {};
+		id.cmd = LC_ID_DYLIB;
+		id.dylib.name.offset = sizeof(dylib_command);
+		dylib.command(id, ImagePath);
+
+		linkedit_data_command exportsTrie = {};
+		exportsTrie.cmd = LC_DYLD_EXPORTS_TRIE;
+		exportsTrie.dataoff = ImageOffset + trieOffset;
+		exportsTrie.datasize = static_cast<uint32_t>(trie.size());
+		dylib.command(exportsTrie);
+
+		std::vector<uint8_t> image = dylib.bytes();
+		image.resize(0x2000);
+
+		dyld_cache_header header = {};
+		memcpy(header.magic, "dyld_v1  arm64e", sizeof(header.magic));
+		header.mappingOffset = sizeof(dyld_cache_header);
+		header.mappingCount = 1;
+		header.imagesOffset = sizeof(dyld_cache_header) + sizeof(dyld_cache_mapping_info);
+		header.imagesCount = 1;
+		header.subCacheArrayCount = subCacheCount;
+
+		dyld_cache_mapping_info mapping = {};
+		mapping.address = CacheAddress;
+		mapping.size = image.size();
+		mapping.fileOffset = ImageOffset;
+
+		dyld_cache_image_info info = {};
+		info.address = CacheAddress;
+		info.pathFileOffset = header.imagesOffset + sizeof(dyld_cache_image_info);
+
+		ByteWriter cache;
+		cache.put(header).put(mapping).put(info).cstring(ImagePath);
+		cache.zeros(ImageOffset - cache.size()).raw(image.data(), image.size());
+
+		const std::string fileName = fixturePath(name);
+		writeFile(fileName, cache.data());
+		return fileName;
+	}
+
+	std::string readWhole(const std::string& fileName)
+	{
+		std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+		std::ostringstream text;
+		text << fin.rdbuf();
+		return text.str();
+	}
+}
+
+TEST(sharedCacheReadsImageTable)
+{
+	const std::string fileName = cacheFile("single.cache", 0);
+	CHECK(isSharedCache(fileName));
+
+	const SharedCache cache(fileName);
+	CHECK_EQUAL(size_t(1), cache.imageCount());
+	CHECK_EQUAL(std::string_view(ImagePath), cache.imagePath(0));
+	CHECK_EQUAL(uint64_t(ImageOffset + 0x10), cache.fileOffset(CacheAddress + 0x10).value_or(0));
+	CHECK(!cache.fileOffset(CacheAddress + 0x2000));
+
+	const std::string output = fixturePath("single.cache.txt");
+	decodeSharedCache(fileName, output, DecodeOptions());
+	const std::string text = readWhole(output);
+	CHECK(text.find("Cache Images : 1") != std::string::npos);
+	CHECK(text.find("Image : /usr/lib/libfoo.dylib") != std::string::npos);
+	CHECK(text.find("Install Name : /usr/lib/libfoo.dylib") != std::string::npos);
+
+	/*__TEXT maps the image from ImageOffset, exports are still relative to its vmaddr*/
+	std::ostringstream expected;
+	expected << "Export : _foo 0x" << std::hex << CacheAddress + ExportOffset;
+	CHECK(text.find(expected.str()) != std::string::npos);
+}
+
+TEST(sharedCacheRefusesSplitCaches)
+{
+	const std::string fileName = cacheFile("split.cache", 3);
+
+	bool refused = false;
+	try
+	{
+		SharedCache cache(fileName);
+	}
+	catch (const std::runtime_error&)
+	{
+		refused = true;
+	}
+	CHECK(refused);
+}
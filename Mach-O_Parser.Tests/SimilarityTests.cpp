@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <stdexcept>
+#include "Fixture.h"
+#include "Similarity.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t LoadAddress = 0x100000000;
+
+	/*Elements first through last - 1, each spread over 64 bits the way real element hashes are*/
+	MinHash signRange(uint64_t first, uint64_t last)
+	{
+		MinHasher hasher;
+		for (uint64_t element = first; element < last; ++element)
+		{
+			hasher.add(element * 0x9e3779b97f4a7c15ULL);
+		}
+		return hasher.signature();
+	}
+
+	ImageSignature namesOnly(const MinHash& names)
+	{
+		return ImageSignature{ MinHash(), names, false, true };
+	}
+
+	/*A dylib exporting every name in exports from a one node per name trie*/
+	std::string exportingImage(const std::string& name, const std::vector<std::string>& exports)
+	{
+		ByteWriter trie;
+		size_t rootSize = 2;
+		for (const auto& symbol : exports)
+		{
+			rootSize += symbol.size() + 2;
+		}
+		trie.u8(0).u8(static_cast<uint8_t>(exports.size()));
+		size_t child = rootSize;
+		for (const auto& symbol : exports)
+		{
+			trie.cstring(symbol).uleb(child);
+			child += 4;
+		}
+		for (size_t idx = 0; idx < exports.size(); ++idx)
+		{
+			trie.uleb(2).uleb(0).uleb(0x10 + idx).u8(0);
+		}
+
+		MachOBuilder builder(MH_DYLIB);
+		const uint32_t trieOffset = builder.append(trie);
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x1000, 0, 0x1000));
+
+		linkedit_data_command exportsTrie = {};
+		exportsTrie.cmd = LC_DYLD_EXPORTS_TRIE;
+		exportsTrie.dataoff = trieOffset;
+		exportsTrie.datasize = static_cast<uint32_t>(trie.size());
+		builder.command(exportsTrie);
+
+		return builder.write(name);
+	}
+
+	/*size bytes from a simple generator, runs from different seeds share no shingles*/
+	std::vector<uint8_t> noise(size_t size, uint32_t seed)
+	{
+		std::vector<uint8_t> bytes(size);
+		for (auto& byte : bytes)
+		{
+			seed = seed * 1664525 + 1013904223;
+			byte = static_cast<uint8_t>(seed >> 24);
+		}
+		return bytes;
+	}
+
+	/*An executable whose __TEXT holds a __text larger than one read chunk and a short __cstring*/
+	std::string codeImage(const std::string& name, const std::vector<uint8_t>& text, const std::vector<uint8_t>& cstrings)
+	{
+		MachOBuilder builder(MH_EXECUTE);
+		const uint32_t textOffset = builder.append(text, 0x1000);
+		const uint32_t cstringOffset = builder.append(cstrings);
+		const uint64_t textEnd = cstringOffset + cstrings.size();
+
+		builder.segment(makeSegment("__TEXT", LoadAddress, textEnd, 0, textEnd), {
+			makeSection("__TEXT", "__text", LoadAddress + textOffset, text.size(), textOffset),
+			makeSection("__TEXT", "__cstring", LoadAddress + cstringOffset, cstrings.size(), cstringOffset, S_CSTRING_LITERALS) });
+
+		return builder.write(name);
+	}
+}
+
+TEST(minHashShinglesMatchAcrossPieces)
+{
+	std::vector<uint8_t> bytes(1000);
+	for (size_t idx = 0; idx < bytes.size(); ++idx)
+	{
+		bytes[idx] = static_cast<uint8_t>(idx * 31 + idx / 7);
+	}
+
+	MinHasher whole;
+	whole.addShingles(bytes.data(), bytes.size());
+
+	/*Pieces shorter than a shingle have to carry over more than one call*/
+	MinHasher pieces;
+	size_t done = 0;
+	for (size_t size : { 3, 1, 2, 5, 100, 6, 883 })
+	{
+		pieces.addShingles(bytes.data() + done, size);
+		done += size;
+	}
+	CHECK_EQUAL(bytes.size(), done);
+	CHECK(whole.signature() == pieces.signature());
+
+	/*A new run doesn't make shingles across the break, two 8 byte runs are two shingles rather than nine*/
+	MinHasher joined;
+	joined.addShingles(bytes.data(), 8);
+	joined.addShingles(bytes.data() + 8, 8);
+	MinHasher restarted;
+	restarted.addShingles(bytes.data(), 8);
+	restarted.resetShingles();
+	restarted.addShingles(bytes.data() + 8, 8);
+	CHECK(joined.signature() != restarted.signature());
+}
+
+TEST(minHashEstimatesJaccardSimilarity)
+{
+	CHECK_EQUAL(1.0, estimateSimilarity(signRange(0, 1000), signRange(0, 1000)));
+	CHECK(estimateSimilarity(signRange(0, 1000), signRange(5000, 6000)) < 0.1);
+
+	/*Sharing 600 of 1400 elements is a Jaccard similarity of 0.43*/
+	const double estimate = estimateSimilarity(signRange(0, 1000), signRange(400, 1400));
+	CHECK(estimate > 0.25 && estimate < 0.6);
+}
+
+TEST(similarityIndexFindsBandedCandidates)
+{
+	SimilarityIndex index;
+	const uint32_t original = index.add(namesOnly(signRange(0, 1000)));
+	const uint32_t unrelated = index.add(namesOnly(signRange(5000, 6000)));
+	const uint32_t nearCopy = index.add(namesOnly(signRange(10, 1010)));
+	index.add(ImageSignature{ MinHash(), MinHash(), false, false });
+	index.freeze();
+	CHECK_EQUAL(size_t(4), index.size());
+
+	const std::vector<SimilarityMatch> matches = index.query(namesOnly(signRange(0, 1000)), 0.5);
+	CHECK_EQUAL(size_t(2), matches.size());
+	if (matches.size() == 2)
+	{
+		CHECK_EQUAL(original, matches[0].image);
+		CHECK_EQUAL(1.0, matches[0].names);
+		CHECK_EQUAL(nearCopy, matches[1].image);
+	}
+
+	/*Nothing is filed for an empty signature, so an empty query has no candidates at all*/
+	CHECK(index.query(ImageSignature{ MinHash(), MinHash(), false, false }, 0.0).empty());
+	const std::vector<SimilarityMatch> unrelatedMatches = index.query(namesOnly(signRange(5000, 6000)), 0.5);
+	CHECK_EQUAL(size_t(1), unrelatedMatches.size());
+	CHECK(!unrelatedMatches.empty() && unrelatedMatches[0].image == unrelated);
+}
+
+TEST(storedSimilarityIndexMatchesInMemory)
+{
+	SimilarityIndex index;
+	std::vector<std::string> paths;
+	for (uint64_t image = 0; image < 20; ++image)
+	{
+		/*Images in pairs, 1000 apart with the two of a pair 20 elements apart*/
+		const uint64_t first = (image / 2) * 1000 + (image % 2) * 20;
+		index.add(namesOnly(signRange(first, first + 500)));
+		paths.push_back("/corpus/image" + std::to_string(image));
+	}
+	index.freeze();
+
+	const std::string fileName = fixturePath("similarity.idx");
+	index.write(fileName, paths);
+
+	StoredSimilarityIndex stored(fileName);
+	CHECK_EQUAL(size_t(20), stored.size());
+	CHECK_EQUAL(std::string("/corpus/image7"), stored.path(7));
+	CHECK_EQUAL(std::string(), stored.path(20));
+
+	for (uint64_t first : { uint64_t(3000), uint64_t(7010), uint64_t(100000) })
+	{
+		const ImageSignature query = namesOnly(signRange(first, first + 500));
+		const std::vector<SimilarityMatch> expected = index.query(query, 0.3);
+		const std::vector<SimilarityMatch> found = stored.query(query, 0.3);
+
+		CHECK_EQUAL(expected.size(), found.size());
+		for (size_t idx = 0; idx < std::min(expected.size(), found.size()); ++idx)
+		{
+			CHECK_EQUAL(expected[idx].image, found[idx].image);
+			CHECK_EQUAL(expected[idx].names, found[idx].names);
+		}
+	}
+
+	bool refused = false;
+	try
+	{
+		StoredSimilarityIndex notAnIndex(exportingImage("similarity-not-index", { "_a" }));
+	}
+	catch (const std::runtime_error&)
+	{
+		refused = true;
+	}
+	CHECK(refused);
+}
+
+TEST(signImageHashesExportsWithoutInterning)
+{
+	const std::string first = exportingImage("similarity-exports-a", { "_alpha", "_beta", "_gamma" });
+	const std::string second = exportingImage("similarity-exports-b", { "_alpha", "_beta", "_delta" });
+
+	const std::optional<ImageSignature> firstSignature = signImage(first);
+	const size_t corpusSize = corpusNames().size();
+	const std::optional<ImageSignature> secondSignature = signImage(second);
+
+	/*The second image's segment names are already interned and its export names never are*/
+	CHECK_EQUAL(corpusSize, corpusNames().size());
+
+	CHECK(firstSignature && firstSignature->hasNames);
+	CHECK(secondSignature && secondSignature->hasNames);
+	if (firstSignature && secondSignature)
+	{
+		CHECK(estimateSimilarity(firstSignature->names, secondSignature->names) < 1.0);
+		CHECK(estimateSimilarity(firstSignature->names, signImage(first)->names) == 1.0);
+	}
+}
+
+TEST(signImageShinglesTextSections)
+{
+	/*The second __text keeps the first half of the first and replaces the rest*/
+	const size_t textSize = (1 << 20) + 0x1000;
+	const std::vector<uint8_t> text = noise(textSize, 1);
+	std::vector<uint8_t> changedText = text;
+	const std::vector<uint8_t> tail = noise(textSize / 2, 2);
+	std::copy(tail.begin(), tail.end(), changedText.begin() + textSize / 2);
+	const std::vector<uint8_t> cstrings = noise(0x100, 3);
+
+	const std::string first = codeImage("similarity-code-a", text, cstrings);
+	const std::string second = codeImage("similarity-code-b", changedText, cstrings);
+	const std::vector<std::optional<ImageSignature>> signatures = signImages({ first, second, fixturePath("similarity-missing") });
+	CHECK_EQUAL(size_t(3), signatures.size());
+	CHECK(signatures[0] && signatures[0]->hasCode && !signatures[0]->hasNames);
+	CHECK(signatures[1] && signatures[1]->hasCode);
+	CHECK(!signatures[2]);
+
+	/*Read in chunks, each section still shingles as one run, and no shingle spans two sections*/
+	MinHasher expected;
+	expected.addShingles(text.data(), text.size());
+	expected.resetShingles();
+	expected.addShingles(cstrings.data(), cstrings.size());
+	CHECK(signatures[0] && signatures[0]->code == expected.signature());
+
+	if (signatures[0] && signatures[1])
+	{
+		const double similarity = estimateSimilarity(signatures[0]->code, signatures[1]->code);
+		CHECK(similarity > 0.0 && similarity < 1.0);
+	}
+}
+
+TEST(similarityIndexFindsPairsAtTheThreshold)
+{
+	/*Pairs sharing 800 of 1600 elements, a Jaccard similarity of exactly 0.5*/
+	SimilarityIndex index;
+	const uint64_t pairs = 40;
+	for (uint64_t pair = 0; pair < pairs; ++pair)
+	{
+		index.add(namesOnly(signRange(pair * 10000, pair * 10000 + 1200)));
+	}
+	index.freeze();
+
+	/*A zero threshold returns every candidate, so this is the banding's recall alone*/
+	size_t found = 0;
+	for (uint64_t pair = 0; pair < pairs; ++pair)
+	{
+		const std::vector<SimilarityMatch> matches = index.query(namesOnly(signRange(pair * 10000 + 400, pair * 10000 + 1600)), 0.0);
+		found += std::any_of(matches.begin(), matches.end(), [pair](const SimilarityMatch& match) { return match.image == pair; });
+	}
+	CHECK_EQUAL(size_t(pairs), found);
+}
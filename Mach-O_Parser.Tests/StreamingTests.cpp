@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <sstream>
+#include "Fixture.h"
+#include "Reader.h"
+#include "Streaming.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t LoadAddress = 0x100000000;
+
+	/*0x5000 bytes that differ from their neighbours, so a misplaced piece shows*/
+	std::string patternFile(const std::string& name)
+	{
+		std::vector<uint8_t> bytes(0x5000);
+		for (size_t idx = 0; idx < bytes.size(); ++idx)
+		{
+			bytes[idx] = static_cast<uint8_t>(idx * 7 + idx / 251);
+		}
+
+		const std::string fileName = fixturePath(name);
+		writeFile(fileName, bytes);
+		return fileName;
+	}
+
+	/*A dylib with a __got of two pointers bound to _malloc and _free from libSystem, a local symbol the
+	indirect table doesn't name, and an export trie holding _main*/
+	std::string linkeditImage(const std::string& name)
+	{
+		MachOBuilder builder(MH_DYLIB);
+
+		const uint32_t gotOffset = builder.append(ByteWriter().zeros(0x10), 0x1000);
+
+		ByteWriter strings;
+		strings.u8(0).cstring("_local").cstring("_malloc").cstring("_free");
+		const uint32_t stroff = builder.append(strings);
+
+		ByteWriter symbols;
+		symbols.put(makeSymbol(1, N_SECT, 2, LoadAddress + 0x1000));
+		nlist_64 malloc = makeSymbol(8, N_UNDF | N_EXT, 0, 0);
+		nlist_64 free = makeSymbol(16, N_UNDF | N_EXT, 0, 0);
+		malloc.n_desc = free.n_desc = 1 << 8;	/*library ordinal 1*/
+		symbols.put(malloc).put(free);
+		const uint32_t symoff = builder.append(symbols);
+
+		ByteWriter indirect;
+		indirect.u32(2).u32(1);
+		const uint32_t indirectOffset = builder.append(indirect);
+
+		/*root -> "_main" -> terminal at 0x10*/
+		ByteWriter trie;
+		trie.u8(0).u8(1).cstring("_main").uleb(9);
+		trie.uleb(2).uleb(0).uleb(0x10).u8(0);
+		const uint32_t trieOffset = builder.append(trie);
+
+		section_64 got = makeSection("__DATA", "__got", LoadAddress + 0x1000, 0x10, gotOffset, S_NON_LAZY_SYMBOL_POINTERS);
+		got.reserved1 = 0;
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x1000, 0, 0x1000));
+		builder.segment(makeSegment("__DATA", LoadAddress + 0x1000, 0x1000, gotOffset, 0x1000), { got });
+		builder.segment(makeSegment("__LINKEDIT", LoadAddress + 0x2000, 0x1000, stroff, trieOffset + trie.size() - stroff));
+
+		dylib_command libSystem = {};
+		libSystem.cmd = LC_LOAD_DYLIB;
+		libSystem.dylib.name.offset = sizeof(dylib_command);
+		builder.command(libSystem, "/usr/lib/libSystem.B.dylib");
+
+		symtab_command symtab = {};
+		symtab.cmd = LC_SYMTAB;
+		symtab.symoff = symoff;
+		symtab.nsyms = 3;
+		symtab.stroff = stroff;
+		symtab.strsize = static_cast<uint32_t>(strings.size());
+		builder.command(symtab);
+
+		dysymtab_command dysymtab = {};
+		dysymtab.cmd = LC_DYSYMTAB;
+		dysymtab.indirectsymoff = indirectOffset;
+		dysymtab.nindirectsyms = 2;
+		builder.command(dysymtab);
+
+		linkedit_data_command exportsTrie = {};
+		exportsTrie.cmd = LC_DYLD_EXPORTS_TRIE;
+		exportsTrie.dataoff = trieOffset;
+		exportsTrie.datasize = static_cast<uint32_t>(trie.size());
+		builder.command(exportsTrie);
+
+		return builder.write(name);
+	}
+
+	/*An executable whose __objc_methname is retained whole when streaming, and a __DWARF segment
+	without sections*/
+	std::string objcAndDwarfImage(const std::string& name)
+	{
+		MachOBuilder builder(MH_EXECUTE);
+
+		ByteWriter names;
+		names.cstring("init").cstring("dealloc").cstring("description");
+		const uint32_t namesOffset = builder.append(names);
+		const uint32_t dwarfOffset = builder.append(ByteWriter().zeros(0x40));
+
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x2000, 0, 0x2000),
+			{ makeSection("__TEXT", "__objc_methname", LoadAddress + namesOffset, names.size(), namesOffset, S_CSTRING_LITERALS) });
+		builder.segment(makeSegment("__DWARF", LoadAddress + 0x2000, 0x1000, dwarfOffset, 0x40));
+
+		return builder.write(name);
+	}
+
+	/*writeImage output, without the segment profiles only streaming writes*/
+	std::string writeFixture(const std::string& fileName, size_t streamMemoryLimit)
+	{
+		DecodedFixture fixture(fileName);
+		DecodeOptions options;
+		options.streamMemoryLimit = streamMemoryLimit;
+
+		std::ostringstream fout;
+		writeImage(fixture.fin, fout, fileName, fixture.image, options);
+
+		std::istringstream lines(fout.str());
+		std::string output;
+		for (std::string line; std::getline(lines, line);)
+		{
+			if (line.rfind("Segment Profile : ", 0) != 0)
+			{
+				output += line + "\n";
+			}
+		}
+		return output;
+	}
+}
+
+TEST(streamSchedulerRetainsRangesWithinTheLimit)
+{
+	const std::string fileName = patternFile("stream-retain.bin");
+	std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+	const auto whole = readArrayAt<uint8_t>(fin, 0, 0x5000);
+
+	StreamOptions options;
+	options.memoryLimit = 0x4000;
+	options.windowSize = 0x1000;
+	StreamScheduler scheduler(fileName, options);
+
+	ArenaAllocator<uint8_t> allocator(workerArena());
+	ArenaVector<uint8_t> retained(allocator);
+	ArenaVector<uint8_t> refused(allocator);
+	CHECK(scheduler.retain(0x100, 0x1800, retained));
+	CHECK(!scheduler.retain(0x2000, 0x1000, refused));
+	CHECK_EQUAL(uint64_t(0x1800), scheduler.bytesRetained());
+
+	std::vector<uint8_t> streamed;
+	scheduler.schedule(0x1000, 0x2000, [&streamed](uint64_t, const uint8_t* data, size_t size)
+	{
+		streamed.insert(streamed.end(), data, data + size);
+	});
+	scheduler.run();
+
+	/*What the retained copy leaves of the limit still holds two whole windows*/
+	CHECK_EQUAL(size_t(0x1000), scheduler.windowSize());
+	CHECK_EQUAL(size_t(2), scheduler.windowCount());
+
+	CHECK(std::equal(retained.begin(), retained.end(), whole.begin() + 0x100));
+	CHECK_EQUAL(size_t(0x1800), retained.size());
+	CHECK(std::equal(streamed.begin(), streamed.end(), whole.begin() + 0x1000));
+	CHECK_EQUAL(size_t(0x2000), streamed.size());
+	CHECK(refused.empty());
+}
+
+TEST(streamSchedulerRetainsWordsAndChargesReservations)
+{
+	const std::string fileName = patternFile("stream-words.bin");
+	std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+	const auto whole = readArrayAt<uint32_t>(fin, 0x100, 0x200);
+
+	StreamOptions options;
+	options.memoryLimit = 0x3000;
+	StreamScheduler scheduler(fileName, options);
+	CHECK_EQUAL(uint64_t(0x1000), scheduler.unreserved());
+
+	/*A trailing partial word is neither read nor charged*/
+	ArenaVector<uint32_t> words{ ArenaAllocator<uint32_t>(workerArena()) };
+	CHECK(scheduler.reserve(0x700));
+	CHECK(scheduler.retain(0x100, 0x803, words));
+	CHECK_EQUAL(uint64_t(0xf00), scheduler.bytesRetained());
+	CHECK(!scheduler.reserve(0x101));
+	CHECK(scheduler.reserve(0x100));
+	CHECK_EQUAL(uint64_t(0), scheduler.unreserved());
+	scheduler.run();
+
+	CHECK_EQUAL(size_t(0x200), words.size());
+	CHECK(std::equal(words.begin(), words.end(), whole.begin()));
+}
+
+TEST(streamSchedulerTrimsRetainedRangesToTheFile)
+{
+	const std::string fileName = patternFile("stream-truncated.bin");
+	StreamOptions options;
+	options.memoryLimit = 0x8000;
+	StreamScheduler scheduler(fileName, options);
+
+	ArenaVector<uint8_t> retained{ ArenaAllocator<uint8_t>(workerArena()) };
+	CHECK(scheduler.retain(0x4800, 0x1000, retained));
+	scheduler.run();
+
+	CHECK_EQUAL(size_t(0x800), retained.size());
+}
+
+TEST(streamedDecodeMatchesWholeReads)
+{
+	const std::string fileName = linkeditImage("stream-linkedit");
+	const std::string whole = writeFixture(fileName, 0);
+
+	CHECK(whole.find("Symbol Pointer : 0x100001000 -> _free (/usr/lib/libSystem.B.dylib)") != std::string::npos);
+	CHECK(whole.find("Symbol Pointer : 0x100001008 -> _malloc (/usr/lib/libSystem.B.dylib)") != std::string::npos);
+	CHECK(whole.find("Export : _main 0x100000010") != std::string::npos);
+	CHECK_EQUAL(whole, writeFixture(fileName, 0x10000));
+}
+
+TEST(streamedDecodeReportsTablesThatDontFit)
+{
+	const std::string fileName = linkeditImage("stream-linkedit-tight");
+
+	/*Two minimum windows and nothing more, every table is left out*/
+	const std::string streamed = writeFixture(fileName, 0x2000);
+	CHECK(streamed.find("Stream Skipped : export trie (") != std::string::npos);
+	CHECK(streamed.find("Stream Skipped : indirect symbols (8 bytes)") != std::string::npos);
+	CHECK(streamed.find("Symbol Pointer") == std::string::npos);
+	CHECK(streamed.find("Export : ") == std::string::npos);
+}
+
+TEST(streamedDecodeProfilesRetainedObjCSections)
+{
+	const std::string fileName = objcAndDwarfImage("stream-objc");
+	const std::string whole = writeFixture(fileName, 0);
+	const std::string streamed = writeFixture(fileName, 0x10000);
+
+	/*The retained copy is profiled rather than the section being read again, with the same result*/
+	const size_t profile = whole.find("Section Profile : __TEXT,__objc_methname");
+	CHECK(profile != std::string::npos);
+	if (profile != std::string::npos)
+	{
+		const std::string line = whole.substr(profile, whole.find('\n', profile) - profile);
+		CHECK(streamed.find(line) != std::string::npos);
+	}
+
+	/*DWARF line tables aren't read through the window pool, so streaming leaves them out*/
+	CHECK(streamed.find("Stream Skipped : DWARF line tables (64 bytes)") != std::string::npos);
+	CHECK(whole.find("Stream Skipped") == std::string::npos);
+}
@@ -0,0 +1,114 @@
+#include "Fixture.h"
+#include "StubIndex.h"
+#include "Test.h"
+
+namespace
+{
+	const uint64_t LoadAddress = 0x100000000;
+	const uint64_t StubsAddress = LoadAddress + 0x800;
+	const uint64_t GotAddress = LoadAddress + 0x1000;
+	const uint64_t LazyAddress = LoadAddress + 0x1100;
+	const uint32_t StubSize = 12;
+
+	/*Indirect table entries 0-1 are __stubs, 2-3 __got and 4-5 __la_symbol_ptr.  __la_symbol_ptr
+	is listed before __got, so the index has to put the sections back in address order.*/
+	std::string stubsImage(const std::string& name)
+	{
+		MachOBuilder builder(MH_EXECUTE);
+
+		ByteWriter strings;
+		strings.u8(0).cstring("_local").cstring("_malloc").cstring("_objc_msgSend");
+		const uint32_t stroff = builder.append(strings);
+
+		nlist_64 malloc = makeSymbol(8, N_UNDF | N_EXT, 0, 0);
+		nlist_64 msgSend = makeSymbol(16, N_UNDF | N_EXT, 0, 0);
+		malloc.n_desc = 1 << 8;		/*library ordinal 1*/
+		msgSend.n_desc = 2 << 8;	/*library ordinal 2*/
+		ByteWriter symbols;
+		symbols.put(makeSymbol(1, N_SECT, 1, LoadAddress + 0x400)).put(malloc).put(msgSend);
+		const uint32_t symoff = builder.append(symbols);
+
+		ByteWriter indirect;
+		indirect.u32(1).u32(2);
+		indirect.u32(2).u32(INDIRECT_SYMBOL_LOCAL);
+		indirect.u32(1).u32(INDIRECT_SYMBOL_ABS | INDIRECT_SYMBOL_LOCAL);
+		const uint32_t indirectOffset = builder.append(indirect);
+
+		section_64 stubs = makeSection("__TEXT", "__stubs", StubsAddress, 2 * StubSize, 0, S_SYMBOL_STUBS);
+		stubs.reserved1 = 0;
+		stubs.reserved2 = StubSize;
+		section_64 got = makeSection("__DATA", "__got", GotAddress, 0x10, 0, S_NON_LAZY_SYMBOL_POINTERS);
+		got.reserved1 = 2;
+		section_64 lazy = makeSection("__DATA", "__la_symbol_ptr", LazyAddress, 0x10, 0, S_LAZY_SYMBOL_POINTERS);
+		lazy.reserved1 = 4;
+
+		builder.segment(makeSegment("__TEXT", LoadAddress, 0x1000, 0, 0x1000), { stubs });
+		builder.segment(makeSegment("__DATA", GotAddress, 0x1000, 0, 0), { lazy, got });
+
+		symtab_command symtab = {};
+		symtab.cmd = LC_SYMTAB;
+		symtab.symoff = symoff;
+		symtab.nsyms = 3;
+		symtab.stroff = stroff;
+		symtab.strsize = static_cast<uint32_t>(strings.size());
+		builder.command(symtab);
+
+		dysymtab_command dysymtab = {};
+		dysymtab.cmd = LC_DYSYMTAB;
+		dysymtab.indirectsymoff = indirectOffset;
+		dysymtab.nindirectsyms = 6;
+		builder.command(dysymtab);
+
+		return builder.write(name);
+	}
+
+	std::string_view targetName(const StubIndex& stubs, uint64_t address)
+	{
+		const StubTarget* target = stubs.lookup(address);
+		return target ? corpusNames().name(target->symbol) : std::string_view("(none)");
+	}
+}
+
+TEST(stubIndexResolvesStubsAndPointers)
+{
+	DecodedFixture fixture(stubsImage("stubs"));
+	const SymbolTable symbols(fixture.fin, *findCommand<symtab_command>(fixture.image));
+	const StubIndex stubs(fixture.fin, fixture.image, symbols);
+
+	CHECK_EQUAL(size_t(6), stubs.size());
+
+	/*Any address inside a slot finds it*/
+	CHECK_EQUAL(std::string_view("_malloc"), targetName(stubs, StubsAddress));
+	CHECK_EQUAL(std::string_view("_objc_msgSend"), targetName(stubs, StubsAddress + StubSize + 5));
+	CHECK(stubs.lookup(StubsAddress)->kind == StubKind::Stub);
+	CHECK_EQUAL(2, int(stubs.lookup(StubsAddress + StubSize)->libraryOrdinal));
+
+	CHECK_EQUAL(std::string_view("_objc_msgSend"), targetName(stubs, GotAddress));
+	CHECK(stubs.lookup(GotAddress)->kind == StubKind::NonLazyPointer);
+	CHECK_EQUAL(std::string_view(""), targetName(stubs, GotAddress + 8));
+	CHECK_EQUAL(std::string_view("_malloc"), targetName(stubs, LazyAddress + 7));
+	CHECK(stubs.lookup(LazyAddress)->kind == StubKind::LazyPointer);
+
+	CHECK_EQUAL(std::string_view("(none)"), targetName(stubs, StubsAddress - 1));
+	CHECK_EQUAL(std::string_view("(none)"), targetName(stubs, StubsAddress + 2 * StubSize));
+	CHECK_EQUAL(std::string_view("(none)"), targetName(stubs, LazyAddress + 0x10));
+
+	/*Slots are numbered in address order whatever order the sections came in*/
+	CHECK_EQUAL(StubsAddress + StubSize, stubs.slotAddress(1));
+	CHECK_EQUAL(GotAddress, stubs.slotAddress(2));
+	CHECK_EQUAL(LazyAddress + 8, stubs.slotAddress(5));
+	CHECK_EQUAL(std::string_view("_malloc"), corpusNames().name(stubs.target(4).symbol));
+}
+
+TEST(stubIndexReferencedSymbolsSkipLocalAndAbsolute)
+{
+	const uint32_t indirect[] = { 1, 2, 2, INDIRECT_SYMBOL_LOCAL, 7, INDIRECT_SYMBOL_ABS | INDIRECT_SYMBOL_LOCAL };
+	CHECK(StubIndex::referencedSymbols(indirect, 6) == std::vector<uint32_t>({ 1, 2, 2, 7 }));
+
+	/*An index past the symbol table resolves to no name rather than reading out of bounds*/
+	DecodedFixture fixture(stubsImage("stubs-memory"));
+	const SymbolTable symbols(fixture.fin, *findCommand<symtab_command>(fixture.image));
+	const StubIndex stubs(indirect, 6, fixture.image, symbols);
+	CHECK_EQUAL(std::string_view("_malloc"), targetName(stubs, StubsAddress));
+	CHECK_EQUAL(std::string_view(""), targetName(stubs, LazyAddress));
+}
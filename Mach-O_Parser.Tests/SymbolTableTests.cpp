@@ -0,0 +1,117 @@
+#include <string>
+#include "Fixture.h"
+#include "Streaming.h"
+#include "SymbolTable.h"
+#include "Test.h"
+
+namespace
+{
+	const size_t SymbolCount = 600;
+	const size_t WindowSize = 0x1003;	/*not a multiple of an nlist_64, so entries straddle windows too*/
+
+	struct SymbolFixture
+	{
+		std::string				fileName;
+		std::vector<uint32_t>	strx;	/*string table offset of each symbol's name*/
+	};
+
+	/*SymbolCount symbols named _symbol_<n> with value n, plus one more whose name is merged into the tail of _symbol_1's*/
+	SymbolFixture symbolImage(const std::string& name)
+	{
+		SymbolFixture fixture;
+		MachOBuilder builder(MH_EXECUTE);
+
+		ByteWriter strings;
+		strings.u8(0);
+		for (size_t idx = 0; idx < SymbolCount; ++idx)
+		{
+			fixture.strx.push_back(static_cast<uint32_t>(strings.size()));
+			strings.cstring("_symbol_" + std::to_string(idx));
+		}
+		fixture.strx.push_back(fixture.strx[1] + 8);
+		const uint32_t stroff = builder.append(strings);
+
+		ByteWriter symbols;
+		for (size_t idx = 0; idx < fixture.strx.size(); ++idx)
+		{
+			symbols.put(makeSymbol(fixture.strx[idx], N_SECT | N_EXT, 1, idx));
+		}
+		const uint32_t symoff = builder.append(symbols);
+
+		symtab_command symtab = {};
+		symtab.cmd = LC_SYMTAB;
+		symtab.symoff = symoff;
+		symtab.nsyms = static_cast<uint32_t>(fixture.strx.size());
+		symtab.stroff = stroff;
+		symtab.strsize = static_cast<uint32_t>(strings.size());
+		builder.command(symtab);
+
+		fixture.fileName = builder.write(name);
+		return fixture;
+	}
+}
+
+TEST(sparseSymbolTableMatchesWholeTable)
+{
+	const SymbolFixture fixture = symbolImage("symbols-sparse");
+	DecodedFixture decoded(fixture.fileName);
+	const symtab_command& symtab = *findCommand<symtab_command>(decoded.image);
+	const SymbolTable whole(decoded.fin, symtab);
+
+	/*The first name to cross a window boundary of the string table, and the entry crossing the first of the symbol table*/
+	uint32_t straddlingName = 0;
+	while (straddlingName < SymbolCount && !(fixture.strx[straddlingName] < WindowSize && WindowSize < fixture.strx[straddlingName + 1] - 1))
+	{
+		++straddlingName;
+	}
+	const uint32_t straddlingEntry = static_cast<uint32_t>(WindowSize / sizeof(nlist_64));
+	CHECK(straddlingName < SymbolCount);
+
+	StreamOptions options;
+	options.memoryLimit = 4 * WindowSize;
+	options.windowSize = WindowSize;
+	StreamScheduler scheduler(fixture.fileName, options);
+
+	SymbolTable sparse;
+	const uint32_t merged = static_cast<uint32_t>(SymbolCount);
+	sparse.scheduleSymbols(decoded.fin, symtab, { merged, 1, straddlingName, straddlingEntry, 1, 100000 }, scheduler);
+	scheduler.run();
+	sparse.scheduleStrings(symtab, scheduler);
+	scheduler.run();
+
+	CHECK_EQUAL(whole.size(), sparse.size());
+	for (uint32_t index : { uint32_t(1), straddlingName, straddlingEntry, merged })
+	{
+		CHECK_EQUAL(whole.name(index), sparse.name(index));
+		CHECK_EQUAL(whole[index].n_value, sparse[index].n_value);
+	}
+	CHECK_EQUAL(std::string_view("1"), sparse.name(merged));
+
+	/*Symbols that weren't asked for read as empty rather than failing*/
+	CHECK(sparse.name(2).empty());
+	CHECK_EQUAL(uint64_t(0), sparse[2].n_value);
+	CHECK(sparse.name(100000).empty());
+}
+
+TEST(sharedStringTableIsReadOnce)
+{
+	const SymbolFixture fixture = symbolImage("symbols-shared");
+	DecodedFixture decoded(fixture.fileName);
+	const symtab_command& symtab = *findCommand<symtab_command>(decoded.image);
+
+	/*Two images whose nlist entries differ but whose names come from one pool, as in a shared cache*/
+	symtab_command second = symtab;
+	second.symoff += 10 * sizeof(nlist_64);
+	second.nsyms -= 10;
+
+	SharedStringTables shared;
+	const SymbolTable first(decoded.fin, symtab, shared);
+	const SymbolTable other(decoded.fin, second, shared);
+	const SymbolTable whole(decoded.fin, symtab);
+
+	CHECK_EQUAL(whole.size(), first.size());
+	CHECK_EQUAL(whole.name(12), first.name(12));
+	CHECK_EQUAL(std::string_view("_symbol_12"), other.name(2));
+	CHECK(first.name(12).data() == other.name(2).data());
+	CHECK(whole.name(12).data() != first.name(12).data());
+}
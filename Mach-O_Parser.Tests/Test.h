@@ -0,0 +1,47 @@
+#pragma once
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*A small self registering test runner.  Each TEST body runs once, CHECK failures are reported
+and counted rather than thrown so one run shows every broken expectation.*/
+struct TestCase
+{
+	const char*	name;
+	void		(*run)();
+};
+
+std::vector<TestCase>& testCases();
+void reportFailure(const char* file, int line, const std::string& message);
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, void (*run)()) { testCases().push_back({ name, run }); }
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			reportFailure(__FILE__, __LINE__, #condition); \
+		} \
+	} while (false)
+
+#define CHECK_EQUAL(expected, actual) \
+	do \
+	{ \
+		const auto& expectedValue = (expected); \
+		const auto& actualValue = (actual); \
+		if (!(expectedValue == actualValue)) \
+		{ \
+			std::ostringstream message; \
+			message << #actual << " is " << actualValue << ", expected " << expectedValue; \
+			reportFailure(__FILE__, __LINE__, message.str()); \
+		} \
+	} while (false)
@@ -0,0 +1,55 @@
+#include <exception>
+#include <iostream>
+#include <string>
+#include "Test.h"
+
+namespace
+{
+	size_t failures = 0;
+}
+
+std::vector<TestCase>& testCases()
+{
+	static std::vector<TestCase> cases;
+	return cases;
+}
+
+void reportFailure(const char* file, int line, const std::string& message)
+{
+	std::cout << "    " << file << ":" << line << ": " << message << std::endl;
+	++failures;
+}
+
+/*Runs every test, or only those whose name contains the first argument*/
+int main(int argc, char* argv[])
+{
+	const std::string filter = argc > 1 ? argv[1] : "";
+	size_t failedTests = 0;
+	size_t ran = 0;
+
+	for (const auto& test : testCases())
+	{
+		if (std::string(test.name).find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		const size_t failuresBefore = failures;
+		try
+		{
+			test.run();
+		}
+		catch (const std::exception& error)
+		{
+			reportFailure(test.name, 0, std::string("threw ") + error.what());
+		}
+
+		++ran;
+		const bool passed = failures == failuresBefore;
+		failedTests += passed ? 0 : 1;
+		std::cout << (passed ? "PASS " : "FAIL ") << test.name << std::endl;
+	}
+
+	std::cout << ran - failedTests << " of " << ran << " tests passed" << std::endl;
+	return failedTests == 0 ? 0 : 1;
+}
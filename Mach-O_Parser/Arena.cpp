@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cstring>
+#include "Arena.h"
+
+Arena::Arena(size_t blockSize)
+	: blockSize(blockSize)
+{
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+	if (size + alignment > blockSize)
+	{
+		/*Oversized requests get a block of their own, slotted in behind the current block so
+		the space left in the current block still serves the allocations that follow*/
+		const size_t dedicatedSize = size + alignment;
+		Block dedicated = { std::unique_ptr<char[]>(new char[dedicatedSize]), dedicatedSize };
+		const uintptr_t base = reinterpret_cast<uintptr_t>(dedicated.data.get());
+		char* aligned = dedicated.data.get() + (((base + alignment - 1) & ~uintptr_t(alignment - 1)) - base);
+
+		if (blocks.empty())
+		{
+			blocks.push_back(std::move(dedicated));
+			used = dedicatedSize;
+		}
+		else
+		{
+			blocks.insert(blocks.end() - 1, std::move(dedicated));
+		}
+		allocated += size;
+
+		return aligned;
+	}
+
+	if (!blocks.empty())
+	{
+		const uintptr_t base = reinterpret_cast<uintptr_t>(blocks.back().data.get());
+		const size_t start = static_cast<size_t>(((base + used + alignment - 1) & ~uintptr_t(alignment - 1)) - base);
+
+		if (start + size <= blocks.back().size)
+		{
+			used = start + size;
+			allocated += size;
+			return blocks.back().data.get() + start;
+		}
+	}
+
+	blocks.push_back({ std::unique_ptr<char[]>(new char[blockSize]), blockSize });
+	used = 0;
+
+	return allocate(size, alignment);
+}
+
+std::string_view Arena::copy(std::string_view text)
+{
+	char* storage = static_cast<char*>(allocate(text.size(), 1));
+	memcpy(storage, text.data(), text.size());
+	return std::string_view(storage, text.size());
+}
+
+void Arena::reset()
+{
+	if (!blocks.empty())
+	{
+		/*Keep a regular sized block to start the next file with, oversized ones are returned*/
+		auto regular = std::find_if(blocks.begin(), blocks.end(), [this](const Block& block) { return block.size == blockSize; });
+		if (regular != blocks.end())
+		{
+			Block kept = std::move(*regular);
+			blocks.clear();
+			blocks.push_back(std::move(kept));
+		}
+		else
+		{
+			blocks.clear();
+		}
+	}
+
+	used = 0;
+	allocated = 0;
+}
+
+Arena& workerArena()
+{
+	thread_local Arena arena;
+	return arena;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/*Bump allocator for decode-time buffers.  Allocations are never freed one by one,
+reset() releases everything at once when the file that needed them is done.*/
+class Arena
+{
+public:
+	explicit Arena(size_t blockSize = 1 << 20);
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	/*Copies text into the arena, the view stays valid until the next reset()*/
+	std::string_view copy(std::string_view text);
+
+	/*Drops every allocation but keeps the first block around for the next file*/
+	void reset();
+
+	size_t bytesAllocated() const { return allocated; }
+
+private:
+	struct Block
+	{
+		std::unique_ptr<char[]>	data;
+		size_t					size;
+	};
+
+	size_t				blockSize;
+	std::vector<Block>	blocks;
+	size_t				used = 0;		/*bytes handed out from blocks.back()*/
+	size_t				allocated = 0;	/*bytes handed out since the last reset*/
+};
+
+/*Lets standard containers draw from an Arena, deallocate is a no-op*/
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+	template <typename U>
+	friend class ArenaAllocator;
+
+	Arena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/*The calling thread's arena, decodeFile resets it once the file has been written out*/
+Arena& workerArena();
@@ -0,0 +1,568 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <thread>
+#include "ChainedFixups.h"
+#include "Arena.h"
+#include "Reader.h"
+
+namespace
+{
+	enum class FixupKind { None, Rebase, Bind };
+
+	struct Fixup
+	{
+		FixupKind	kind = FixupKind::None;
+		uint64_t	target = 0;		/*rebase target vmaddr*/
+		uint32_t	ordinal = 0;	/*bind import index*/
+		int64_t		addend = 0;
+		uint32_t	next = 0;		/*distance to the next fixup in strides, 0 ends the chain*/
+	};
+
+	/*A segment's chain starts together with the segment bytes the chains run through*/
+	struct SegmentChains
+	{
+		uint64_t				vmaddr;
+		uint16_t				pageSize;
+		uint16_t				pointerFormat;
+		uint32_t				maxValidPointer;
+		std::vector<uint16_t>	pageStarts;		/*page_start[] followed by any chain_starts[] overflow*/
+		uint16_t				pageCount;
+		uint32_t				segment;		/*index into MachImage::segments*/
+		ArenaVector<uint8_t>	data;
+	};
+
+	struct PageWork
+	{
+		uint32_t segment;
+		uint32_t page;
+	};
+
+	int64_t signExtend(uint64_t value, unsigned bits)
+	{
+		const uint64_t sign = uint64_t(1) << (bits - 1);
+		return static_cast<int64_t>((value ^ sign) - sign);
+	}
+
+	uint32_t strideOf(uint16_t pointerFormat)
+	{
+		switch (pointerFormat)
+		{
+		case DYLD_CHAINED_PTR_ARM64E:
+		case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+		case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+		case DYLD_CHAINED_PTR_ARM64E_SHARED_CACHE:
+			return 8;
+
+		case DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE:
+			return 1;
+
+		default:
+			return 4;
+		}
+	}
+
+	bool is32BitFormat(uint16_t pointerFormat)
+	{
+		return pointerFormat == DYLD_CHAINED_PTR_32
+			|| pointerFormat == DYLD_CHAINED_PTR_32_CACHE
+			|| pointerFormat == DYLD_CHAINED_PTR_32_FIRMWARE;
+	}
+
+	/*Splits one raw chained pointer into its fields, rebase targets are turned into vmaddrs*/
+	Fixup decodePointer(uint16_t pointerFormat, uint64_t raw, uint32_t maxValidPointer, uint64_t loadAddress, const MachImage& image)
+	{
+		Fixup fixup;
+
+		switch (pointerFormat)
+		{
+		case DYLD_CHAINED_PTR_ARM64E:
+		case DYLD_CHAINED_PTR_ARM64E_KERNEL:
+		case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+		case DYLD_CHAINED_PTR_ARM64E_FIRMWARE:
+		case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+		{
+			const bool isAuth = (raw >> 63) & 1;
+			const bool isBind = (raw >> 62) & 1;
+			fixup.next = (raw >> 51) & 0x7ff;
+
+			if (isBind)
+			{
+				fixup.kind = FixupKind::Bind;
+				fixup.ordinal = static_cast<uint32_t>(raw & (pointerFormat == DYLD_CHAINED_PTR_ARM64E_USERLAND24 ? 0xffffff : 0xffff));
+				fixup.addend = isAuth ? 0 : signExtend((raw >> 32) & 0x7ffff, 19);
+			}
+			else if (isAuth)
+			{
+				/*Authenticated rebases always hold an offset from the image base*/
+				fixup.kind = FixupKind::Rebase;
+				fixup.target = loadAddress + (raw & 0xffffffff);
+			}
+			else
+			{
+				const bool targetIsVmaddr = pointerFormat == DYLD_CHAINED_PTR_ARM64E || pointerFormat == DYLD_CHAINED_PTR_ARM64E_FIRMWARE;
+				const uint64_t target = raw & 0x7ffffffffff;
+				const uint64_t high8 = (raw >> 43) & 0xff;
+
+				fixup.kind = FixupKind::Rebase;
+				fixup.target = ((targetIsVmaddr ? target : loadAddress + target)) | (high8 << 56);
+			}
+			break;
+		}
+
+		case DYLD_CHAINED_PTR_64:
+		case DYLD_CHAINED_PTR_64_OFFSET:
+		{
+			fixup.next = (raw >> 51) & 0xfff;
+
+			if ((raw >> 63) & 1)
+			{
+				fixup.kind = FixupKind::Bind;
+				fixup.ordinal = static_cast<uint32_t>(raw & 0xffffff);
+				fixup.addend = (raw >> 24) & 0xff;
+			}
+			else
+			{
+				const uint64_t target = raw & 0xfffffffff;
+				const uint64_t high8 = (raw >> 36) & 0xff;
+
+				fixup.kind = FixupKind::Rebase;
+				fixup.target = (pointerFormat == DYLD_CHAINED_PTR_64 ? target : loadAddress + target) | (high8 << 56);
+			}
+			break;
+		}
+
+		case DYLD_CHAINED_PTR_64_KERNEL_CACHE:
+		case DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE:
+			fixup.next = (raw >> 51) & 0xfff;
+			fixup.kind = FixupKind::Rebase;
+			fixup.target = loadAddress + (raw & 0x3fffffff);
+			break;
+
+		case DYLD_CHAINED_PTR_ARM64E_SHARED_CACHE:
+		{
+			const bool isAuth = (raw >> 63) & 1;
+			fixup.next = (raw >> 52) & 0x7ff;
+			fixup.kind = FixupKind::Rebase;
+			fixup.target = loadAddress + (raw & 0x3ffffffff);
+			if (!isAuth)
+			{
+				fixup.target |= ((raw >> 34) & 0xff) << 56;
+			}
+			break;
+		}
+
+		case DYLD_CHAINED_PTR_ARM64E_SEGMENTED:
+		{
+			const uint32_t segmentIndex = (raw >> 28) & 0xf;
+			fixup.next = (raw >> 51) & 0xfff;
+			if (segmentIndex < image.segments.size())
+			{
+				fixup.kind = FixupKind::Rebase;
+				fixup.target = image.segments[segmentIndex].vmaddr + (raw & 0xfffffff);
+			}
+			break;
+		}
+
+		case DYLD_CHAINED_PTR_32:
+			fixup.next = (raw >> 26) & 0x1f;
+			if ((raw >> 31) & 1)
+			{
+				fixup.kind = FixupKind::Bind;
+				fixup.ordinal = static_cast<uint32_t>(raw & 0xfffff);
+				fixup.addend = (raw >> 20) & 0x3f;
+			}
+			else if ((raw & 0x3ffffff) <= maxValidPointer)
+			{
+				/*Anything above max_valid_pointer is a biased non-pointer value, not a rebase*/
+				fixup.kind = FixupKind::Rebase;
+				fixup.target = raw & 0x3ffffff;
+			}
+			break;
+
+		case DYLD_CHAINED_PTR_32_CACHE:
+			fixup.next = (raw >> 30) & 0x3;
+			fixup.kind = FixupKind::Rebase;
+			fixup.target = loadAddress + (raw & 0x3fffffff);
+			break;
+
+		case DYLD_CHAINED_PTR_32_FIRMWARE:
+			fixup.next = (raw >> 26) & 0x3f;
+			fixup.kind = FixupKind::Rebase;
+			fixup.target = raw & 0x3ffffff;
+			break;
+
+		default:
+			break;
+		}
+
+		return fixup;
+	}
+
+	/*Walks one chain through the bytes of a single page, chains never leave the page they start in*/
+	void walkChain(const SegmentChains& chains, uint32_t page, uint32_t offsetInPage, const uint8_t* pageData, size_t pageBytes,
+		uint64_t loadAddress, const MachImage& image, ChainedFixups& out)
+	{
+		const uint32_t stride = strideOf(chains.pointerFormat);
+		const size_t pointerSize = is32BitFormat(chains.pointerFormat) ? 4 : 8;
+		const uint64_t pageAddress = chains.vmaddr + uint64_t(page) * chains.pageSize;
+		uint64_t offset = offsetInPage;
+
+		while (offset + pointerSize <= pageBytes)
+		{
+			uint64_t raw = 0;
+			memcpy(&raw, pageData + offset, pointerSize);
+
+			const Fixup fixup = decodePointer(chains.pointerFormat, raw, chains.maxValidPointer, loadAddress, image);
+			if (fixup.kind == FixupKind::Rebase)
+			{
+				out.rebaseAddress.push_back(pageAddress + offset);
+				out.rebaseTarget.push_back(fixup.target);
+			}
+			else if (fixup.kind == FixupKind::Bind)
+			{
+				out.bindAddress.push_back(pageAddress + offset);
+				out.bindImport.push_back(fixup.ordinal);
+				out.bindAddend.push_back(fixup.addend);
+			}
+
+			if (fixup.next == 0)
+			{
+				break;
+			}
+			offset += uint64_t(fixup.next) * stride;
+		}
+	}
+
+	void walkPage(const SegmentChains& chains, uint32_t page, const uint8_t* pageData, size_t pageBytes,
+		uint64_t loadAddress, const MachImage& image, ChainedFixups& out)
+	{
+		const uint16_t start = chains.pageStarts[page];
+		if (start == DYLD_CHAINED_PTR_START_NONE)
+		{
+			return;
+		}
+
+		if ((start & DYLD_CHAINED_PTR_START_MULTI) && is32BitFormat(chains.pointerFormat))
+		{
+			/*Older 32-bit formats can't span a whole page with their short next field,
+			so such pages list several chain starts in the overflow area*/
+			for (size_t idx = start & ~DYLD_CHAINED_PTR_START_MULTI; idx < chains.pageStarts.size(); ++idx)
+			{
+				const uint16_t chainStart = chains.pageStarts[idx];
+				walkChain(chains, page, chainStart & ~DYLD_CHAINED_PTR_START_LAST, pageData, pageBytes, loadAddress, image, out);
+				if (chainStart & DYLD_CHAINED_PTR_START_LAST)
+				{
+					break;
+				}
+			}
+		}
+		else
+		{
+			walkChain(chains, page, start, pageData, pageBytes, loadAddress, image, out);
+		}
+	}
+
+	/*Walks pages of one segment as they stream past, copying only pages that straddle two windows*/
+	class StreamedSegmentWalker
+	{
+	public:
+		StreamedSegmentWalker(const SegmentChains& chains, uint64_t fileoff, uint64_t streamedSize, uint64_t loadAddress, const MachImage& image, ChainedFixups& out)
+			: chains(chains), fileoff(fileoff), streamedSize(streamedSize), loadAddress(loadAddress), image(image), out(out), partial(chains.pageSize)
+		{
+		}
+
+		void consume(uint64_t offset, const uint8_t* data, size_t size)
+		{
+			uint64_t position = offset - fileoff;
+
+			while (size != 0)
+			{
+				const uint32_t page = static_cast<uint32_t>(position / chains.pageSize);
+				const size_t inPage = static_cast<size_t>(position % chains.pageSize);
+				const size_t take = std::min<size_t>(size, chains.pageSize - inPage);
+				const bool wanted = page < chains.pageCount && chains.pageStarts[page] != DYLD_CHAINED_PTR_START_NONE;
+
+				if (wanted && inPage == 0 && take == chains.pageSize)
+				{
+					walkPage(chains, page, data, take, loadAddress, image, out);
+				}
+				else if (wanted)
+				{
+					memcpy(partial.data() + inPage, data, take);
+					partialBytes = inPage + take;
+					if (partialBytes == chains.pageSize)
+					{
+						walkPage(chains, page, partial.data(), partialBytes, loadAddress, image, out);
+						partialBytes = 0;
+					}
+				}
+
+				position += take;
+				data += take;
+				size -= take;
+
+				/*The segment may end part way through its last page*/
+				if (position == streamedSize && partialBytes != 0)
+				{
+					walkPage(chains, page, partial.data(), partialBytes, loadAddress, image, out);
+					partialBytes = 0;
+				}
+			}
+		}
+
+	private:
+		const SegmentChains&	chains;
+		uint64_t				fileoff;
+		uint64_t				streamedSize;
+		uint64_t				loadAddress;
+		const MachImage&		image;
+		ChainedFixups&			out;
+		std::vector<uint8_t>	partial;
+		size_t					partialBytes = 0;
+	};
+
+	/*zlib compressed symbol strings are not supported, their imports get the empty name*/
+	NameId symbolName(const ArenaVector<uint8_t>& blob, const dyld_chained_fixups_header& header, uint32_t nameOffset)
+	{
+		const uint64_t offset = uint64_t(header.symbols_offset) + nameOffset;
+		if (header.symbols_format != DYLD_CHAINED_SYMBOL_UNCOMPRESSED || offset >= blob.size())
+		{
+			return corpusNames().intern(std::string_view());
+		}
+
+		const char* start = (const char*)blob.data() + offset;
+		return corpusNames().intern(std::string_view(start, strnlen(start, blob.size() - offset)));
+	}
+
+	void decodeImports(const ArenaVector<uint8_t>& blob, const dyld_chained_fixups_header& header, ChainedFixups& fixups)
+	{
+		size_t entrySize = 0;
+		switch (header.imports_format)
+		{
+		case DYLD_CHAINED_IMPORT:			entrySize = sizeof(dyld_chained_import); break;
+		case DYLD_CHAINED_IMPORT_ADDEND:	entrySize = sizeof(dyld_chained_import_addend); break;
+		case DYLD_CHAINED_IMPORT_ADDEND64:	entrySize = sizeof(dyld_chained_import_addend64); break;
+		default:							return;
+		}
+
+		const size_t available = header.imports_offset < blob.size() ? (blob.size() - header.imports_offset) / entrySize : 0;
+		const size_t count = std::min<size_t>(header.imports_count, available);
+		const uint8_t* entries = blob.data() + header.imports_offset;
+		fixups.imports.reserve(count);
+
+		for (size_t idx = 0; idx < count; ++idx)
+		{
+			ChainedImport import = {};
+			if (header.imports_format == DYLD_CHAINED_IMPORT_ADDEND64)
+			{
+				dyld_chained_import_addend64 entry;
+				memcpy(&entry, entries + idx * entrySize, sizeof(entry));
+				import.name = symbolName(blob, header, static_cast<uint32_t>(entry.name_offset));
+				import.libOrdinal = entry.lib_ordinal > 0xfff0 ? static_cast<int16_t>(entry.lib_ordinal) : static_cast<int32_t>(entry.lib_ordinal);
+				import.weakImport = entry.weak_import;
+				import.addend = static_cast<int64_t>(entry.addend);
+			}
+			else
+			{
+				dyld_chained_import_addend entry = {};
+				memcpy(&entry, entries + idx * entrySize, entrySize);
+				import.name = symbolName(blob, header, entry.name_offset);
+				import.libOrdinal = entry.lib_ordinal > 0xf0 ? static_cast<int8_t>(entry.lib_ordinal) : static_cast<int32_t>(entry.lib_ordinal);
+				import.weakImport = entry.weak_import;
+				import.addend = entry.addend;
+			}
+			fixups.imports.push_back(import);
+		}
+	}
+
+	/*Chain starts of every segment that has any, the segment bytes are left for the caller to supply*/
+	std::vector<SegmentChains> decodeStarts(const ArenaVector<uint8_t>& blob, const dyld_chained_fixups_header& header, const MachImage& image)
+	{
+		std::vector<SegmentChains> segments;
+		if (uint64_t(header.starts_offset) + sizeof(uint32_t) > blob.size())
+		{
+			return segments;
+		}
+
+		const uint8_t* startsInImage = blob.data() + header.starts_offset;
+		uint32_t segCount;
+		memcpy(&segCount, startsInImage, sizeof(segCount));
+		segCount = std::min<uint32_t>(segCount, static_cast<uint32_t>(image.segments.size()));
+
+		for (uint32_t segIndex = 0; segIndex < segCount; ++segIndex)
+		{
+			const uint64_t offsetSlot = uint64_t(header.starts_offset) + sizeof(uint32_t) * (1 + segIndex);
+			if (offsetSlot + sizeof(uint32_t) > blob.size())
+			{
+				break;
+			}
+
+			uint32_t segInfoOffset;
+			memcpy(&segInfoOffset, blob.data() + offsetSlot, sizeof(segInfoOffset));
+			const uint64_t segInfoStart = uint64_t(header.starts_offset) + segInfoOffset;
+			if (segInfoOffset == 0 || segInfoStart + offsetof(dyld_chained_starts_in_segment, page_start) > blob.size())
+			{
+				continue;
+			}
+
+			dyld_chained_starts_in_segment startsInSegment;
+			memcpy(&startsInSegment, blob.data() + segInfoStart, offsetof(dyld_chained_starts_in_segment, page_start));
+
+			/*size covers page_start[] and the multi-start overflow after it*/
+			const uint64_t startsEnd = std::min<uint64_t>(segInfoStart + startsInSegment.size, blob.size());
+			const uint64_t pageStartsOffset = segInfoStart + offsetof(dyld_chained_starts_in_segment, page_start);
+			if (startsEnd < pageStartsOffset + uint64_t(startsInSegment.page_count) * sizeof(uint16_t))
+			{
+				continue;
+			}
+
+			if (startsInSegment.page_size == 0)
+			{
+				continue;
+			}
+
+			SegmentChains chains = { 0, 0, 0, 0, {}, 0, segIndex, ArenaVector<uint8_t>(ArenaAllocator<uint8_t>(workerArena())) };
+			chains.vmaddr = image.segments[segIndex].vmaddr;
+			chains.pageSize = startsInSegment.page_size;
+			chains.pointerFormat = startsInSegment.pointer_format;
+			chains.maxValidPointer = startsInSegment.max_valid_pointer;
+			chains.pageCount = startsInSegment.page_count;
+			chains.pageStarts.resize((startsEnd - pageStartsOffset) / sizeof(uint16_t));
+			memcpy(chains.pageStarts.data(), blob.data() + pageStartsOffset, chains.pageStarts.size() * sizeof(uint16_t));
+
+			segments.push_back(std::move(chains));
+		}
+
+		return segments;
+	}
+
+	void append(ChainedFixups& into, const ChainedFixups& from)
+	{
+		into.rebaseAddress.insert(into.rebaseAddress.end(), from.rebaseAddress.begin(), from.rebaseAddress.end());
+		into.rebaseTarget.insert(into.rebaseTarget.end(), from.rebaseTarget.begin(), from.rebaseTarget.end());
+		into.bindAddress.insert(into.bindAddress.end(), from.bindAddress.begin(), from.bindAddress.end());
+		into.bindImport.insert(into.bindImport.end(), from.bindImport.begin(), from.bindImport.end());
+		into.bindAddend.insert(into.bindAddend.end(), from.bindAddend.begin(), from.bindAddend.end());
+	}
+}
+
+std::string_view ChainedFixups::importName(size_t importIndex) const
+{
+	return importIndex < imports.size() ? corpusNames().name(imports[importIndex].name) : std::string_view();
+}
+
+ChainedFixups decodeChainedFixups(std::ifstream& fin, const MachImage& image, const linkedit_data_command& command, bool serial)
+{
+	ChainedFixups fixups;
+
+	const auto blob = readArrayAt<uint8_t>(fin, command.dataoff, command.datasize, ArenaAllocator<uint8_t>(workerArena()));
+	if (blob.size() < sizeof(dyld_chained_fixups_header))
+	{
+		return fixups;
+	}
+
+	dyld_chained_fixups_header header;
+	memcpy(&header, blob.data(), sizeof(header));
+
+	decodeImports(blob, header, fixups);
+	std::vector<SegmentChains> segments = decodeStarts(blob, header, image);
+
+	/*One sequential read per segment, the chains are then walked in memory*/
+	for (auto& chains : segments)
+	{
+		const Segment& segment = image.segments[chains.segment];
+		chains.data = readArrayAt<uint8_t>(fin, segment.fileoff, static_cast<size_t>(segment.filesize), chains.data.get_allocator());
+	}
+
+	std::vector<PageWork> pages;
+	for (uint32_t segIndex = 0; segIndex < segments.size(); ++segIndex)
+	{
+		for (uint32_t page = 0; page < segments[segIndex].pageCount; ++page)
+		{
+			if (segments[segIndex].pageStarts[page] != DYLD_CHAINED_PTR_START_NONE)
+			{
+				pages.push_back({ segIndex, page });
+			}
+		}
+	}
+
+	/*Chains never cross a page, so pages are split into contiguous runs, one per thread, and
+	the per-thread tables are appended in run order to keep the output in file order.*/
+	const uint64_t loadAddress = preferredLoadAddress(image);
+	const size_t minimumPagesPerThread = 64;
+	const size_t threadCount = serial ? 1 : std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), pages.size() / minimumPagesPerThread));
+	const size_t pagesPerThread = (pages.size() + threadCount - 1) / threadCount;
+
+	std::vector<ChainedFixups> partials(threadCount);
+	auto walkRun = [&](size_t run)
+	{
+		const size_t first = run * pagesPerThread;
+		const size_t last = std::min(pages.size(), first + pagesPerThread);
+		for (size_t idx = first; idx < last; ++idx)
+		{
+			const SegmentChains& chains = segments[pages[idx].segment];
+			const uint64_t pageOffset = uint64_t(pages[idx].page) * chains.pageSize;
+			if (pageOffset < chains.data.size())
+			{
+				const size_t pageBytes = static_cast<size_t>(std::min<uint64_t>(chains.pageSize, chains.data.size() - pageOffset));
+				walkPage(chains, pages[idx].page, chains.data.data() + pageOffset, pageBytes, loadAddress, image, partials[run]);
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t run = 1; run < threadCount; ++run)
+	{
+		workers.emplace_back(walkRun, run);
+	}
+	walkRun(0);
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	for (const auto& partial : partials)
+	{
+		append(fixups, partial);
+	}
+
+	return fixups;
+}
+
+void scheduleChainedFixups(const ArenaVector<uint8_t>& blob, const MachImage& image, StreamScheduler& scheduler, ChainedFixups& fixups)
+{
+	if (blob.size() < sizeof(dyld_chained_fixups_header))
+	{
+		return;
+	}
+
+	dyld_chained_fixups_header header;
+	memcpy(&header, blob.data(), sizeof(header));
+
+	decodeImports(blob, header, fixups);
+
+	/*The walkers hold on to the chain starts until the scheduler has streamed every segment*/
+	struct StreamState
+	{
+		std::vector<SegmentChains>			segments;
+		std::deque<StreamedSegmentWalker>	walkers;
+	};
+	auto state = std::make_shared<StreamState>();
+	state->segments = decodeStarts(blob, header, image);
+
+	const uint64_t loadAddress = preferredLoadAddress(image);
+	for (const auto& chains : state->segments)
+	{
+		const Segment& segment = image.segments[chains.segment];
+		const uint64_t streamedSize = std::min<uint64_t>(segment.filesize, uint64_t(chains.pageCount) * chains.pageSize);
+
+		StreamedSegmentWalker& walker = state->walkers.emplace_back(chains, segment.fileoff, streamedSize, loadAddress, image, fixups);
+		scheduler.schedule(segment.fileoff, streamedSize, [state, &walker](uint64_t offset, const uint8_t* data, size_t size)
+		{
+			walker.consume(offset, data, size);
+		});
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <fstream>
+#include <string_view>
+#include <vector>
+#include "Decoder.h"
+#include "Streaming.h"
+#include "fixup-chains.h"
+
+struct ChainedImport
+{
+	NameId		name;
+	int32_t		libOrdinal;		/*1-based dylib load order, or a BIND_SPECIAL_DYLIB_* value when negative*/
+	bool		weakImport;
+	int64_t		addend;
+};
+
+/*Every fixup of an image flattened into rebase and bind tables, both in file order*/
+struct ChainedFixups
+{
+	std::vector<ChainedImport>	imports;
+
+	std::vector<uint64_t>		rebaseAddress;	/*vmaddr of the pointer being rebased*/
+	std::vector<uint64_t>		rebaseTarget;	/*unslid vmaddr the pointer points to*/
+
+	std::vector<uint64_t>		bindAddress;	/*vmaddr of the pointer being bound*/
+	std::vector<uint32_t>		bindImport;		/*index into imports*/
+	std::vector<int64_t>		bindAddend;		/*addend stored in the pointer itself, on top of the import's*/
+
+	std::string_view importName(size_t importIndex) const;
+};
+
+/*Parses the LC_DYLD_CHAINED_FIXUPS payload and walks every page's pointer chain, spreading the pages across threads unless serial*/
+ChainedFixups decodeChainedFixups(std::ifstream& fin, const MachImage& image, const linkedit_data_command& command, bool serial = false);
+
+/*Streaming flavour of decodeChainedFixups.  blob is the LC_DYLD_CHAINED_FIXUPS payload, retained by an
+earlier pass, and the segment pages are walked as scheduler reads past them rather than being loaded
+up front.  fixups is complete once scheduler.run() returns.*/
+void scheduleChainedFixups(const ArenaVector<uint8_t>& blob, const MachImage& image, StreamScheduler& scheduler, ChainedFixups& fixups);
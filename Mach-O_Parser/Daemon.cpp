@@ -0,0 +1,792 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "Daemon.h"
+#include "DwarfLines.h"
+#include "ImageCache.h"
+#include "Sockets.h"
+
+namespace
+{
+	const uint32_t MaximumFrameSize = 1 << 24;
+	const uint32_t MaximumRequestSize = 1 << 20;	/*a longer length prefix closes the connection*/
+	const size_t ReceiveChunkSize = 1 << 16;
+	const size_t ReceiveBudget = 1 << 18;		/*bytes taken from one client per wakeup, so a busy client can't starve the rest*/
+	const size_t LatencyWindow = 8192;
+
+	struct Response
+	{
+		DaemonStatus	status;
+		std::string		payload;
+	};
+
+	/*A request frame decoded into its fields, owning them so it can outlive the receive buffer*/
+	struct Request
+	{
+		DaemonOpcode			opcode;
+		std::string				path;
+		uint64_t				address = 0;	/*LookupStub*/
+		std::string				name;			/*LookupExport*/
+		std::vector<uint64_t>	addresses;		/*LookupLines*/
+	};
+
+	/*A reply a worker finished, for the loop to file under its client*/
+	struct Completion
+	{
+		uint64_t								client;
+		uint64_t								sequence;
+		std::chrono::steady_clock::time_point	received;
+		Response								response;
+	};
+
+	struct Client
+	{
+		uint64_t				id;
+		SOCKET					socket;
+		std::vector<uint8_t>	input;
+		std::vector<uint8_t>	output;
+		size_t					outputSent = 0;
+
+		/*One slot per request in arrival order, a slot stays empty until its worker posts the reply*/
+		std::deque<std::optional<Response>>	replies;
+		uint64_t				firstReply = 0;		/*sequence number of replies.front()*/
+
+		bool					readDone = false;	/*peer shut down its side, close once the replies are written*/
+		bool					closed = false;
+	};
+
+	/*Service times of the most recent requests, older samples are overwritten*/
+	class LatencyStats
+	{
+	public:
+		void record(uint64_t micros)
+		{
+			if (samples.size() < LatencyWindow)
+			{
+				samples.push_back(micros);
+			}
+			else
+			{
+				samples[next] = micros;
+			}
+			next = (next + 1) % LatencyWindow;
+			++total;
+		}
+
+		uint64_t percentile(double fraction) const
+		{
+			if (samples.empty())
+			{
+				return 0;
+			}
+
+			std::vector<uint64_t> sorted(samples);
+			const size_t rank = std::min(sorted.size() - 1, static_cast<size_t>(fraction * double(sorted.size())));
+			std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+			return sorted[rank];
+		}
+
+		uint64_t requests() const { return total; }
+
+	private:
+		std::vector<uint64_t>	samples;
+		size_t					next = 0;
+		uint64_t				total = 0;
+	};
+
+	/*Runs requests that would block the event loop.  Each finished reply is queued for the loop,
+	which is woken by a byte on wakeWriter.  Jobs still queued when the pool is destroyed are dropped.*/
+	class WorkerPool
+	{
+	public:
+		WorkerPool(size_t threadCount, SOCKET wakeWriter)
+			: wakeWriter(wakeWriter)
+		{
+			for (size_t idx = 0; idx < threadCount; ++idx)
+			{
+				threads.emplace_back([this]() { work(); });
+			}
+		}
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			changed.notify_all();
+
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		void submit(std::function<Completion()> job)
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				jobs.push_back(std::move(job));
+				++outstanding;
+			}
+			changed.notify_one();
+		}
+
+		std::vector<Completion> takeCompleted()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			std::vector<Completion> taken;
+			taken.swap(completed);
+			outstanding -= taken.size();
+			return taken;
+		}
+
+		/*Submitted and not yet taken back*/
+		size_t pending() const
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			return outstanding;
+		}
+
+	private:
+		void work()
+		{
+			for (;;)
+			{
+				std::function<Completion()> job;
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					changed.wait(guard, [this]() { return stopping || !jobs.empty(); });
+					if (stopping)
+					{
+						return;
+					}
+					job = std::move(jobs.front());
+					jobs.pop_front();
+				}
+
+				Completion done = job();
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					completed.push_back(std::move(done));
+				}
+
+				/*A full wake socket already has a wakeup pending, so a failed send loses nothing*/
+				const char wake = 0;
+				send(wakeWriter, &wake, 1, 0);
+			}
+		}
+
+		SOCKET									wakeWriter;
+		mutable std::mutex						lock;
+		std::condition_variable					changed;
+		std::deque<std::function<Completion()>>	jobs;
+		std::vector<Completion>					completed;
+		size_t									outstanding = 0;
+		bool									stopping = false;
+		std::vector<std::thread>				threads;
+	};
+
+	template <typename Value>
+	bool takeValue(std::string_view& payload, Value& value)
+	{
+		if (payload.size() < sizeof(Value))
+		{
+			return false;
+		}
+
+		memcpy(&value, payload.data(), sizeof(Value));
+		payload.remove_prefix(sizeof(Value));
+		return true;
+	}
+
+	/*False for unknown opcodes and payloads too short for their fixed fields*/
+	bool parseRequest(uint8_t opcode, std::string_view payload, Request& request)
+	{
+		request.opcode = static_cast<DaemonOpcode>(opcode);
+
+		switch (request.opcode)
+		{
+		case DaemonOpcode::Describe:
+			break;
+
+		case DaemonOpcode::LookupStub:
+			if (!takeValue(payload, request.address))
+			{
+				return false;
+			}
+			break;
+
+		case DaemonOpcode::LookupExport:
+		{
+			uint32_t nameLength;
+			if (!takeValue(payload, nameLength) || nameLength > payload.size())
+			{
+				return false;
+			}
+			request.name = std::string(payload.substr(0, nameLength));
+			payload.remove_prefix(nameLength);
+			break;
+		}
+
+		case DaemonOpcode::LookupLines:
+		{
+			uint32_t count;
+			if (!takeValue(payload, count) || payload.size() / sizeof(uint64_t) < count)
+			{
+				return false;
+			}
+			request.addresses.resize(count);
+			memcpy(request.addresses.data(), payload.data(), count * sizeof(uint64_t));
+			payload.remove_prefix(count * sizeof(uint64_t));
+			break;
+		}
+
+		case DaemonOpcode::Stats:
+		case DaemonOpcode::Shutdown:
+			return true;
+
+		default:
+			return false;
+		}
+
+		request.path = std::string(payload);
+		return true;
+	}
+
+	void appendFrame(std::vector<uint8_t>& output, const Response& response)
+	{
+		const uint32_t length = static_cast<uint32_t>(1 + response.payload.size());
+		const size_t start = output.size();
+
+		output.resize(start + sizeof(length) + length);
+		memcpy(output.data() + start, &length, sizeof(length));
+		output[start + sizeof(length)] = static_cast<uint8_t>(response.status);
+		memcpy(output.data() + start + sizeof(length) + 1, response.payload.data(), response.payload.size());
+	}
+
+	uint64_t microsSince(std::chrono::steady_clock::time_point start)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	bool wouldBlock()
+	{
+		return WSAGetLastError() == WSAEWOULDBLOCK;
+	}
+
+	/*Requests for images that are cached with what they need already built are answered on the
+	loop, anything that has to decode or compile goes to the worker pool.  Replies still go out in
+	request order on each connection.*/
+	class Server
+	{
+	public:
+		Server(const DaemonOptions& options, SOCKET wakeReader, SOCKET wakeWriter)
+			: cache(options.cacheCapacity, options.decode),
+			  wakeReader(wakeReader),
+			  pool(std::max<size_t>(2, std::thread::hardware_concurrency()), wakeWriter)
+		{
+		}
+
+		/*Serves a socket that is already connected as one more client*/
+		void adopt(SOCKET socket)
+		{
+			Client client;
+			client.id = nextClientId++;
+			client.socket = socket;
+			clients.push_back(std::move(client));
+		}
+
+		/*Serves until Shutdown.  Without a listener only adopted clients are served, and the loop
+		also ends once they have all gone.*/
+		void serve(SOCKET listener)
+		{
+			std::vector<WSAPOLLFD> polled;
+			const bool listening = listener != INVALID_SOCKET;
+			const size_t firstClient = listening ? 2 : 1;
+
+			/*Once shut down, keep polling only until every pending reply has been written*/
+			while ((listening || !clients.empty())
+				&& (!shuttingDown || std::any_of(clients.begin(), clients.end(), [](const Client& client) { return !client.replies.empty() || client.outputSent < client.output.size(); })))
+			{
+				polled.clear();
+				polled.push_back({ wakeReader, POLLRDNORM, 0 });
+				if (listening)
+				{
+					polled.push_back({ listener, static_cast<short>(shuttingDown ? 0 : POLLRDNORM), 0 });
+				}
+				for (const auto& client : clients)
+				{
+					const bool pending = client.outputSent < client.output.size();
+					polled.push_back({ client.socket, static_cast<short>((client.readDone ? 0 : POLLRDNORM) | (pending ? POLLWRNORM : 0)), 0 });
+				}
+
+				if (WSAPoll(polled.data(), static_cast<unsigned long>(polled.size()), -1) == SOCKET_ERROR)
+				{
+					throw std::runtime_error("WSAPoll failed");
+				}
+
+				/*Clients accepted this round have no entry in polled, they're picked up next time round*/
+				const size_t polledClients = clients.size();
+				if (polled[0].revents & POLLRDNORM)
+				{
+					drainWakeups();
+				}
+				if (listening && (polled[1].revents & POLLRDNORM))
+				{
+					acceptClients(listener);
+				}
+				collectCompletions();
+
+				for (size_t idx = 0; idx < polledClients; ++idx)
+				{
+					const short events = polled[idx + firstClient].revents;
+					if (!clients[idx].readDone && (events & (POLLRDNORM | POLLHUP | POLLERR)))
+					{
+						receive(clients[idx]);
+					}
+					if (!clients[idx].closed && (events & POLLNVAL))
+					{
+						clients[idx].closed = true;
+					}
+				}
+
+				for (auto& client : clients)
+				{
+					deliver(client);
+					if (!client.closed)
+					{
+						flush(client);
+					}
+					if (client.readDone && client.replies.empty() && client.output.empty())
+					{
+						client.closed = true;
+					}
+				}
+
+				/*Replies still being worked on for a closed client are dropped when they come back*/
+				for (auto& client : clients)
+				{
+					if (client.closed)
+					{
+						closesocket(client.socket);
+					}
+				}
+				clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client& client) { return client.closed; }), clients.end());
+			}
+
+			for (auto& client : clients)
+			{
+				closesocket(client.socket);
+			}
+			clients.clear();
+		}
+
+	private:
+		void acceptClients(SOCKET listener)
+		{
+			for (;;)
+			{
+				SOCKET socket = accept(listener, nullptr, nullptr);
+				if (socket == INVALID_SOCKET)
+				{
+					return;
+				}
+
+				if (!setNonBlocking(socket))
+				{
+					closesocket(socket);
+					continue;
+				}
+
+				adopt(socket);
+			}
+		}
+
+		void drainWakeups()
+		{
+			char wakes[256];
+			while (recv(wakeReader, wakes, sizeof(wakes), 0) > 0)
+			{
+			}
+		}
+
+		void collectCompletions()
+		{
+			for (auto& completion : pool.takeCompleted())
+			{
+				latency.record(microsSince(completion.received));
+
+				auto client = std::find_if(clients.begin(), clients.end(), [&completion](const Client& candidate) { return candidate.id == completion.client; });
+				if (client != clients.end() && completion.sequence >= client->firstReply)
+				{
+					client->replies[completion.sequence - client->firstReply] = std::move(completion.response);
+				}
+			}
+		}
+
+		void receive(Client& client)
+		{
+			char chunk[ReceiveChunkSize];
+			for (size_t budget = ReceiveBudget; budget != 0;)
+			{
+				const int received = recv(client.socket, chunk, static_cast<int>(std::min(sizeof(chunk), budget)), 0);
+				if (received > 0)
+				{
+					client.input.insert(client.input.end(), chunk, chunk + received);
+					budget -= received;
+					continue;
+				}
+
+				if (received == 0)
+				{
+					client.readDone = true;
+				}
+				else if (!wouldBlock())
+				{
+					client.closed = true;
+				}
+				break;
+			}
+
+			/*Every complete frame gets a reply slot in order, a partial one waits for more bytes*/
+			size_t consumed = 0;
+			while (!client.closed && client.input.size() - consumed >= sizeof(uint32_t))
+			{
+				uint32_t length;
+				memcpy(&length, client.input.data() + consumed, sizeof(length));
+				if (length == 0 || length > MaximumRequestSize)
+				{
+					client.closed = true;
+					break;
+				}
+				if (client.input.size() - consumed - sizeof(length) < length)
+				{
+					break;
+				}
+
+				const uint8_t* frame = client.input.data() + consumed + sizeof(length);
+				dispatch(client, frame[0], std::string_view(reinterpret_cast<const char*>(frame + 1), length - 1));
+				consumed += sizeof(length) + length;
+			}
+
+			client.input.erase(client.input.begin(), client.input.begin() + std::min(consumed, client.input.size()));
+		}
+
+		void dispatch(Client& client, uint8_t opcode, std::string_view payload)
+		{
+			const auto received = std::chrono::steady_clock::now();
+			const uint64_t sequence = client.firstReply + client.replies.size();
+			client.replies.emplace_back();
+
+			Request request;
+			if (!parseRequest(opcode, payload, request))
+			{
+				client.replies.back() = Response{ DaemonStatus::BadRequest, std::string() };
+			}
+			else if (request.opcode == DaemonOpcode::Stats || request.opcode == DaemonOpcode::Shutdown)
+			{
+				client.replies.back() = control(request.opcode);
+			}
+			else if (std::optional<Response> warm = answerWarm(request))
+			{
+				client.replies.back() = std::move(*warm);
+			}
+			else
+			{
+				pool.submit([this, id = client.id, sequence, received, request = std::move(request)]()
+				{
+					return Completion{ id, sequence, received, answer(request) };
+				});
+				return;
+			}
+
+			latency.record(microsSince(received));
+		}
+
+		/*Moves the replies that are ready, in order, into the output buffer*/
+		void deliver(Client& client)
+		{
+			while (!client.replies.empty() && client.replies.front())
+			{
+				appendFrame(client.output, *client.replies.front());
+				client.replies.pop_front();
+				++client.firstReply;
+			}
+		}
+
+		void flush(Client& client)
+		{
+			while (client.outputSent < client.output.size())
+			{
+				const size_t remaining = std::min<size_t>(client.output.size() - client.outputSent, MaximumFrameSize);
+				const int sent = send(client.socket, reinterpret_cast<const char*>(client.output.data() + client.outputSent), static_cast<int>(remaining), 0);
+				if (sent == SOCKET_ERROR)
+				{
+					client.closed = !wouldBlock();
+					return;
+				}
+				client.outputSent += sent;
+			}
+
+			client.output.clear();
+			client.outputSent = 0;
+		}
+
+		/*Answers request on the loop when its image is cached with what it needs already built, nothing
+		otherwise.  Never waits, an image a worker is busy with counts as cold, and the lock taken to
+		check stays held while answering so a worker can't take the image in between.*/
+		std::optional<Response> answerWarm(const Request& request)
+		{
+			if (request.opcode == DaemonOpcode::LookupLines)
+			{
+				return std::nullopt;	/*any lookup may compile a unit's line program*/
+			}
+
+			const std::shared_ptr<CachedImage> cached = cache.find(request.path);
+			if (!cached)
+			{
+				return std::nullopt;
+			}
+
+			std::unique_lock<std::mutex> held(cached->lock, std::try_to_lock);
+			if (!held.owns_lock())
+			{
+				return std::nullopt;
+			}
+
+			const bool built = (request.opcode == DaemonOpcode::Describe && cached->description)
+				|| (request.opcode == DaemonOpcode::LookupStub && cached->stubs)
+				|| (request.opcode == DaemonOpcode::LookupExport && cached->exports);
+			if (!built)
+			{
+				return std::nullopt;
+			}
+
+			try
+			{
+				return answerImage(request, *cached, held);
+			}
+			catch (const std::exception& error)
+			{
+				return Response{ DaemonStatus::Failed, error.what() };
+			}
+		}
+
+		/*Answers a request a worker picked up, decoding whatever it needs*/
+		Response answer(const Request& request)
+		{
+			try
+			{
+				const std::shared_ptr<CachedImage> cached = cache.acquire(request.path);
+				if (request.opcode == DaemonOpcode::LookupLines)
+				{
+					return lookupLines(request, *cached);
+				}
+
+				std::unique_lock<std::mutex> held(cached->lock);
+				return answerImage(request, *cached, held);
+			}
+			catch (const std::exception& error)
+			{
+				return { DaemonStatus::Failed, error.what() };
+			}
+		}
+
+		/*Describe, LookupStub and LookupExport, with cached.lock held*/
+		Response answerImage(const Request& request, CachedImage& cached, const std::unique_lock<std::mutex>& held)
+		{
+			switch (request.opcode)
+			{
+			case DaemonOpcode::Describe:
+				return { DaemonStatus::Ok, cache.description(cached, held) };
+
+			case DaemonOpcode::LookupStub:
+			{
+				std::string target = cache.stubTarget(cached, request.address, held);
+				if (target.empty())
+				{
+					return { DaemonStatus::NotFound, std::string() };
+				}
+				return { DaemonStatus::Ok, std::move(target) };
+			}
+
+			case DaemonOpcode::LookupExport:
+			{
+				const std::optional<uint64_t> address = cache.findExport(cached, request.name, held);
+				if (!address)
+				{
+					return { DaemonStatus::NotFound, std::string() };
+				}
+				return { DaemonStatus::Ok, std::string(reinterpret_cast<const char*>(&*address), sizeof(*address)) };
+			}
+
+			default:
+				return { DaemonStatus::BadRequest, std::string() };
+			}
+		}
+
+		Response lookupLines(const Request& request, CachedImage& cached)
+		{
+			if (!hasDwarf(cached.image))
+			{
+				return { DaemonStatus::Failed, "no __DWARF segment, line lookups need the image's dSYM" };
+			}
+
+			/*Line indexes are cached per LC_UUID, so rebuilt images with the same dSYM share one.
+			The index reads section names, which belong to the image.*/
+			std::shared_ptr<const DwarfLineIndex> index;
+			{
+				NameScope scope(cached.names);
+				index = lineIndexFor(cached.fileName, cached.image);
+			}
+
+			std::vector<LineInfo> lines(request.addresses.size());
+			index->lookup(request.addresses.data(), request.addresses.size(), lines.data());
+
+			std::string reply;
+			for (const auto& line : lines)
+			{
+				const std::string_view path = line.line ? index->path(line.file) : std::string_view();
+				const uint32_t pathLength = static_cast<uint32_t>(path.size());
+				reply.append(reinterpret_cast<const char*>(&line.line), sizeof(line.line));
+				reply.append(reinterpret_cast<const char*>(&pathLength), sizeof(pathLength));
+				reply.append(path);
+			}
+			return { DaemonStatus::Ok, reply };
+		}
+
+		/*Requests about the daemon itself, always answered on the loop*/
+		Response control(DaemonOpcode opcode)
+		{
+			if (opcode == DaemonOpcode::Shutdown)
+			{
+				shuttingDown = true;
+				return { DaemonStatus::Ok, std::string() };
+			}
+
+			std::ostringstream out;
+			out << "Requests : " << latency.requests() << std::endl;
+			out << "Latency p50 : " << latency.percentile(0.50) << " us" << std::endl;
+			out << "Latency p99 : " << latency.percentile(0.99) << " us" << std::endl;
+			out << "Requests In Flight : " << pool.pending() << std::endl;
+			out << "Cached Images : " << cache.size() << std::endl;
+			out << "Cache Hits : " << cache.hits() << std::endl;
+			out << "Cache Misses : " << cache.misses() << std::endl;
+			out << "Cache Evictions : " << cache.evictions() << std::endl;
+			out << "Clients : " << clients.size() << std::endl;
+			return { DaemonStatus::Ok, out.str() };
+		}
+
+		ImageCache			cache;
+		LatencyStats		latency;
+		std::vector<Client>	clients;
+		uint64_t			nextClientId = 0;
+		bool				shuttingDown = false;
+		SOCKET				wakeReader;
+		WorkerPool			pool;		/*last, so its threads are joined before anything they use goes away*/
+	};
+
+	/*Serves the listener's clients, or only connection when there is no listener, until Shutdown*/
+	void serve(const DaemonOptions& options, SOCKET listener, SOCKET connection)
+	{
+		SOCKET wakeReader;
+		SOCKET wakeWriter;
+		if (!socketPair(wakeReader, wakeWriter))
+		{
+			throw std::runtime_error("couldn't create the daemon's wakeup socket");
+		}
+
+		bool adopted = false;
+		try
+		{
+			if (!setNonBlocking(wakeReader) || !setNonBlocking(wakeWriter) || (connection != INVALID_SOCKET && !setNonBlocking(connection)))
+			{
+				throw std::runtime_error("couldn't make the daemon's sockets non-blocking");
+			}
+
+			/*Once adopted the server closes the connection along with its other clients*/
+			Server server(options, wakeReader, wakeWriter);
+			if (connection != INVALID_SOCKET)
+			{
+				server.adopt(connection);
+				adopted = true;
+			}
+			server.serve(listener);
+		}
+		catch (...)
+		{
+			if (connection != INVALID_SOCKET && !adopted)
+			{
+				closesocket(connection);
+			}
+			closesocket(wakeReader);
+			closesocket(wakeWriter);
+			throw;
+		}
+
+		closesocket(wakeReader);
+		closesocket(wakeWriter);
+	}
+}
+
+void runDaemon(const DaemonOptions& options)
+{
+	sockaddr_un address = {};
+	if (options.socketPath.empty() || options.socketPath.size() >= sizeof(address.sun_path))
+	{
+		throw std::invalid_argument("socket path must fit in sockaddr_un");
+	}
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path, options.socketPath.c_str(), options.socketPath.size());
+
+	SocketLibrary sockets;
+
+	SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET)
+	{
+		throw std::runtime_error("couldn't create the daemon socket");
+	}
+
+	/*A socket file left behind by an earlier run would make bind fail*/
+	std::error_code ignored;
+	std::filesystem::remove(options.socketPath, ignored);
+
+	if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+		|| listen(listener, SOMAXCONN) == SOCKET_ERROR
+		|| !setNonBlocking(listener))
+	{
+		closesocket(listener);
+		throw std::runtime_error("couldn't listen on " + options.socketPath);
+	}
+
+	try
+	{
+		serve(options, listener, INVALID_SOCKET);
+	}
+	catch (...)
+	{
+		closesocket(listener);
+		std::filesystem::remove(options.socketPath, ignored);
+		throw;
+	}
+
+	closesocket(listener);
+	std::filesystem::remove(options.socketPath, ignored);
+}
+
+void serveConnection(const DaemonOptions& options, uintptr_t connection)
+{
+	SocketLibrary sockets;
+	serve(options, INVALID_SOCKET, static_cast<SOCKET>(connection));
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Decoder.h"
+
+/*
+ * Wire format, every integer little endian.
+ *
+ * Request:  uint32 length | uint8 opcode | payload     (length counts opcode and payload)
+ * Response: uint32 length | uint8 status | payload     (length counts status and payload)
+ *
+ * Paths are the rest of the payload after any fixed fields, without a terminator.
+ */
+enum class DaemonOpcode : uint8_t
+{
+	Describe = 1,		/*path -> the text decodeFile would write*/
+	LookupStub = 2,		/*uint64 address, path -> import name the stub or pointer slot reaches*/
+	LookupExport = 3,	/*uint32 name length, name, path -> uint64 address*/
+	Stats = 4,			/*empty -> text*/
+	Shutdown = 5,		/*empty -> empty, the daemon exits once the reply is sent*/
+	LookupLines = 6		/*uint32 count, count uint64 addresses, dSYM path -> per address uint32 line, uint32 path length, path*/
+};
+
+enum class DaemonStatus : uint8_t
+{
+	Ok = 0,
+	NotFound = 1,
+	BadRequest = 2,
+	Failed = 3		/*payload is the error message*/
+};
+
+struct DaemonOptions
+{
+	std::string		socketPath;
+	size_t			cacheCapacity = 64;		/*decoded images kept warm, least recently used are evicted first*/
+	DecodeOptions	decode;
+};
+
+/*Serves queries over a Unix domain socket until a Shutdown request arrives.  All clients are
+multiplexed on one WSAPoll loop, requests that have to decode run on a worker pool, and decoded
+images stay cached between requests.  A request longer than 1 MiB closes its connection.*/
+void runDaemon(const DaemonOptions& options);
+
+/*Serves a single socket that is already connected, such as one end of a socket pair, until it
+sends Shutdown or hangs up.  connection is a SOCKET, a file descriptor outside Windows, and is
+closed on return.*/
+void serveConnection(const DaemonOptions& options, uintptr_t connection);
@@ -1,31 +1,25 @@
 #include <string>
 #include <fstream>
+#include <algorithm>
 #include <deque>
 #include <iostream>
 #include <filesystem>
+#include <iomanip>
+#ifdef _WIN32
 #include <winsock2.h> /*Access to endian conversion functions*/
 #pragma comment(lib, "Ws2_32.lib")
-#include "CommandVariant.h"
-
-template <typename Structure>
-Structure readInAndReset(std::ifstream& fin)
-{
-	std::streampos originalOffset = fin.tellg();
-	Structure structure;
-	fin.read((char*)&structure, sizeof(structure));
-	fin.seekg(originalOffset);
-
-	return structure;
-}
-
-template <typename Structure>
-Structure readIn(std::ifstream& fin)
-{
-	Structure structure;
-	fin.read((char*)&structure, sizeof(structure));
-
-	return structure;
-}
+#endif
+#include "ChainedFixups.h"
+#include "DwarfLines.h"
+#include "Decoder.h"
+#include "ExportsTrie.h"
+#include "ObjCMetadata.h"
+#include "Reader.h"
+#include "Relocations.h"
+#include "SectionProfile.h"
+#include "Streaming.h"
+#include "StubIndex.h"
+#include "SymbolTable.h"
 
 bool is64Arch(std::ifstream& fin)
 {
@@ -66,6 +60,7 @@ Command_Struct determineCommand(std::ifstream& fin, uint32_t commandType)
 	case LC_ID_DYLIB:
 	case LC_LOAD_WEAK_DYLIB:
 	case LC_REEXPORT_DYLIB:
+	case LC_LOAD_UPWARD_DYLIB:
 		return readInAndReset<dylib_command>(fin);
 
 	case LC_ID_DYLINKER:
@@ -88,6 +83,8 @@ Command_Struct determineCommand(std::ifstream& fin, uint32_t commandType)
 	case LC_FUNCTION_STARTS:
 	case LC_DATA_IN_CODE:
 	case LC_DYLIB_CODE_SIGN_DRS:
+	case LC_DYLD_EXPORTS_TRIE:
+	case LC_DYLD_CHAINED_FIXUPS:
 		return readInAndReset<linkedit_data_command>(fin);
 
 	case LC_SEGMENT_64:
@@ -96,6 +93,7 @@ Command_Struct determineCommand(std::ifstream& fin, uint32_t commandType)
 	case LC_ROUTINES_64:
 		return readInAndReset<routines_command_64>(fin);
 
+	case LC_DYLD_INFO:
 	case LC_DYLD_INFO_ONLY:
 		return readInAndReset<dyld_info_command>(fin);
 
@@ -112,7 +110,7 @@ mach_header_64 decodeHeader(std::ifstream& fin)
 	return readIn<mach_header_64>(fin);
 }
 
-void handleCommand(std::ifstream& fin, std::ofstream& fout, Command_Struct cmd)
+void handleCommand(std::ifstream& fin, std::ostream& fout, Command_Struct cmd)
 {
 	if (std::holds_alternative<version_min_command>(cmd))
 	{
@@ -129,39 +127,597 @@ void handleCommand(std::ifstream& fin, std::ofstream& fout, Command_Struct cmd)
 	}
 	else if (std::holds_alternative<segment_command_64>(cmd))
 	{
-		fout << "Data Segment Name : " << std::get<segment_command_64>(cmd).segname << std::endl;
+		fout << "Data Segment Name : " << fixedName(std::get<segment_command_64>(cmd).segname) << std::endl;
 	}
 }
 
-void decodeFile(const std::string& inputFileName, const std::string& outputFileName)
+void handleDylibs(std::ostream& fout, const MachImage& image)
 {
-	std::ifstream fin(inputFileName.c_str(), std::ifstream::binary);
-	std::ofstream fout(outputFileName.c_str(), std::ofstream::binary);
+	if (!corpusNames().name(image.installName).empty())
+	{
+		fout << "Install Name : " << corpusNames().name(image.installName) << std::endl;
+	}
 
-	mach_header_64 header = decodeHeader(fin);
-	auto commands = std::deque<Command_Struct>();
+	for (NameId dylib : image.dylibNames)
+	{
+		fout << "Dylib : " << corpusNames().name(dylib) << std::endl;
+	}
+}
+
+/*Reads the section_64 headers that directly follow a segment command, leaving the stream at the command*/
+void decodeSections(std::ifstream& fin, const segment_command_64& segment, MachImage& image)
+{
+	uint64_t sectionsOffset = uint64_t(fin.tellg()) + sizeof(segment_command_64);
+	auto segmentSections = readArrayAt<section_64>(fin, sectionsOffset, segment.nsects, ArenaAllocator<section_64>(workerArena()));
+
+	for (const auto& sect : segmentSections)
+	{
+		image.sections.push_back({
+			corpusNames().intern(fixedName(sect.segname)), corpusNames().intern(fixedName(sect.sectname)),
+			sect.addr, sect.size, sect.offset, sect.reloff, sect.nreloc, sect.flags, sect.reserved1, sect.reserved2 });
+	}
+}
 
-	for (uint32_t idx = 0; idx < header.ncmds; ++idx)
+/*Interns the lc_str that trails a load command, leaving the stream at the command*/
+NameId decodeCommandString(std::ifstream& fin, const load_command& loadCommandHeader, const lc_str& string)
+{
+	auto command = readArrayAt<char>(fin, uint64_t(fin.tellg()), loadCommandHeader.cmdsize, ArenaAllocator<char>(workerArena()));
+	if (string.offset >= command.size())
+	{
+		return corpusNames().intern(std::string_view());
+	}
+
+	const char* start = command.data() + string.offset;
+	return corpusNames().intern(std::string_view(start, strnlen(start, command.size() - string.offset)));
+}
+
+MachImage decodeImage(std::ifstream& fin)
+{
+	MachImage image;
+	image.headerOffset = uint64_t(fin.tellg());
+	image.header = decodeHeader(fin);
+	image.installName = corpusNames().intern(std::string_view());
+
+	for (uint32_t idx = 0; idx < image.header.ncmds; ++idx)
 	{
 		load_command loadCommandHeader = readInAndReset<load_command>(fin);
-		commands.emplace_back(determineCommand(fin, loadCommandHeader.cmd));
+		image.commands.emplace_back(determineCommand(fin, loadCommandHeader.cmd));
+
+		if (const auto* segment = std::get_if<segment_command_64>(&image.commands.back()))
+		{
+			image.segments.push_back({
+				corpusNames().intern(fixedName(segment->segname)), segment->nsects,
+				segment->vmaddr, segment->vmsize, segment->fileoff, segment->filesize });
+			decodeSections(fin, *segment, image);
+		}
+		else if (const auto* dylib = std::get_if<dylib_command>(&image.commands.back()))
+		{
+			NameId name = decodeCommandString(fin, loadCommandHeader, dylib->dylib.name);
+			if (dylib->cmd == LC_ID_DYLIB)
+			{
+				image.installName = name;
+			}
+			else
+			{
+				image.dylibNames.push_back(name);
+			}
+		}
+
 		fin.ignore(loadCommandHeader.cmdsize);
 	}
 
-	for (const auto& command : commands)
+	return image;
+}
+
+/*Linkedit tables the output handlers share, read whole by readTables() or gathered by streamImage()*/
+struct LinkeditTables
+{
+	SymbolTable									symbols;
+	std::optional<RelocationIndex>				relocations;	/*MH_OBJECT only, sections are decoded as they are written out*/
+	std::optional<ChainedFixups>				fixups;
+	std::optional<StubIndex>					stubs;
+	std::vector<ExportedSymbol>					exports;
+
+	/*__objc_ sections streaming kept in memory, by file offset, for ObjCMetadata to read from*/
+	std::deque<std::pair<uint64_t, ArenaVector<uint8_t>>>	objcSections;
+};
+
+void readTables(std::ifstream& fin, const MachImage& image, const DecodeOptions& options, LinkeditTables& tables)
+{
+	const symtab_command* symtab = findCommand<symtab_command>(image);
+	if (symtab)
+	{
+		tables.symbols = options.sharedStrings ? SymbolTable(fin, *symtab, *options.sharedStrings) : SymbolTable(fin, *symtab);
+		tables.stubs.emplace(fin, image, tables.symbols);
+	}
+
+	if (image.header.filetype == MH_OBJECT)
+	{
+		tables.relocations.emplace(fin, image, tables.symbols);
+	}
+
+	if (const linkedit_data_command* chainedFixupsCommand = findLinkeditData(image, LC_DYLD_CHAINED_FIXUPS))
+	{
+		tables.fixups = decodeChainedFixups(fin, image, *chainedFixupsCommand, options.serial);
+	}
+
+	tables.exports = decodeExports(fin, image);
+}
+
+void handleRelocations(std::ostream& fout, const MachImage& image, LinkeditTables& tables)
+{
+	if (!tables.relocations)
+	{
+		return;
+	}
+
+	for (size_t idx = 0; idx < image.sections.size(); ++idx)
+	{
+		const Section& sect = image.sections[idx];
+		const RelocationTable* table = sect.nreloc != 0 ? tables.relocations->forSection(idx) : nullptr;
+		if (!table)
+		{
+			continue;
+		}
+
+		fout << "Relocations : " << corpusNames().name(sect.segmentName) << "," << corpusNames().name(sect.name) << " (" << table->size() << ")" << std::endl;
+
+		for (size_t entry = 0; entry < table->size(); ++entry)
+		{
+			/*An addend entry is shown with the entry it applies to*/
+			if (table->targetKind[entry] == RelocationTarget::Addend)
+			{
+				continue;
+			}
+
+			fout << "    0x" << std::hex << table->address[entry] << std::dec << " -> ";
+
+			std::string_view name = relocationTargetName(*table, entry, image, tables.symbols);
+			if (!name.empty())
+			{
+				fout << name;
+			}
+			else if (table->targetKind[entry] == RelocationTarget::Absolute)
+			{
+				fout << "absolute";
+			}
+			else
+			{
+				fout << "unresolved";
+			}
+
+			if (table->addend[entry] != 0)
+			{
+				fout << " + " << table->addend[entry];
+			}
+			fout << std::endl;
+		}
+	}
+}
+
+void handleChainedFixups(std::ostream& fout, const ChainedFixups& fixups)
+{
+	fout << "Chained Fixups : " << fixups.rebaseAddress.size() << " rebases, " << fixups.bindAddress.size() << " binds" << std::endl;
+
+	for (size_t idx = 0; idx < fixups.bindAddress.size(); ++idx)
+	{
+		fout << "    0x" << std::hex << fixups.bindAddress[idx] << std::dec << " -> " << fixups.importName(fixups.bindImport[idx]);
+		if (fixups.bindAddend[idx] != 0)
+		{
+			fout << " + " << fixups.bindAddend[idx];
+		}
+		fout << std::endl;
+	}
+}
+
+void handleExports(std::ostream& fout, const std::vector<ExportedSymbol>& exports)
+{
+	for (const auto& symbol : exports)
+	{
+		std::string_view name = corpusNames().name(symbol.name);
+		fout << "Export : " << name;
+		if (symbol.flags & EXPORT_SYMBOL_FLAGS_REEXPORT)
+		{
+			std::string_view importName = corpusNames().name(symbol.importName);
+			fout << " (re-export " << (importName.empty() ? name : importName) << " from dylib " << symbol.other << ")" << std::endl;
+		}
+		else
+		{
+			fout << " 0x" << std::hex << symbol.address << std::dec << std::endl;
+		}
+	}
+}
+
+void writeProfile(std::ostream& fout, const SectionProfile& profile)
+{
+	const std::ios_base::fmtflags originalFlags = fout.flags();
+	const char originalFill = fout.fill();
+	fout << " size " << profile.size
+		<< std::fixed << std::setprecision(3)
+		<< " entropy " << profile.entropy
+		<< " printable " << profile.printableDensity;
+
+	/*The histogram itself is 256 counts, its most frequent values and their share of the section stand in for it*/
+	fout << " top";
+	for (uint8_t value : commonBytes(profile.histogram, 3))
+	{
+		fout << " " << std::hex << std::setw(2) << std::setfill('0') << unsigned(value) << std::dec
+			<< ":" << double(profile.histogram[value]) / double(profile.size);
+	}
+	fout << std::endl;
+	fout.flags(originalFlags);
+	fout.fill(originalFill);
+}
+
+void handleSectionProfiles(std::ostream& fout, const MachImage& image, const std::vector<SectionProfile>& profiles)
+{
+	for (size_t idx = 0; idx < profiles.size(); ++idx)
+	{
+		if (profiles[idx].size == 0)
+		{
+			continue;
+		}
+
+		const Section& sect = image.sections[idx];
+		fout << "Section Profile : " << corpusNames().name(sect.segmentName) << "," << corpusNames().name(sect.name);
+		writeProfile(fout, profiles[idx]);
+	}
+}
+
+/*Bounded memory path for very large images.  Everything is read through the scheduler's window
+pool in file offset order, in three passes since each depends on what the one before read:
+
+	1. the chained fixups payload, export trie, indirect symbol table, relocation entries and
+	   __objc_ sections are retained whole
+	2. section contents are profiled, chained fixup pages walked, and only the nlist entries the
+	   stubs and relocations refer to are kept
+	3. the names of those entries are gathered from the string table
+
+Everything kept is charged against the memory limit, and a table that won't fit is reported and
+left out rather than read anyway.  Retained __objc_ sections are profiled from the retained copy
+instead of being read a second time.  Segments without sections, such as the memory regions of an
+MH_CORE file, are profiled as a whole.  DWARF line tables aren't streamed, a __DWARF segment is
+reported as skipped.*/
+void streamImage(std::ifstream& fin, std::ostream& fout, const std::string& inputFileName, const MachImage& image,
+	const DecodeOptions& options, LinkeditTables& tables)
+{
+	StreamOptions streamOptions;
+	streamOptions.memoryLimit = options.streamMemoryLimit;
+	StreamScheduler scheduler(inputFileName, streamOptions);
+
+	ArenaAllocator<uint8_t> allocator(workerArena());
+	std::vector<std::string> skipped;
+	auto retain = [&](uint64_t offset, uint64_t size, auto& into, const char* table)
+	{
+		size = clipToFile(fin, offset, static_cast<size_t>(size), 1);
+		if (!scheduler.retain(offset, size, into))
+		{
+			skipped.push_back(std::string(table) + " (" + std::to_string(size) + " bytes)");
+			return false;
+		}
+		return true;
+	};
+
+	const linkedit_data_command* chainedFixupsCommand = findLinkeditData(image, LC_DYLD_CHAINED_FIXUPS);
+	ArenaVector<uint8_t> fixupsBlob(allocator);
+	const bool haveFixups = chainedFixupsCommand && retain(chainedFixupsCommand->dataoff, chainedFixupsCommand->datasize, fixupsBlob, "chained fixups");
+
+	const std::pair<uint64_t, uint64_t> trieRange = exportsTrieRange(image);
+	ArenaVector<uint8_t> trie(allocator);
+	retain(trieRange.first, trieRange.second, trie, "export trie");
+
+	const symtab_command* symtab = findCommand<symtab_command>(image);
+	const dysymtab_command* dysymtab = findCommand<dysymtab_command>(image);
+	ArenaVector<uint32_t> indirect{ ArenaAllocator<uint32_t>(workerArena()) };
+	const bool haveIndirect = !symtab || !dysymtab
+		|| retain(dysymtab->indirectsymoff, uint64_t(dysymtab->nindirectsyms) * sizeof(uint32_t), indirect, "indirect symbols");
+
+	/*Retained tables must not move once scheduled, hence the deque*/
+	std::deque<ArenaVector<uint32_t>> relocationEntries;
+	std::vector<const ArenaVector<uint32_t>*> sectionEntries(image.sections.size(), nullptr);
+	if (image.header.filetype == MH_OBJECT)
+	{
+		for (size_t idx = 0; idx < image.sections.size(); ++idx)
+		{
+			const Section& sect = image.sections[idx];
+			relocationEntries.emplace_back(ArenaAllocator<uint32_t>(workerArena()));
+			if (sect.nreloc != 0 && retain(sect.reloff, uint64_t(sect.nreloc) * sizeof(relocation_info), relocationEntries.back(), "relocations"))
+			{
+				sectionEntries[idx] = &relocationEntries.back();
+			}
+		}
+	}
+
+	/*ObjC metadata is pointer chasing, its own reads stay small point reads wherever a section doesn't fit*/
+	std::vector<const ArenaVector<uint8_t>*> objcSections(image.sections.size(), nullptr);
+	for (size_t idx = 0; idx < image.sections.size(); ++idx)
+	{
+		const Section& sect = image.sections[idx];
+		if (hasFileContents(image, idx) && corpusNames().name(sect.name).substr(0, 7) == "__objc_")
+		{
+			tables.objcSections.emplace_back(sect.offset, ArenaVector<uint8_t>(allocator));
+			if (scheduler.retain(sect.offset, sect.size, tables.objcSections.back().second))
+			{
+				objcSections[idx] = &tables.objcSections.back().second;
+			}
+			else
+			{
+				tables.objcSections.pop_back();
+			}
+		}
+	}
+
+	for (const auto& segment : image.segments)
+	{
+		if (corpusNames().name(segment.name) == "__DWARF")
+		{
+			skipped.push_back("DWARF line tables (" + std::to_string(segment.filesize) + " bytes)");
+		}
+	}
+
+	scheduler.run();
+
+	std::vector<SectionProfiler> sectionProfilers(image.sections.size());
+	for (size_t idx = 0; idx < image.sections.size(); ++idx)
+	{
+		if (objcSections[idx])
+		{
+			sectionProfilers[idx].accumulate(objcSections[idx]->data(), objcSections[idx]->size());
+		}
+		else if (hasFileContents(image, idx))
+		{
+			scheduler.schedule(image.sections[idx].offset, image.sections[idx].size, [&sectionProfilers, idx](uint64_t, const uint8_t* data, size_t size)
+			{
+				sectionProfilers[idx].accumulate(data, size);
+			});
+		}
+	}
+
+	std::vector<SectionProfiler> segmentProfilers(image.segments.size());
+	for (size_t idx = 0; idx < image.segments.size(); ++idx)
+	{
+		if (image.segments[idx].nsects == 0)
+		{
+			scheduler.schedule(image.segments[idx].fileoff, image.segments[idx].filesize, [&segmentProfilers, idx](uint64_t, const uint8_t* data, size_t size)
+			{
+				segmentProfilers[idx].accumulate(data, size);
+			});
+		}
+	}
+
+	if (haveFixups)
+	{
+		tables.fixups.emplace();
+		scheduleChainedFixups(fixupsBlob, image, scheduler, *tables.fixups);
+	}
+
+	bool haveSymbols = false;
+	if (symtab)
+	{
+		std::vector<uint32_t> wanted = StubIndex::referencedSymbols(indirect.data(), indirect.size());
+		for (const auto* entries : sectionEntries)
+		{
+			if (entries)
+			{
+				externSymbols(entries->data(), entries->size() / 2, wanted);
+			}
+		}
+		const size_t wantedSize = wanted.size() * sizeof(nlist_64);
+		haveSymbols = tables.symbols.scheduleSymbols(fin, *symtab, std::move(wanted), scheduler);
+		if (!haveSymbols)
+		{
+			skipped.push_back("symbols (" + std::to_string(wantedSize) + " bytes)");
+		}
+	}
+
+	scheduler.run();
+
+	if (haveSymbols)
+	{
+		tables.symbols.scheduleStrings(*symtab, scheduler);
+		scheduler.run();
+		if (tables.symbols.droppedNames() != 0)
+		{
+			skipped.push_back("symbol names (" + std::to_string(tables.symbols.droppedNames()) + " names)");
+		}
+	}
+
+	std::vector<SectionProfile> profiles;
+	for (auto& profiler : sectionProfilers)
+	{
+		profiles.push_back(profiler.finish());
+	}
+	handleSectionProfiles(fout, image, profiles);
+
+	for (size_t idx = 0; idx < image.segments.size(); ++idx)
+	{
+		SectionProfile profile = segmentProfilers[idx].finish();
+		if (profile.size != 0)
+		{
+			fout << "Segment Profile : " << corpusNames().name(image.segments[idx].name);
+			writeProfile(fout, profile);
+		}
+	}
+
+	for (const auto& table : skipped)
+	{
+		fout << "Stream Skipped : " << table << std::endl;
+	}
+
+	if (image.header.filetype == MH_OBJECT)
+	{
+		/*Every section is handed its table here, so the index never reads entries past the scheduler*/
+		tables.relocations.emplace(fin, image, tables.symbols);
+		for (size_t idx = 0; idx < image.sections.size(); ++idx)
+		{
+			if (image.sections[idx].nreloc == 0)
+			{
+				tables.relocations->adopt(idx, RelocationTable());
+			}
+			else if (sectionEntries[idx])
+			{
+				tables.relocations->adopt(idx, decodeRelocationWords(sectionEntries[idx]->data(), sectionEntries[idx]->size() / 2, image, tables.symbols));
+			}
+			else
+			{
+				tables.relocations->adopt(idx, std::nullopt);
+			}
+		}
+	}
+
+	if (symtab && haveIndirect)
+	{
+		tables.stubs.emplace(indirect.data(), indirect.size(), image, tables.symbols);
+	}
+
+	tables.exports = decodeExportsTrie(trie, preferredLoadAddress(image));
+}
+
+void handleStubs(std::ostream& fout, const MachImage& image, const LinkeditTables& tables)
+{
+	if (!tables.stubs)
+	{
+		return;
+	}
+
+	const StubIndex& stubs = *tables.stubs;
+	for (size_t slot = 0; slot < stubs.size(); ++slot)
+	{
+		const StubTarget& target = stubs.target(slot);
+		if (corpusNames().name(target.symbol).empty())
+		{
+			continue;
+		}
+
+		fout << (target.kind == StubKind::Stub ? "Stub : 0x" : "Symbol Pointer : 0x") << std::hex << stubs.slotAddress(slot) << std::dec
+			<< " -> " << corpusNames().name(target.symbol);
+		if (target.libraryOrdinal != SELF_LIBRARY_ORDINAL && target.libraryOrdinal <= image.dylibNames.size())
+		{
+			fout << " (" << corpusNames().name(image.dylibNames[target.libraryOrdinal - 1]) << ")";
+		}
+		fout << std::endl;
+	}
+}
+
+void handleObjCMethods(std::ostream& fout, ObjCMetadata& objc, uint64_t listAddress, char kind)
+{
+	if (listAddress == 0)
+	{
+		return;
+	}
+
+	for (const auto& method : objc.methodList(listAddress))
+	{
+		fout << "    " << kind << " " << corpusNames().name(method.selector) << std::endl;
+	}
+}
+
+void handleObjC(std::ifstream& fin, std::ostream& fout, const MachImage& image, const LinkeditTables& tables)
+{
+	/*Without its decoded fixups every pointer would read as a raw chain entry*/
+	if (findLinkeditData(image, LC_DYLD_CHAINED_FIXUPS) && !tables.fixups)
+	{
+		return;
+	}
+
+	ObjCMetadata objc(fin, image, tables.fixups ? &*tables.fixups : nullptr);
+	if (!objc.hasMetadata())
+	{
+		return;
+	}
+
+	for (const auto& section : tables.objcSections)
+	{
+		objc.addResident(section.first, section.second);
+	}
+
+	for (uint64_t address : objc.classAddresses())
+	{
+		const ObjCClass& cls = objc.objcClass(address);
+		fout << "ObjC Class : " << corpusNames().name(cls.name);
+		if (!corpusNames().name(cls.superclass).empty())
+		{
+			fout << " : " << corpusNames().name(cls.superclass);
+		}
+		fout << std::endl;
+
+		handleObjCMethods(fout, objc, cls.classMethods, '+');
+		handleObjCMethods(fout, objc, cls.instanceMethods, '-');
+	}
+
+	for (const auto& category : objc.categories())
+	{
+		fout << "ObjC Category : " << corpusNames().name(category.className) << "(" << corpusNames().name(category.name) << ")" << std::endl;
+		handleObjCMethods(fout, objc, category.classMethods, '+');
+		handleObjCMethods(fout, objc, category.instanceMethods, '-');
+	}
+
+	for (NameId protocol : objc.protocols())
+	{
+		fout << "ObjC Protocol : " << corpusNames().name(protocol) << std::endl;
+	}
+}
+
+void handleDwarf(std::ostream& fout, const std::string& inputFileName, const MachImage& image)
+{
+	/*Only dSYMs carry a __DWARF segment, everything else would be indexed for nothing*/
+	if (!hasDwarf(image))
+	{
+		return;
+	}
+
+	const std::shared_ptr<const DwarfLineIndex> lines = lineIndexFor(inputFileName, image);
+	if (!lines->empty())
+	{
+		fout << "DWARF Compilation Units : " << lines->unitCount() << std::endl;
+	}
+}
+
+void writeImage(std::ifstream& fin, std::ostream& fout, const std::string& inputFileName, const MachImage& image, const DecodeOptions& options)
+{
+	for (const auto& command : image.commands)
 	{
 		handleCommand(fin, fout, command);
 	}
 
-	fin.close();
-	fout.close();
+	handleDylibs(fout, image);
+
+	LinkeditTables tables;
+	if (options.streamMemoryLimit != 0)
+	{
+		streamImage(fin, fout, inputFileName, image, options, tables);
+	}
+	else
+	{
+		handleSectionProfiles(fout, image, profileSections(inputFileName, image, options.serial));
+		readTables(fin, image, options, tables);
+	}
+
+	handleRelocations(fout, image, tables);
+
+	if (tables.fixups)
+	{
+		handleChainedFixups(fout, *tables.fixups);
+	}
+
+	handleStubs(fout, image, tables);
+	if (options.streamMemoryLimit == 0)
+	{
+		handleDwarf(fout, inputFileName, image);	/*streamImage() reports it skipped*/
+	}
+	handleObjC(fin, fout, image, tables);
+	handleExports(fout, tables.exports);
 }
 
-int main(int argc, char* argv[])
+void decodeFile(const std::string& inputFileName, const std::string& outputFileName, const DecodeOptions& options)
 {
-	decodeFile(
-		std::filesystem::current_path().append(argv[1]).string(),
-		std::filesystem::current_path().append(argv[2]).string());
+	std::ifstream fin(inputFileName.c_str(), std::ifstream::binary);
+	std::ofstream fout(outputFileName.c_str(), std::ofstream::binary);
 
-	return 0;
+	MachImage image = decodeImage(fin);
+	writeImage(fin, fout, inputFileName, image, options);
+
+	fin.close();
+	workerArena().reset();
+	fout.close();
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#pragma once
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CommandVariant.h"
+#include "StringInterner.h"
+
+/*The parts of a segment_command_64 the decoders use, with the name interned in corpusNames()
+rather than carried as a 16 byte array in every image*/
+struct Segment
+{
+	NameId		name;
+	uint32_t	nsects;
+	uint64_t	vmaddr;
+	uint64_t	vmsize;
+	uint64_t	fileoff;
+	uint64_t	filesize;
+};
+
+/*The parts of a section_64 the decoders use, both names interned in corpusNames()*/
+struct Section
+{
+	NameId		segmentName;
+	NameId		name;
+	uint64_t	addr;
+	uint64_t	size;
+	uint32_t	offset;
+	uint32_t	reloff;
+	uint32_t	nreloc;
+	uint32_t	flags;
+	uint32_t	reserved1;	/*indirect symbol table index of stub and pointer sections*/
+	uint32_t	reserved2;	/*stub size of S_SYMBOL_STUBS sections*/
+};
+
+/*Everything read from the header and load commands of a single 64-bit image*/
+struct MachImage
+{
+	mach_header_64 header;
+	uint64_t headerOffset = 0;		/*File offset of the mach header, non-zero for the images of a shared cache*/
+	std::deque<Command_Struct> commands;
+	std::vector<Segment> segments;	/*Every LC_SEGMENT_64 in load order, the index fixups and binds refer to*/
+	std::vector<Section> sections;	/*Sections of every LC_SEGMENT_64 in load order, so ordinal N is sections[N - 1]*/
+
+	/*Names interned in corpusNames()*/
+	std::vector<NameId> dylibNames;		/*Install names of the dylibs this image loads, so dylib ordinal N is dylibNames[N - 1]*/
+	NameId installName;					/*LC_ID_DYLIB install name, the empty name for anything but a dylib*/
+};
+
+/*Returns the first load command of the given type, or nullptr if the image has none*/
+template <typename Command>
+const Command* findCommand(const MachImage& image)
+{
+	for (const auto& command : image.commands)
+	{
+		if (const Command* found = std::get_if<Command>(&command))
+		{
+			return found;
+		}
+	}
+
+	return nullptr;
+}
+
+/*linkedit_data_command is shared by several load commands, this picks one out by its cmd value*/
+inline const linkedit_data_command* findLinkeditData(const MachImage& image, uint32_t cmd)
+{
+	for (const auto& command : image.commands)
+	{
+		const auto* linkedit = std::get_if<linkedit_data_command>(&command);
+		if (linkedit && linkedit->cmd == cmd)
+		{
+			return linkedit;
+		}
+	}
+
+	return nullptr;
+}
+
+/*The address the image wants to be loaded at, taken from the segment that maps the mach header.
+Inside a shared cache that segment's file range starts at the image's offset in the cache, not at 0.*/
+inline uint64_t preferredLoadAddress(const MachImage& image)
+{
+	for (const auto& segment : image.segments)
+	{
+		if (image.headerOffset >= segment.fileoff && image.headerOffset - segment.fileoff < segment.filesize)
+		{
+			return segment.vmaddr + (image.headerOffset - segment.fileoff);
+		}
+	}
+
+	return 0;
+}
+
+/*Zero fill sections only exist in memory, their offset and size don't describe file bytes*/
+inline bool isZerofill(const Section& sect)
+{
+	const uint32_t type = sect.flags & SECTION_TYPE;
+	return type == S_ZEROFILL || type == S_GB_ZEROFILL || type == S_THREAD_LOCAL_ZEROFILL;
+}
+
+/*Whether a section's offset and size describe bytes in the file.  Zero fill sections have none, and
+neither do sections at offset 0 or outside their segment's file range, such as the __TEXT and __DATA
+sections a dSYM keeps only for their addresses.*/
+inline bool hasFileContents(const MachImage& image, size_t sectionIndex)
+{
+	const Section& sect = image.sections[sectionIndex];
+	if (isZerofill(sect) || sect.offset == 0)
+	{
+		return false;
+	}
+
+	/*Sections follow their segments in load order, nsects at a time*/
+	size_t firstSection = 0;
+	for (const auto& segment : image.segments)
+	{
+		if (sectionIndex < firstSection + segment.nsects)
+		{
+			return sect.offset >= segment.fileoff && sect.size <= segment.filesize && sect.offset - segment.fileoff <= segment.filesize - sect.size;
+		}
+		firstSection += segment.nsects;
+	}
+
+	return false;
+}
+
+/*Translates a vmaddr to the file offset its segment maps it from, nothing for zero fill or unmapped addresses*/
+inline std::optional<uint64_t> fileOffsetForAddress(const MachImage& image, uint64_t address)
+{
+	for (const auto& segment : image.segments)
+	{
+		if (address >= segment.vmaddr && address - segment.vmaddr < segment.filesize)
+		{
+			return segment.fileoff + (address - segment.vmaddr);
+		}
+	}
+
+	return std::nullopt;
+}
+
+/*segname and sectname are only NUL terminated when shorter than 16 characters*/
+inline std::string_view fixedName(const char (&name)[16])
+{
+	return std::string_view(name, strnlen(name, sizeof(name)));
+}
+
+/*Returns the first section with the given name in any segment, or nullptr*/
+inline const Section* findSection(const MachImage& image, std::string_view sectname)
+{
+	for (const auto& sect : image.sections)
+	{
+		if (corpusNames().name(sect.name) == sectname)
+		{
+			return &sect;
+		}
+	}
+
+	return nullptr;
+}
+
+class SharedStringTables;
+
+struct DecodeOptions
+{
+	size_t streamMemoryLimit = 0;	/*non-zero streams section and fixup data with at most this many bytes resident*/
+	bool serial = false;			/*decode on the calling thread, for callers that already run one image per thread*/
+	SharedStringTables* sharedStrings = nullptr;	/*string tables read once for every image that uses them, as a shared cache's images do*/
+};
+
+Command_Struct determineCommand(std::ifstream& fin, uint32_t commandType);
+/*Decodes the image whose mach header is at the stream's current position*/
+MachImage decodeImage(std::ifstream& fin);
+
+/*Writes everything decoded about image, inputFileName is the file it was decoded from*/
+void writeImage(std::ifstream& fin, std::ostream& fout, const std::string& inputFileName, const MachImage& image, const DecodeOptions& options);
+void decodeFile(const std::string& inputFileName, const std::string& outputFileName, const DecodeOptions& options = DecodeOptions());
@@ -0,0 +1,1177 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <list>
+#include <sstream>
+#include <stdexcept>
+#include "Arena.h"
+#include "DwarfLines.h"
+#include "Reader.h"
+#include "dwarf.h"
+
+namespace
+{
+	const uint64_t DieReadSize = 4096;
+	const uint64_t AbbrevReadSize = 1 << 16;
+	const size_t StringChunkSize = 256;
+	const size_t MaximumStringLength = 4096;
+	const size_t MaximumCachedIndexes = 8;
+
+	/*Bounds checked little endian reads over a byte range, past the end every read yields 0 and marks the cursor failed*/
+	class DwarfCursor
+	{
+	public:
+		DwarfCursor(const uint8_t* begin, const uint8_t* end) : begin(begin), cursor(begin), end(end) {}
+
+		bool failed() const { return overrun; }
+		bool atEnd() const { return cursor >= end; }
+		uint64_t position() const { return static_cast<uint64_t>(cursor - begin); }
+		uint64_t remaining() const { return static_cast<uint64_t>(end - cursor); }
+		const uint8_t* here() const { return cursor; }
+
+		uint64_t fixed(size_t size)
+		{
+			if (remaining() < size || size > sizeof(uint64_t))
+			{
+				overrun = true;
+				cursor = end;
+				return 0;
+			}
+
+			uint64_t value = 0;
+			memcpy(&value, cursor, size);
+			cursor += size;
+			return value;
+		}
+
+		uint8_t u8() { return static_cast<uint8_t>(fixed(1)); }
+		uint16_t u16() { return static_cast<uint16_t>(fixed(2)); }
+		uint32_t u32() { return static_cast<uint32_t>(fixed(4)); }
+		uint64_t u64() { return fixed(8); }
+		uint64_t offset(bool is64) { return fixed(is64 ? 8 : 4); }
+
+		uint64_t uleb()
+		{
+			const uint8_t* start = cursor;
+			const uint64_t value = readUleb128(cursor, end);
+			overrun |= cursor == start || (cursor[-1] & 0x80);
+			return value;
+		}
+
+		int64_t sleb()
+		{
+			int64_t result = 0;
+			unsigned shift = 0;
+			uint8_t byte = 0x80;
+
+			while ((byte & 0x80) && cursor < end)
+			{
+				byte = *cursor++;
+				if (shift < 64)
+				{
+					result |= int64_t(byte & 0x7f) << shift;
+				}
+				shift += 7;
+			}
+
+			overrun |= (byte & 0x80) != 0;
+			if (shift < 64 && (byte & 0x40))
+			{
+				result |= -(int64_t(1) << shift);
+			}
+			return result;
+		}
+
+		std::string_view cstring()
+		{
+			const size_t length = strnlen(reinterpret_cast<const char*>(cursor), static_cast<size_t>(remaining()));
+			std::string_view text(reinterpret_cast<const char*>(cursor), length);
+			skip(length + 1);
+			return text;
+		}
+
+		void skip(uint64_t size)
+		{
+			if (remaining() < size)
+			{
+				overrun = true;
+				cursor = end;
+				return;
+			}
+			cursor += size;
+		}
+
+	private:
+		const uint8_t*	begin;
+		const uint8_t*	cursor;
+		const uint8_t*	end;
+		bool			overrun = false;
+	};
+
+	/*What a form decoded to, strings and addresses that live in another section are left as offsets or indexes*/
+	struct FormValue
+	{
+		enum class Kind { None, Constant, Address, AddressIndex, String, StrOffset, StrIndex, LineStrOffset } kind = Kind::None;
+		uint64_t			value = 0;
+		std::string_view	text;
+	};
+
+	struct UnitShape
+	{
+		uint16_t	version;
+		uint8_t		addressSize;
+		bool		is64;
+	};
+
+	/*Reads any form, those this index has no use for are skipped*/
+	FormValue readForm(DwarfCursor& cursor, uint64_t form, const UnitShape& unit, int64_t implicitConst)
+	{
+		FormValue result;
+
+		switch (form)
+		{
+		case DW_FORM_addr:
+			result.kind = FormValue::Kind::Address;
+			result.value = cursor.fixed(unit.addressSize);
+			break;
+
+		case DW_FORM_data1:
+		case DW_FORM_ref1:
+		case DW_FORM_flag:
+			result.kind = FormValue::Kind::Constant;
+			result.value = cursor.u8();
+			break;
+
+		case DW_FORM_data2:
+		case DW_FORM_ref2:
+			result.kind = FormValue::Kind::Constant;
+			result.value = cursor.u16();
+			break;
+
+		case DW_FORM_data4:
+		case DW_FORM_ref4:
+		case DW_FORM_ref_sup4:
+			result.kind = FormValue::Kind::Constant;
+			result.value = cursor.u32();
+			break;
+
+		case DW_FORM_data8:
+		case DW_FORM_ref8:
+		case DW_FORM_ref_sig8:
+		case DW_FORM_ref_sup8:
+			result.kind = FormValue::Kind::Constant;
+			result.value = cursor.u64();
+			break;
+
+		case DW_FORM_data16:
+			cursor.skip(16);
+			break;
+
+		case DW_FORM_sdata:
+			result.kind = FormValue::Kind::Constant;
+			result.value = static_cast<uint64_t>(cursor.sleb());
+			break;
+
+		case DW_FORM_udata:
+		case DW_FORM_ref_udata:
+			result.kind = FormValue::Kind::Constant;
+			result.value = cursor.uleb();
+			break;
+
+		case DW_FORM_implicit_const:
+			result.kind = FormValue::Kind::Constant;
+			result.value = static_cast<uint64_t>(implicitConst);
+			break;
+
+		case DW_FORM_string:
+			result.kind = FormValue::Kind::String;
+			result.text = cursor.cstring();
+			break;
+
+		case DW_FORM_strp:
+			result.kind = FormValue::Kind::StrOffset;
+			result.value = cursor.offset(unit.is64);
+			break;
+
+		case DW_FORM_line_strp:
+			result.kind = FormValue::Kind::LineStrOffset;
+			result.value = cursor.offset(unit.is64);
+			break;
+
+		case DW_FORM_sec_offset:
+			result.kind = FormValue::Kind::Constant;
+			result.value = cursor.offset(unit.is64);
+			break;
+
+		case DW_FORM_strp_sup:
+			cursor.offset(unit.is64);
+			break;
+
+		case DW_FORM_ref_addr:
+			cursor.skip(unit.version <= 2 ? unit.addressSize : (unit.is64 ? 8 : 4));
+			break;
+
+		case DW_FORM_block1:
+			cursor.skip(cursor.u8());
+			break;
+
+		case DW_FORM_block2:
+			cursor.skip(cursor.u16());
+			break;
+
+		case DW_FORM_block4:
+			cursor.skip(cursor.u32());
+			break;
+
+		case DW_FORM_block:
+		case DW_FORM_exprloc:
+			cursor.skip(cursor.uleb());
+			break;
+
+		case DW_FORM_flag_present:
+			result.kind = FormValue::Kind::Constant;
+			result.value = 1;
+			break;
+
+		/*Indexes into __debug_str_offs and __debug_addr, resolved once the unit's bases are known*/
+		case DW_FORM_strx:
+			result.kind = FormValue::Kind::StrIndex;
+			result.value = cursor.uleb();
+			break;
+
+		case DW_FORM_strx1:
+		case DW_FORM_strx2:
+		case DW_FORM_strx3:
+		case DW_FORM_strx4:
+			result.kind = FormValue::Kind::StrIndex;
+			result.value = cursor.fixed(form - DW_FORM_strx1 + 1);
+			break;
+
+		case DW_FORM_addrx:
+			result.kind = FormValue::Kind::AddressIndex;
+			result.value = cursor.uleb();
+			break;
+
+		case DW_FORM_addrx1:
+		case DW_FORM_addrx2:
+		case DW_FORM_addrx3:
+		case DW_FORM_addrx4:
+			result.kind = FormValue::Kind::AddressIndex;
+			result.value = cursor.fixed(form - DW_FORM_addrx1 + 1);
+			break;
+
+		case DW_FORM_loclistx:
+		case DW_FORM_rnglistx:
+			cursor.uleb();
+			break;
+
+		case DW_FORM_indirect:
+			return readForm(cursor, cursor.uleb(), unit, implicitConst);
+
+		default:
+			/*An unknown form has an unknown size, nothing after it can be trusted*/
+			cursor.skip(cursor.remaining() + 1);
+			break;
+		}
+
+		return result;
+	}
+
+	/*Reads size bytes at offset within sect, clipped to the section*/
+	ArenaVector<uint8_t> readSectionBytes(std::ifstream& fin, const Section& sect, uint64_t offset, uint64_t size, Arena& scratch)
+	{
+		ArenaAllocator<uint8_t> allocator(scratch);
+		if (offset >= sect.size)
+		{
+			return ArenaVector<uint8_t>(allocator);
+		}
+
+		return readArrayAt<uint8_t>(fin, sect.offset + offset, static_cast<size_t>(std::min(size, sect.size - offset)), allocator);
+	}
+
+	/*The string at offset within sect, valid until scratch is reset*/
+	std::string_view readSectionString(std::ifstream& fin, const Section& sect, uint64_t offset, Arena& scratch)
+	{
+		ArenaVector<char> text{ ArenaAllocator<char>(scratch) };
+		while (text.size() < MaximumStringLength)
+		{
+			auto chunk = readSectionBytes(fin, sect, offset + text.size(), StringChunkSize, scratch);
+			const size_t length = strnlen(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+			text.insert(text.end(), chunk.begin(), chunk.begin() + length);
+
+			if (length < StringChunkSize)
+			{
+				break;
+			}
+		}
+
+		return scratch.copy(std::string_view(text.data(), text.size()));
+	}
+
+	/*Reads a size byte little endian value at offset within sect, nothing when it runs past the section*/
+	std::optional<uint64_t> readSectionValue(std::ifstream& fin, const Section& sect, uint64_t offset, size_t size, Arena& scratch)
+	{
+		auto bytes = readSectionBytes(fin, sect, offset, size, scratch);
+		DwarfCursor cursor(bytes.data(), bytes.data() + bytes.size());
+		const uint64_t value = cursor.fixed(size);
+
+		return cursor.failed() ? std::nullopt : std::optional<uint64_t>(value);
+	}
+
+	/*Where one unit's string forms lead, strx indexes go through its contribution to __debug_str_offs*/
+	struct StringSources
+	{
+		const Section&	debugStr;
+		const Section&	debugLineStr;
+		const Section&	debugStrOffsets;
+		uint64_t		strOffsetsBase;
+		bool			is64;
+	};
+
+	std::string_view formString(std::ifstream& fin, const FormValue& value, const StringSources& sources, Arena& scratch)
+	{
+		switch (value.kind)
+		{
+		case FormValue::Kind::String:
+			return value.text;
+
+		case FormValue::Kind::StrOffset:
+			return readSectionString(fin, sources.debugStr, value.value, scratch);
+
+		case FormValue::Kind::LineStrOffset:
+			return readSectionString(fin, sources.debugLineStr, value.value, scratch);
+
+		case FormValue::Kind::StrIndex:
+		{
+			const size_t entrySize = sources.is64 ? 8 : 4;
+			const std::optional<uint64_t> offset = readSectionValue(fin, sources.debugStrOffsets, sources.strOffsetsBase + value.value * entrySize, entrySize, scratch);
+			return offset ? readSectionString(fin, sources.debugStr, *offset, scratch) : std::string_view();
+		}
+
+		default:
+			return std::string_view();
+		}
+	}
+
+	/*Joins a file name onto its directory, relative directories are taken from the unit's compilation directory*/
+	NameId joinPath(StringInterner& names, std::string_view compDir, std::string_view directory, std::string_view name)
+	{
+		if (!name.empty() && name.front() == '/')
+		{
+			return names.intern(name);
+		}
+
+		std::string path;
+		if (!directory.empty() && directory.front() != '/' && !compDir.empty())
+		{
+			path.append(compDir).append("/");
+		}
+		if (directory.empty() && !compDir.empty())
+		{
+			path.append(compDir).append("/");
+		}
+		if (!directory.empty())
+		{
+			path.append(directory).append("/");
+		}
+		path.append(name);
+
+		return names.intern(path);
+	}
+
+	struct AttributeSpec
+	{
+		uint64_t	attribute;
+		uint64_t	form;
+		int64_t		implicitConst;
+	};
+
+	/*Finds code in the abbreviation table at offset, reading more of the table if it isn't in the first window*/
+	bool findAbbreviation(std::ifstream& fin, const Section& debugAbbrev, uint64_t offset, uint64_t code, uint64_t& tag, std::vector<AttributeSpec>& attributes, Arena& scratch)
+	{
+		for (uint64_t window = AbbrevReadSize;; window *= 4)
+		{
+			auto bytes = readSectionBytes(fin, debugAbbrev, offset, window, scratch);
+			DwarfCursor cursor(bytes.data(), bytes.data() + bytes.size());
+
+			while (!cursor.failed())
+			{
+				const uint64_t entryCode = cursor.uleb();
+				if (entryCode == 0)
+				{
+					return false;
+				}
+
+				tag = cursor.uleb();
+				cursor.u8();	/*children*/
+
+				attributes.clear();
+				for (;;)
+				{
+					const uint64_t attribute = cursor.uleb();
+					const uint64_t form = cursor.uleb();
+					if ((attribute == 0 && form == 0) || cursor.failed())
+					{
+						break;
+					}
+					attributes.push_back({ attribute, form, form == DW_FORM_implicit_const ? cursor.sleb() : 0 });
+				}
+
+				if (entryCode == code && !cursor.failed())
+				{
+					return true;
+				}
+			}
+
+			if (bytes.size() < window)
+			{
+				return false;	/*ran off the end of the section*/
+			}
+		}
+	}
+
+	/*State machine registers of a line program*/
+	struct LineState
+	{
+		uint64_t	address = 0;
+		uint64_t	opIndex = 0;
+		uint64_t	file = 1;
+		int64_t		line = 1;
+	};
+
+	std::vector<LineRow> compileLineProgram(std::ifstream& fin, const Section& debugLine, const StringSources& sources,
+		const DwarfLineIndex::Unit& unit, StringInterner& names, Arena& scratch)
+	{
+		std::vector<LineRow> rows;
+
+		auto lengthBytes = readSectionBytes(fin, debugLine, unit.lineOffset, 12, scratch);
+		DwarfCursor lengthCursor(lengthBytes.data(), lengthBytes.data() + lengthBytes.size());
+		uint64_t unitLength = lengthCursor.u32();
+		const bool is64 = unitLength == 0xffffffff;
+		if (is64)
+		{
+			unitLength = lengthCursor.u64();
+		}
+		if (lengthCursor.failed())
+		{
+			return rows;
+		}
+
+		auto program = readSectionBytes(fin, debugLine, unit.lineOffset + lengthCursor.position(), unitLength, scratch);
+		DwarfCursor cursor(program.data(), program.data() + program.size());
+
+		const uint16_t version = cursor.u16();
+		UnitShape shape = { version, unit.addressSize, is64 };
+		if (version >= 5)
+		{
+			shape.addressSize = cursor.u8();
+			cursor.u8();	/*segment selector size*/
+		}
+
+		const uint64_t headerLength = cursor.offset(is64);
+		const uint64_t programStart = cursor.position() + headerLength;
+		const uint8_t minimumInstructionLength = cursor.u8();
+		const uint8_t maximumOperations = version >= 4 ? std::max<uint8_t>(1, cursor.u8()) : 1;
+		const bool defaultIsStmt = cursor.u8() != 0;
+		const int8_t lineBase = static_cast<int8_t>(cursor.u8());
+		const uint8_t lineRange = cursor.u8();
+		const uint8_t opcodeBase = cursor.u8();
+		(void)defaultIsStmt;
+
+		std::vector<uint8_t> standardLengths(opcodeBase ? opcodeBase - 1 : 0);
+		for (auto& length : standardLengths)
+		{
+			length = cursor.u8();
+		}
+
+		const std::string_view compDir = names.name(unit.compDir);
+		std::vector<std::string_view> directories;
+		std::vector<NameId> files;
+
+		if (version >= 5)
+		{
+			/*Directory and file entries are described by their own (content type, form) lists*/
+			auto readEntries = [&](bool isFiles)
+			{
+				std::vector<std::pair<uint64_t, uint64_t>> format(cursor.u8());
+				for (auto& field : format)
+				{
+					field.first = cursor.uleb();
+					field.second = cursor.uleb();
+				}
+
+				const uint64_t count = cursor.uleb();
+				for (uint64_t idx = 0; idx < count && !cursor.failed(); ++idx)
+				{
+					std::string_view path;
+					uint64_t directory = 0;
+					for (const auto& field : format)
+					{
+						const FormValue value = readForm(cursor, field.second, shape, 0);
+						if (field.first == DW_LNCT_path)
+						{
+							path = formString(fin, value, sources, scratch);
+						}
+						else if (field.first == DW_LNCT_directory_index)
+						{
+							directory = value.value;
+						}
+					}
+
+					if (isFiles)
+					{
+						files.push_back(joinPath(names, compDir, directory < directories.size() ? directories[directory] : std::string_view(), path));
+					}
+					else
+					{
+						directories.push_back(path);
+					}
+				}
+			};
+
+			readEntries(false);
+			readEntries(true);
+		}
+		else
+		{
+			/*Directory 0 and file 0 are implicit before DWARF 5, the lists start at 1*/
+			directories.push_back(std::string_view());
+			for (std::string_view directory = cursor.cstring(); !directory.empty() && !cursor.failed(); directory = cursor.cstring())
+			{
+				directories.push_back(directory);
+			}
+
+			files.push_back(names.intern(std::string_view()));
+			for (std::string_view name = cursor.cstring(); !name.empty() && !cursor.failed(); name = cursor.cstring())
+			{
+				const uint64_t directory = cursor.uleb();
+				cursor.uleb();	/*modification time*/
+				cursor.uleb();	/*length*/
+				files.push_back(joinPath(names, compDir, directory < directories.size() ? directories[directory] : std::string_view(), name));
+			}
+		}
+
+		if (cursor.failed() || lineRange == 0 || programStart > program.size())
+		{
+			return rows;
+		}
+
+		const NameId noFile = names.intern(std::string_view());
+		auto fileName = [&](uint64_t file) { return file < files.size() ? files[file] : noFile; };
+
+		/*Consecutive rows with the same file and line cover one range, only the first is kept*/
+		auto emit = [&](const LineState& state, bool endSequence)
+		{
+			const uint32_t line = endSequence ? 0 : static_cast<uint32_t>(std::max<int64_t>(state.line, 1));
+			const NameId file = endSequence ? noFile : fileName(state.file);
+			if (!endSequence && !rows.empty() && rows.back().line == line && rows.back().file == file && rows.back().address <= state.address)
+			{
+				return;
+			}
+			rows.push_back({ state.address, file, line });
+		};
+
+		auto advance = [&](LineState& state, uint64_t operationAdvance)
+		{
+			state.address += minimumInstructionLength * ((state.opIndex + operationAdvance) / maximumOperations);
+			state.opIndex = (state.opIndex + operationAdvance) % maximumOperations;
+		};
+
+		DwarfCursor opcodes(program.data() + programStart, program.data() + program.size());
+		LineState state;
+
+		while (!opcodes.atEnd() && !opcodes.failed())
+		{
+			const uint8_t opcode = opcodes.u8();
+
+			if (opcode >= opcodeBase)
+			{
+				const uint8_t adjusted = opcode - opcodeBase;
+				advance(state, adjusted / lineRange);
+				state.line += lineBase + (adjusted % lineRange);
+				emit(state, false);
+				continue;
+			}
+
+			switch (opcode)
+			{
+			case 0:
+			{
+				const uint64_t length = opcodes.uleb();
+				if (length == 0 || length > opcodes.remaining())
+				{
+					opcodes.skip(opcodes.remaining() + 1);
+					break;
+				}
+
+				DwarfCursor extended(opcodes.here(), opcodes.here() + length);
+				opcodes.skip(length);
+
+				switch (extended.u8())
+				{
+				case DW_LNE_end_sequence:
+					emit(state, true);
+					state = LineState();
+					break;
+
+				case DW_LNE_set_address:
+					state.address = extended.fixed(static_cast<size_t>(std::min<uint64_t>(length - 1, 8)));
+					state.opIndex = 0;
+					break;
+
+				case DW_LNE_define_file:
+				{
+					const std::string_view name = extended.cstring();
+					const uint64_t directory = extended.uleb();
+					files.push_back(joinPath(names, compDir, directory < directories.size() ? directories[directory] : std::string_view(), name));
+					break;
+				}
+
+				default:
+					break;
+				}
+				break;
+			}
+
+			case DW_LNS_copy:
+				emit(state, false);
+				break;
+
+			case DW_LNS_advance_pc:
+				advance(state, opcodes.uleb());
+				break;
+
+			case DW_LNS_advance_line:
+				state.line += opcodes.sleb();
+				break;
+
+			case DW_LNS_set_file:
+				state.file = opcodes.uleb();
+				break;
+
+			case DW_LNS_const_add_pc:
+				advance(state, (255 - opcodeBase) / lineRange);
+				break;
+
+			case DW_LNS_fixed_advance_pc:
+				state.address += opcodes.u16();
+				state.opIndex = 0;
+				break;
+
+			default:
+				/*Standard opcodes this index doesn't use, and any the header declares that we don't know*/
+				for (uint8_t operand = 0; operand < standardLengths[opcode - 1]; ++operand)
+				{
+					opcodes.uleb();
+				}
+				break;
+			}
+		}
+
+		/*Sequences can appear in any order, at equal addresses an end of sequence sorts before the next start*/
+		std::stable_sort(rows.begin(), rows.end(), [](const LineRow& lhs, const LineRow& rhs)
+		{
+			return lhs.address < rhs.address || (lhs.address == rhs.address && lhs.line == 0 && rhs.line != 0);
+		});
+
+		return rows;
+	}
+
+	Section dwarfSection(const MachImage& image, std::string_view sectname)
+	{
+		for (const auto& sect : image.sections)
+		{
+			if (corpusNames().name(sect.segmentName) == "__DWARF" && corpusNames().name(sect.name) == sectname)
+			{
+				return sect;
+			}
+		}
+
+		return Section{};
+	}
+
+	/*A whole token of hex digits with an optional 0x prefix, anything else is not an address*/
+	std::optional<uint64_t> parseHexAddress(std::string_view token)
+	{
+		if (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X'))
+		{
+			token.remove_prefix(2);
+		}
+
+		uint64_t address = 0;
+		const auto parsed = std::from_chars(token.data(), token.data() + token.size(), address, 16);
+		if (token.empty() || parsed.ec != std::errc() || parsed.ptr != token.data() + token.size())
+		{
+			return std::nullopt;
+		}
+
+		return address;
+	}
+}
+
+DwarfLineIndex::DwarfLineIndex(const std::string& fileName, const MachImage& image)
+	: fileName(fileName),
+	  debugInfo(dwarfSection(image, "__debug_info")),
+	  debugAbbrev(dwarfSection(image, "__debug_abbrev")),
+	  debugLine(dwarfSection(image, "__debug_line")),
+	  debugStr(dwarfSection(image, "__debug_str")),
+	  debugLineStr(dwarfSection(image, "__debug_line_str")),
+	  debugStrOffsets(dwarfSection(image, "__debug_str_offs")),	/*__debug_str_offsets cut to 16 characters*/
+	  debugAddr(dwarfSection(image, "__debug_addr")),
+	  noName(names.intern(std::string_view()))
+{
+	std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+
+	/*A scratch arena of its own, the index may be built while the caller still has data in workerArena()*/
+	Arena scratch(1 << 16);
+
+	struct PcRange
+	{
+		uint64_t	low;
+		uint64_t	high;
+		bool		known;
+	};
+	std::vector<PcRange> pcRanges;
+
+	/*Only unit headers and root DIEs are read here, the rest of __debug_info is never touched*/
+	uint64_t next = 0;
+	while (next < debugInfo.size)
+	{
+		scratch.reset();
+		auto header = readSectionBytes(fin, debugInfo, next, 32, scratch);
+		DwarfCursor cursor(header.data(), header.data() + header.size());
+
+		uint64_t unitLength = cursor.u32();
+		const bool is64 = unitLength == 0xffffffff;
+		if (is64)
+		{
+			unitLength = cursor.u64();
+		}
+		const uint64_t unitEnd = next + cursor.position() + unitLength;
+
+		Unit unit = { next, cursor.u16(), 0, is64, 0, false, 0, noName, noName };
+		uint64_t abbrevOffset = 0;
+		bool isCompileUnit = true;
+
+		if (unit.version >= 5)
+		{
+			const uint8_t unitType = cursor.u8();
+			unit.addressSize = cursor.u8();
+			abbrevOffset = cursor.offset(is64);
+
+			if (unitType == DW_UT_skeleton || unitType == DW_UT_split_compile)
+			{
+				cursor.u64();	/*dwo id*/
+			}
+			isCompileUnit = unitType == DW_UT_compile || unitType == DW_UT_partial || unitType == DW_UT_skeleton;
+		}
+		else
+		{
+			abbrevOffset = cursor.offset(is64);
+			unit.addressSize = cursor.u8();
+		}
+
+		if (cursor.failed() || unitLength == 0 || unitEnd > debugInfo.size)
+		{
+			break;
+		}
+		next = unitEnd;
+
+		if (!isCompileUnit || unit.version < 2 || unit.version > 5)
+		{
+			continue;
+		}
+
+		const uint64_t dieOffset = unit.offset + cursor.position();
+		auto die = readSectionBytes(fin, debugInfo, dieOffset, std::min(DieReadSize, unitEnd - dieOffset), scratch);
+		DwarfCursor dieCursor(die.data(), die.data() + die.size());
+
+		uint64_t tag = 0;
+		std::vector<AttributeSpec> attributes;
+		if (!findAbbreviation(fin, debugAbbrev, abbrevOffset, dieCursor.uleb(), tag, attributes, scratch)
+			|| (tag != DW_TAG_compile_unit && tag != DW_TAG_partial_unit && tag != DW_TAG_skeleton_unit))
+		{
+			continue;
+		}
+
+		const UnitShape shape = { unit.version, unit.addressSize, unit.is64 };
+		FormValue name;
+		FormValue compDir;
+		FormValue low;
+		FormValue high;
+
+		/*Without the base attributes a unit's contributions start right after the first header of
+		__debug_str_offs and __debug_addr, which is all a single unit dSYM has*/
+		unit.strOffsetsBase = is64 ? 16 : 8;
+		uint64_t addrBase = 8;
+
+		/*Strings and addresses are resolved after the loop, the base attributes may follow them in the DIE*/
+		for (const auto& spec : attributes)
+		{
+			const FormValue value = readForm(dieCursor, spec.form, shape, spec.implicitConst);
+			if (dieCursor.failed())
+			{
+				break;
+			}
+
+			switch (spec.attribute)
+			{
+			case DW_AT_stmt_list:
+				unit.lineOffset = value.value;
+				unit.hasLines = value.kind == FormValue::Kind::Constant;
+				break;
+
+			case DW_AT_name:
+				name = value;
+				break;
+
+			case DW_AT_comp_dir:
+				compDir = value;
+				break;
+
+			case DW_AT_low_pc:
+				low = value;
+				break;
+
+			case DW_AT_high_pc:
+				high = value;
+				break;
+
+			case DW_AT_str_offsets_base:
+				unit.strOffsetsBase = value.value;
+				break;
+
+			case DW_AT_addr_base:
+				addrBase = value.value;
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		const StringSources sources = { debugStr, debugLineStr, debugStrOffsets, unit.strOffsetsBase, unit.is64 };
+		unit.name = names.intern(formString(fin, name, sources, scratch));
+		unit.compDir = names.intern(formString(fin, compDir, sources, scratch));
+
+		auto address = [&](const FormValue& value) -> std::optional<uint64_t>
+		{
+			if (value.kind == FormValue::Kind::Address)
+			{
+				return value.value;
+			}
+			if (value.kind == FormValue::Kind::AddressIndex && unit.addressSize <= 8)
+			{
+				return readSectionValue(fin, debugAddr, addrBase + value.value * unit.addressSize, unit.addressSize, scratch);
+			}
+			return std::nullopt;
+		};
+
+		/*DW_AT_high_pc is an address, or a constant offset from DW_AT_low_pc*/
+		const bool highIsOffset = high.kind == FormValue::Kind::Constant;
+		const std::optional<uint64_t> lowAddress = address(low);
+		const std::optional<uint64_t> highAddress = highIsOffset ? std::optional<uint64_t>(high.value) : address(high);
+		PcRange pcRange = { lowAddress.value_or(0), highAddress.value_or(0), false };
+
+		if (lowAddress && highAddress)
+		{
+			pcRange.high += highIsOffset ? pcRange.low : 0;
+			pcRange.known = pcRange.high > pcRange.low;
+		}
+
+		units.push_back(unit);
+		pcRanges.push_back(pcRange);
+	}
+
+	/*__debug_aranges describes discontiguous units exactly, the root DIE's range covers the rest*/
+	std::vector<uint8_t> covered(units.size(), 0);
+	const Section debugAranges = dwarfSection(image, "__debug_aranges");
+	if (debugAranges.size != 0)
+	{
+		scratch.reset();
+		auto aranges = readSectionBytes(fin, debugAranges, 0, debugAranges.size, scratch);
+		DwarfCursor cursor(aranges.data(), aranges.data() + aranges.size());
+
+		while (!cursor.atEnd() && !cursor.failed())
+		{
+			const uint64_t setStart = cursor.position();
+			uint64_t setLength = cursor.u32();
+			const bool is64 = setLength == 0xffffffff;
+			if (is64)
+			{
+				setLength = cursor.u64();
+			}
+			const uint64_t setEnd = cursor.position() + setLength;
+
+			cursor.u16();	/*version*/
+			const uint64_t infoOffset = cursor.offset(is64);
+			const uint8_t addressSize = cursor.u8();
+			cursor.u8();	/*segment selector size*/
+
+			/*Tuples are aligned to twice the address size from the start of the set*/
+			const uint64_t tupleSize = 2 * uint64_t(addressSize);
+			if (tupleSize == 0 || addressSize > 8 || setEnd > aranges.size() || cursor.failed())
+			{
+				break;
+			}
+			cursor.skip((tupleSize - (cursor.position() - setStart) % tupleSize) % tupleSize);
+
+			auto unit = std::lower_bound(units.begin(), units.end(), infoOffset, [](const Unit& candidate, uint64_t offset) { return candidate.offset < offset; });
+			const bool known = unit != units.end() && unit->offset == infoOffset && unit->hasLines;
+
+			while (cursor.position() + tupleSize <= setEnd)
+			{
+				const uint64_t address = cursor.fixed(addressSize);
+				const uint64_t length = cursor.fixed(addressSize);
+				if (address == 0 && length == 0)
+				{
+					break;
+				}
+				if (known && length != 0)
+				{
+					ranges.push_back({ address, address + length, static_cast<uint32_t>(unit - units.begin()) });
+					covered[unit - units.begin()] = 1;
+				}
+			}
+
+			cursor.skip(setEnd - std::min(setEnd, cursor.position()));
+		}
+	}
+
+	for (size_t idx = 0; idx < units.size(); ++idx)
+	{
+		if (!units[idx].hasLines || covered[idx])
+		{
+			continue;
+		}
+
+		if (pcRanges[idx].known)
+		{
+			ranges.push_back({ pcRanges[idx].low, pcRanges[idx].high, static_cast<uint32_t>(idx) });
+		}
+		else
+		{
+			unranged.push_back(static_cast<uint32_t>(idx));	/*DW_AT_ranges units, their lines are compiled on the first miss*/
+		}
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const UnitRange& lhs, const UnitRange& rhs) { return lhs.low < rhs.low; });
+
+	compiled.reset(new std::once_flag[units.size()]);
+	tables.resize(units.size());
+}
+
+const std::vector<LineRow>& DwarfLineIndex::unitRows(size_t unit) const
+{
+	std::call_once(compiled[unit], [&]()
+	{
+		std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+		Arena scratch(1 << 16);
+		const StringSources sources = { debugStr, debugLineStr, debugStrOffsets, units[unit].strOffsetsBase, units[unit].is64 };
+		tables[unit] = compileLineProgram(fin, debugLine, sources, units[unit], names, scratch);
+	});
+
+	return tables[unit];
+}
+
+const std::vector<LineRow>& DwarfLineIndex::unrangedRows() const
+{
+	std::call_once(unrangedCompiled, [&]()
+	{
+		for (uint32_t unit : unranged)
+		{
+			const std::vector<LineRow>& rows = unitRows(unit);
+			unrangedTable.insert(unrangedTable.end(), rows.begin(), rows.end());
+		}
+
+		std::stable_sort(unrangedTable.begin(), unrangedTable.end(), [](const LineRow& lhs, const LineRow& rhs)
+		{
+			return lhs.address < rhs.address || (lhs.address == rhs.address && lhs.line == 0 && rhs.line != 0);
+		});
+	});
+
+	return unrangedTable;
+}
+
+LineInfo DwarfLineIndex::find(const std::vector<LineRow>& table, uint64_t address) const
+{
+	auto row = std::upper_bound(table.begin(), table.end(), address, [](uint64_t value, const LineRow& candidate) { return value < candidate.address; });
+	if (row == table.begin())
+	{
+		return { noName, 0 };
+	}
+
+	--row;
+	return { row->file, row->line };
+}
+
+LineInfo DwarfLineIndex::lookup(uint64_t address) const
+{
+	auto range = std::upper_bound(ranges.begin(), ranges.end(), address, [](uint64_t value, const UnitRange& candidate) { return value < candidate.low; });
+	if (range != ranges.begin() && address < (range - 1)->high)
+	{
+		const LineInfo found = find(unitRows((range - 1)->unit), address);
+		if (found.line != 0)
+		{
+			return found;
+		}
+	}
+
+	if (unranged.empty())
+	{
+		return { noName, 0 };
+	}
+
+	return find(unrangedRows(), address);
+}
+
+void DwarfLineIndex::lookup(const uint64_t* addresses, size_t count, LineInfo* results) const
+{
+	for (size_t idx = 0; idx < count; ++idx)
+	{
+		results[idx] = lookup(addresses[idx]);
+	}
+}
+
+std::vector<LineRow> DwarfLineIndex::rows() const
+{
+	std::vector<LineRow> merged;
+	for (size_t unit = 0; unit < units.size(); ++unit)
+	{
+		if (units[unit].hasLines)
+		{
+			const std::vector<LineRow>& unitTable = unitRows(unit);
+			merged.insert(merged.end(), unitTable.begin(), unitTable.end());
+		}
+	}
+
+	std::stable_sort(merged.begin(), merged.end(), [](const LineRow& lhs, const LineRow& rhs)
+	{
+		return lhs.address < rhs.address || (lhs.address == rhs.address && lhs.line == 0 && rhs.line != 0);
+	});
+
+	return merged;
+}
+
+bool hasDwarf(const MachImage& image)
+{
+	return std::any_of(image.segments.begin(), image.segments.end(), [](const Segment& segment)
+	{
+		return corpusNames().name(segment.name) == "__DWARF";
+	});
+}
+
+std::shared_ptr<const DwarfLineIndex> lineIndexFor(const std::string& fileName, const MachImage& image)
+{
+	typedef std::pair<std::string, std::shared_ptr<const DwarfLineIndex>> Entry;
+	static std::mutex lock;
+	static std::list<Entry> recent;		/*most recently used first*/
+
+	/*Images without an LC_UUID can only be told apart by their file name*/
+	const uuid_command* uuid = findCommand<uuid_command>(image);
+	const std::string key = uuid ? std::string(reinterpret_cast<const char*>(uuid->uuid), sizeof(uuid->uuid)) : "file:" + fileName;
+
+	auto cached = [&key]() -> std::shared_ptr<const DwarfLineIndex>
+	{
+		auto found = std::find_if(recent.begin(), recent.end(), [&key](const Entry& entry) { return entry.first == key; });
+		if (found == recent.end())
+		{
+			return nullptr;
+		}
+
+		recent.splice(recent.begin(), recent, found);
+		return recent.front().second;
+	};
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (std::shared_ptr<const DwarfLineIndex> index = cached())
+		{
+			return index;
+		}
+	}
+
+	/*Built without the lock so lookups in other dSYMs carry on meanwhile.  Two threads may both build
+	the same index, the first to get back keeps its entry and the other's is dropped.*/
+	std::shared_ptr<const DwarfLineIndex> built = std::make_shared<const DwarfLineIndex>(fileName, image);
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (std::shared_ptr<const DwarfLineIndex> index = cached())
+	{
+		return index;
+	}
+
+	/*Evicted indexes stay alive for as long as a caller still holds them*/
+	recent.emplace_front(key, std::move(built));
+	if (recent.size() > MaximumCachedIndexes)
+	{
+		recent.pop_back();
+	}
+
+	return recent.front().second;
+}
+
+void symbolicate(const std::string& imageFileName, const std::string& addressFileName, const std::string& outputFileName)
+{
+	std::ifstream fin(imageFileName.c_str(), std::ifstream::binary);
+	const MachImage image = decodeImage(fin);
+	fin.close();
+
+	if (!hasDwarf(image))
+	{
+		throw std::runtime_error(imageFileName + " has no __DWARF segment, symbolicate needs the image's dSYM");
+	}
+
+	/*Invalid lines keep their place in the output, the lookups are batched over the valid ones*/
+	std::vector<std::string> invalid;
+	std::vector<std::optional<uint64_t>> parsed;
+	std::vector<uint64_t> addresses;
+	std::ifstream addressFile(addressFileName.c_str());
+	for (std::string text; std::getline(addressFile, text);)
+	{
+		const size_t first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos)
+		{
+			continue;
+		}
+
+		const std::string_view token = std::string_view(text).substr(first, text.find_last_not_of(" \t\r") + 1 - first);
+		parsed.push_back(parseHexAddress(token));
+		if (parsed.back())
+		{
+			addresses.push_back(*parsed.back());
+		}
+		else
+		{
+			invalid.emplace_back(token);
+		}
+	}
+
+	const std::shared_ptr<const DwarfLineIndex> index = lineIndexFor(imageFileName, image);
+	std::vector<LineInfo> lines(addresses.size());
+	index->lookup(addresses.data(), addresses.size(), lines.data());
+
+	std::ofstream fout(outputFileName.c_str(), std::ofstream::binary);
+	size_t nextInvalid = 0;
+	size_t idx = 0;
+	for (const auto& address : parsed)
+	{
+		if (!address)
+		{
+			fout << invalid[nextInvalid++] << " : invalid address" << std::endl;
+			continue;
+		}
+
+		fout << "0x" << std::hex << addresses[idx] << std::dec << " : ";
+		if (lines[idx].line != 0)
+		{
+			fout << index->path(lines[idx].file) << ":" << lines[idx].line << std::endl;
+		}
+		else
+		{
+			fout << "?" << std::endl;
+		}
+		++idx;
+	}
+	fout.close();
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Decoder.h"
+#include "StringInterner.h"
+
+/*One row of a compiled line table, the address range up to the next row maps to file:line*/
+struct LineRow
+{
+	uint64_t	address;
+	NameId		file;		/*full path, named by DwarfLineIndex::path()*/
+	uint32_t	line;		/*0 marks the end of a sequence, the addresses after it map to nothing*/
+};
+
+struct LineInfo
+{
+	NameId		file;		/*named by DwarfLineIndex::path()*/
+	uint32_t	line;		/*0 when no line table covers the address*/
+};
+
+/*Address to file:line lookups over the __DWARF segment of a dSYM image.  Construction only walks
+the unit headers and each unit's root DIE.  A unit's line program is compiled into a sorted
+LineRow table the first time an address inside the unit is looked up, after that a lookup is a
+binary search for the unit followed by one inside its table.  Safe to use from many threads.
+Paths are interned in the index's own names rather than corpusNames(), so they go away with it.*/
+class DwarfLineIndex
+{
+public:
+	DwarfLineIndex(const std::string& fileName, const MachImage& image);
+
+	bool empty() const { return units.empty(); }
+	size_t unitCount() const { return units.size(); }
+
+	/*Full path of a LineRow or LineInfo file*/
+	std::string_view path(NameId file) const { return names.name(file); }
+
+	LineInfo lookup(uint64_t address) const;
+	void lookup(const uint64_t* addresses, size_t count, LineInfo* results) const;
+
+	/*Every unit compiled and merged into one table, in address order*/
+	std::vector<LineRow> rows() const;
+
+	struct Unit
+	{
+		uint64_t	offset;		/*of the unit header in __debug_info*/
+		uint16_t	version;
+		uint8_t		addressSize;
+		bool		is64;		/*64-bit DWARF offsets*/
+		uint64_t	lineOffset;	/*DW_AT_stmt_list, only meaningful when hasLines*/
+		bool		hasLines;
+		uint64_t	strOffsetsBase;	/*DW_AT_str_offsets_base, where the unit's strx indexes start in __debug_str_offs*/
+		NameId		name;		/*both named by path()*/
+		NameId		compDir;
+	};
+
+private:
+	struct UnitRange
+	{
+		uint64_t	low;
+		uint64_t	high;
+		uint32_t	unit;
+	};
+
+	const std::vector<LineRow>& unitRows(size_t unit) const;
+	const std::vector<LineRow>& unrangedRows() const;
+	LineInfo find(const std::vector<LineRow>& table, uint64_t address) const;
+
+	std::string				fileName;
+	Section					debugInfo;
+	Section					debugAbbrev;
+	Section					debugLine;
+	Section					debugStr;
+	Section					debugLineStr;
+	Section					debugStrOffsets;
+	Section					debugAddr;
+
+	mutable StringInterner	names;
+	NameId					noName;
+
+	std::vector<Unit>		units;
+	std::vector<UnitRange>	ranges;		/*sorted by low, from __debug_aranges or the root DIE's pc range*/
+	std::vector<uint32_t>	unranged;	/*units with a line program but no known address range*/
+
+	/*Compiled lazily, once each, the once flags make concurrent first lookups safe*/
+	mutable std::unique_ptr<std::once_flag[]>		compiled;
+	mutable std::vector<std::vector<LineRow>>		tables;
+	mutable std::once_flag							unrangedCompiled;
+	mutable std::vector<LineRow>					unrangedTable;
+};
+
+/*Whether image has a __DWARF segment, which only dSYMs carry*/
+bool hasDwarf(const MachImage& image);
+
+/*The index for image, shared by every image with the same LC_UUID so a dSYM is only indexed once while it
+stays among the most recently used few*/
+std::shared_ptr<const DwarfLineIndex> lineIndexFor(const std::string& fileName, const MachImage& image);
+
+/*Reads hex addresses one per line from addressFileName and writes each one's file:line, lines that
+aren't a hex address are reported as invalid rather than stopping the run*/
+void symbolicate(const std::string& imageFileName, const std::string& addressFileName, const std::string& outputFileName);
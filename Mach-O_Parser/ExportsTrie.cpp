@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cstring>
+#include "ExportsTrie.h"
+#include "Arena.h"
+#include "Reader.h"
+
+namespace
+{
+	/*Calls visit(name, terminal, children) for every terminal node in trie order, terminal is the node's
+	payload and children where it ends.  Names live in the worker arena until it is reset.*/
+	template <typename Visitor>
+	void walkExportsTrie(const ArenaVector<uint8_t>& trie, Visitor&& visit)
+	{
+		struct PendingNode
+		{
+			uint64_t			offset;
+			std::string_view	prefix;		/*lives in the worker arena*/
+		};
+
+		Arena& arena = workerArena();
+		ArenaVector<PendingNode> pending(1, PendingNode{ 0, std::string_view() }, ArenaAllocator<PendingNode>(arena));
+		ArenaVector<uint8_t> visited(trie.size(), 0, ArenaAllocator<uint8_t>(arena));
+		const uint8_t* end = trie.data() + trie.size();
+
+		/*Explicit stack rather than recursion, and every node is visited at most once so a
+		malformed trie with cycles can't hang the decoder*/
+		while (!pending.empty())
+		{
+			PendingNode node = pending.back();
+			pending.pop_back();
+
+			if (node.offset >= trie.size() || visited[node.offset])
+			{
+				continue;
+			}
+			visited[node.offset] = 1;
+
+			const uint8_t* cursor = trie.data() + node.offset;
+			const uint64_t terminalSize = readUleb128(cursor, end);
+			if (terminalSize >= uint64_t(end - cursor))
+			{
+				continue;
+			}
+			const uint8_t* children = cursor + terminalSize;
+
+			if (terminalSize != 0)
+			{
+				visit(node.prefix, cursor, children);
+			}
+
+			/*Children are pushed in reverse so they pop in trie order, keeping the output sorted*/
+			cursor = children;
+			const uint8_t childCount = *cursor++;
+			const size_t firstChild = pending.size();
+			for (uint8_t child = 0; child < childCount && cursor < end; ++child)
+			{
+				const size_t edgeLength = strnlen((const char*)cursor, end - cursor);
+				if (edgeLength >= size_t(end - cursor))
+				{
+					break;
+				}
+				char* prefix = static_cast<char*>(arena.allocate(node.prefix.size() + edgeLength, 1));
+				memcpy(prefix, node.prefix.data(), node.prefix.size());
+				memcpy(prefix + node.prefix.size(), cursor, edgeLength);
+				cursor += edgeLength + 1;
+
+				const uint64_t childOffset = readUleb128(cursor, end);
+				pending.push_back({ childOffset, std::string_view(prefix, node.prefix.size() + edgeLength) });
+			}
+			std::reverse(pending.begin() + firstChild, pending.end());
+		}
+	}
+}
+
+std::vector<ExportedSymbol> decodeExportsTrie(const ArenaVector<uint8_t>& trie, uint64_t loadAddress)
+{
+	std::vector<ExportedSymbol> exports;
+	walkExportsTrie(trie, [&](std::string_view name, const uint8_t* cursor, const uint8_t* end)
+	{
+		ExportedSymbol symbol = {};
+		symbol.name = corpusNames().intern(name);
+		symbol.importName = corpusNames().intern(std::string_view());
+		symbol.flags = readUleb128(cursor, end);
+
+		if (symbol.flags & EXPORT_SYMBOL_FLAGS_REEXPORT)
+		{
+			symbol.other = readUleb128(cursor, end);
+			symbol.importName = corpusNames().intern(std::string_view((const char*)cursor, strnlen((const char*)cursor, end - cursor)));
+		}
+		else
+		{
+			const uint64_t offset = readUleb128(cursor, end);
+			const bool isAbsolute = (symbol.flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE;
+			symbol.address = isAbsolute ? offset : loadAddress + offset;
+
+			if (symbol.flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+			{
+				symbol.other = loadAddress + readUleb128(cursor, end);
+			}
+		}
+
+		exports.push_back(std::move(symbol));
+	});
+
+	return exports;
+}
+
+std::vector<std::string_view> exportedNames(const ArenaVector<uint8_t>& trie)
+{
+	std::vector<std::string_view> names;
+	walkExportsTrie(trie, [&names](std::string_view name, const uint8_t*, const uint8_t*) { names.push_back(name); });
+
+	return names;
+}
+
+std::pair<uint64_t, uint64_t> exportsTrieRange(const MachImage& image)
+{
+	if (const linkedit_data_command* exportsTrie = findLinkeditData(image, LC_DYLD_EXPORTS_TRIE))
+	{
+		return { exportsTrie->dataoff, exportsTrie->datasize };
+	}
+	else if (const dyld_info_command* dyldInfo = findCommand<dyld_info_command>(image))
+	{
+		return { dyldInfo->export_off, dyldInfo->export_size };
+	}
+
+	return { 0, 0 };
+}
+
+std::vector<ExportedSymbol> decodeExports(std::ifstream& fin, const MachImage& image)
+{
+	const std::pair<uint64_t, uint64_t> range = exportsTrieRange(image);
+	const auto trie = readArrayAt<uint8_t>(fin, range.first, static_cast<size_t>(range.second), ArenaAllocator<uint8_t>(workerArena()));
+
+	return decodeExportsTrie(trie, preferredLoadAddress(image));
+}
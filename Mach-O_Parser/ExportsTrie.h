@@ -0,0 +1,27 @@
+#pragma once
+#include <fstream>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "Decoder.h"
+
+struct ExportedSymbol
+{
+	NameId		name;
+	uint64_t	flags;			/*EXPORT_SYMBOL_FLAGS_* */
+	uint64_t	address;		/*vmaddr, or the stub address for EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER*/
+	uint64_t	other;			/*dylib ordinal for re-exports, resolver address for stub and resolver exports*/
+	NameId		importName;		/*re-exported name, the empty name when it is the same as name*/
+};
+
+/*Flattens an export trie into one entry per exported symbol*/
+std::vector<ExportedSymbol> decodeExportsTrie(const ArenaVector<uint8_t>& trie, uint64_t loadAddress);
+
+/*Just the exported names in trie order, nothing is interned.  The views live in the worker arena until it is reset.*/
+std::vector<std::string_view> exportedNames(const ArenaVector<uint8_t>& trie);
+
+/*File offset and size of the trie, from LC_DYLD_EXPORTS_TRIE or else LC_DYLD_INFO, both 0 when the image has neither*/
+std::pair<uint64_t, uint64_t> exportsTrieRange(const MachImage& image);
+
+/*Reads the trie from LC_DYLD_EXPORTS_TRIE, or from LC_DYLD_INFO when the image predates it*/
+std::vector<ExportedSymbol> decodeExports(std::ifstream& fin, const MachImage& image);
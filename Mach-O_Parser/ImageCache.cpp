@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "Arena.h"
+#include "ImageCache.h"
+#include "Reader.h"
+
+ImageCache::ImageCache(size_t capacity, const DecodeOptions& options)
+	: capacity(std::max<size_t>(1, capacity)), options(options)
+{
+	/*A decode's own threads wouldn't see the image's NameScope, callers parallelise across images instead*/
+	this->options.serial = true;
+}
+
+/*The entry for fileName if it matches the file on disk, a stale one is dropped.  Called with lock held.*/
+ImageCache::Entries::iterator ImageCache::current(const std::string& fileName, uintmax_t fileSize, std::filesystem::file_time_type modified)
+{
+	auto found = byName.find(fileName);
+	if (found == byName.end())
+	{
+		return entries.end();
+	}
+
+	if ((*found->second)->fileSize == fileSize && (*found->second)->modified == modified)
+	{
+		entries.splice(entries.begin(), entries, found->second);
+		return entries.begin();
+	}
+
+	entries.erase(found->second);
+	byName.erase(found);
+	return entries.end();
+}
+
+std::shared_ptr<CachedImage> ImageCache::acquire(const std::string& fileName)
+{
+	const uintmax_t fileSize = std::filesystem::file_size(fileName);
+	const std::filesystem::file_time_type modified = std::filesystem::last_write_time(fileName);
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto found = current(fileName, fileSize, modified);
+		if (found != entries.end())
+		{
+			++hitCount;
+			return *found;
+		}
+	}
+
+	++missCount;
+
+	std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+	if (readInAndReset<uint32_t>(fin) != MH_MAGIC_64 || !fin)
+	{
+		throw std::runtime_error("not a 64-bit Mach-O image");
+	}
+
+	auto cached = std::make_shared<CachedImage>();
+	cached->fileName = fileName;
+	cached->fileSize = fileSize;
+	cached->modified = modified;
+	{
+		NameScope scope(cached->names);
+		cached->image = decodeImage(fin);
+		workerArena().reset();
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+
+	/*Another thread may have decoded the same file meanwhile, the first one in is kept*/
+	auto found = current(fileName, fileSize, modified);
+	if (found != entries.end())
+	{
+		return *found;
+	}
+
+	entries.push_front(cached);
+	byName[fileName] = entries.begin();
+
+	while (entries.size() > capacity)
+	{
+		byName.erase(entries.back()->fileName);
+		entries.pop_back();
+		++evictionCount;
+	}
+
+	return cached;
+}
+
+std::shared_ptr<CachedImage> ImageCache::find(const std::string& fileName)
+{
+	std::error_code failed;
+	const uintmax_t fileSize = std::filesystem::file_size(fileName, failed);
+	const std::filesystem::file_time_type modified = std::filesystem::last_write_time(fileName, failed);
+	if (failed)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	auto found = current(fileName, fileSize, modified);
+	return found != entries.end() ? *found : nullptr;
+}
+
+size_t ImageCache::size() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return entries.size();
+}
+
+std::string ImageCache::description(CachedImage& cached)
+{
+	std::unique_lock<std::mutex> held(cached.lock);
+	return description(cached, held);
+}
+
+std::string ImageCache::description(CachedImage& cached, const std::unique_lock<std::mutex>&)
+{
+	if (!cached.description)
+	{
+		NameScope scope(cached.names);
+		std::ifstream fin(cached.fileName.c_str(), std::ifstream::binary);
+		std::ostringstream out;
+		writeImage(fin, out, cached.fileName, cached.image, options);
+		cached.description = out.str();
+		workerArena().reset();
+	}
+
+	return *cached.description;
+}
+
+/*Called with cached.lock held and the image's NameScope in place*/
+const SymbolTable& ImageCache::symbols(CachedImage& cached)
+{
+	if (!cached.symbols)
+	{
+		const symtab_command* symtab = findCommand<symtab_command>(cached.image);
+		std::ifstream fin(cached.fileName.c_str(), std::ifstream::binary);
+		cached.symbols = symtab ? SymbolTable(fin, *symtab) : SymbolTable();
+	}
+
+	return *cached.symbols;
+}
+
+std::string ImageCache::stubTarget(CachedImage& cached, uint64_t address)
+{
+	std::unique_lock<std::mutex> held(cached.lock);
+	return stubTarget(cached, address, held);
+}
+
+std::string ImageCache::stubTarget(CachedImage& cached, uint64_t address, const std::unique_lock<std::mutex>&)
+{
+	NameScope scope(cached.names);
+	if (!cached.stubs)
+	{
+		const SymbolTable& table = symbols(cached);
+		std::ifstream fin(cached.fileName.c_str(), std::ifstream::binary);
+		cached.stubs.emplace(fin, cached.image, table);
+		workerArena().reset();
+	}
+
+	const StubTarget* target = cached.stubs->lookup(address);
+	return target ? std::string(corpusNames().name(target->symbol)) : std::string();
+}
+
+std::optional<uint64_t> ImageCache::findExport(CachedImage& cached, std::string_view name)
+{
+	std::unique_lock<std::mutex> held(cached.lock);
+	return findExport(cached, name, held);
+}
+
+std::optional<uint64_t> ImageCache::findExport(CachedImage& cached, std::string_view name, const std::unique_lock<std::mutex>&)
+{
+	if (!cached.exports)
+	{
+		NameScope scope(cached.names);
+		std::ifstream fin(cached.fileName.c_str(), std::ifstream::binary);
+		cached.exports = decodeExports(fin, cached.image);
+		workerArena().reset();
+
+		for (size_t idx = 0; idx < cached.exports->size(); ++idx)
+		{
+			cached.exportsByName.emplace(corpusNames().name((*cached.exports)[idx].name), idx);
+		}
+	}
+
+	/*Looked up by text so names that were never exported don't grow the interner*/
+	auto found = cached.exportsByName.find(name);
+	if (found == cached.exportsByName.end())
+	{
+		return std::nullopt;
+	}
+	return (*cached.exports)[found->second].address;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Decoder.h"
+#include "ExportsTrie.h"
+#include "StringInterner.h"
+#include "StubIndex.h"
+#include "SymbolTable.h"
+
+/*One decoded image and the indexes built over it so far, each built the first time it is needed.
+Every NameId in it belongs to names, so an image's strings are freed along with it.*/
+struct CachedImage
+{
+	std::string							fileName;
+	uintmax_t							fileSize;
+	std::filesystem::file_time_type		modified;	/*with fileSize, tells whether the file changed since it was decoded*/
+
+	StringInterner						names;
+	MachImage							image;
+
+	std::mutex							lock;		/*held while the members below are built or read*/
+	std::optional<std::string>			description;
+	std::optional<SymbolTable>			symbols;
+	std::optional<StubIndex>			stubs;
+	std::optional<std::vector<ExportedSymbol>>	exports;
+	std::unordered_map<std::string_view, size_t>	exportsByName;	/*interned names to index into exports*/
+};
+
+/*Decoded images keyed by file name with least recently used eviction.  Safe to use from many
+threads, images are decoded outside the cache's lock and an evicted image stays alive for as long
+as a caller still holds it.  Each accessor works under a NameScope for the image's own names.*/
+class ImageCache
+{
+public:
+	ImageCache(size_t capacity, const DecodeOptions& options);
+
+	/*Returns the cached image, decoding it again if it is missing or the file changed.
+	Throws std::runtime_error for files that aren't 64-bit Mach-O images.*/
+	std::shared_ptr<CachedImage> acquire(const std::string& fileName);
+
+	/*The cached image if it is still current, nothing rather than decoding it*/
+	std::shared_ptr<CachedImage> find(const std::string& fileName);
+
+	/*Each of these builds what it needs the first time under cached.lock.  The overloads taking held
+	are for a caller that already holds cached.lock, such as one that checked what is built.*/
+	std::string description(CachedImage& cached);
+	std::string description(CachedImage& cached, const std::unique_lock<std::mutex>& held);
+	std::string stubTarget(CachedImage& cached, uint64_t address);	/*empty when the address reaches no import*/
+	std::string stubTarget(CachedImage& cached, uint64_t address, const std::unique_lock<std::mutex>& held);
+	std::optional<uint64_t> findExport(CachedImage& cached, std::string_view name);
+	std::optional<uint64_t> findExport(CachedImage& cached, std::string_view name, const std::unique_lock<std::mutex>& held);
+
+	size_t size() const;
+	uint64_t hits() const { return hitCount; }
+	uint64_t misses() const { return missCount; }
+	uint64_t evictions() const { return evictionCount; }
+
+private:
+	typedef std::list<std::shared_ptr<CachedImage>> Entries;
+
+	Entries::iterator current(const std::string& fileName, uintmax_t fileSize, std::filesystem::file_time_type modified);
+	const SymbolTable& symbols(CachedImage& cached);
+
+	size_t			capacity;
+	DecodeOptions	options;
+
+	mutable std::mutex	lock;
+	Entries				entries;	/*most recently used first*/
+	std::unordered_map<std::string, Entries::iterator>	byName;
+
+	std::atomic<uint64_t>	hitCount{ 0 };
+	std::atomic<uint64_t>	missCount{ 0 };
+	std::atomic<uint64_t>	evictionCount{ 0 };
+};
@@ -0,0 +1,149 @@
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include "Daemon.h"
+#include "Decoder.h"
+#include "DwarfLines.h"
+#include "SharedCache.h"
+#include "Similarity.h"
+
+namespace
+{
+	/*A whole number above 0, nothing for anything else rather than an exception or a silent 0*/
+	std::optional<size_t> parseCount(const std::string& text)
+	{
+		const size_t MaximumDigits = 7;
+		if (text.empty() || text.size() > MaximumDigits || text.find_first_not_of("0123456789") != std::string::npos)
+		{
+			return std::nullopt;
+		}
+
+		const size_t count = size_t(std::stoull(text));
+		if (count == 0)
+		{
+			return std::nullopt;
+		}
+
+		return count;
+	}
+
+	std::optional<size_t> parseMebibytes(const std::string& text)
+	{
+		const std::optional<size_t> mebibytes = parseCount(text);
+		return mebibytes ? std::optional<size_t>(*mebibytes << 20) : std::nullopt;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	/*--daemon <socket path> [--cache=<images>] serves queries instead of decoding one file*/
+	if (argc > 2 && std::string(argv[1]) == "--daemon")
+	{
+		DaemonOptions daemonOptions;
+		daemonOptions.socketPath = argv[2];
+		if (argc > 3 && std::string(argv[3]).rfind("--cache=", 0) == 0)
+		{
+			const std::optional<size_t> capacity = parseCount(std::string(argv[3]).substr(8));
+			if (!capacity)
+			{
+				std::cerr << "Usage : --cache=<images> takes a whole number of images greater than 0, not \"" << argv[3] + 8 << "\"" << std::endl;
+				return 1;
+			}
+			daemonOptions.cacheCapacity = *capacity;
+		}
+
+		runDaemon(daemonOptions);
+		return 0;
+	}
+
+	/*--similar-index <corpus directory> <index file> signs a corpus once and stores its band tables*/
+	if (argc > 3 && std::string(argv[1]) == "--similar-index")
+	{
+		try
+		{
+			buildSimilarityIndex(
+				std::filesystem::current_path().append(argv[2]).string(),
+				std::filesystem::current_path().append(argv[3]).string());
+		}
+		catch (const std::runtime_error& error)
+		{
+			std::cerr << "Error : " << error.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	/*--similar <image> <index file> <output> lists indexed images that resemble image*/
+	if (argc > 4 && std::string(argv[1]) == "--similar")
+	{
+		try
+		{
+			findSimilar(
+				std::filesystem::current_path().append(argv[2]).string(),
+				std::filesystem::current_path().append(argv[3]).string(),
+				std::filesystem::current_path().append(argv[4]).string());
+		}
+		catch (const std::runtime_error& error)
+		{
+			std::cerr << "Error : " << error.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	/*--symbolicate <dSYM image> <address list> <output> maps hex addresses to file:line*/
+	if (argc > 4 && std::string(argv[1]) == "--symbolicate")
+	{
+		try
+		{
+			symbolicate(
+				std::filesystem::current_path().append(argv[2]).string(),
+				std::filesystem::current_path().append(argv[3]).string(),
+				std::filesystem::current_path().append(argv[4]).string());
+		}
+		catch (const std::runtime_error& error)
+		{
+			std::cerr << "Error : " << error.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	DecodeOptions options;
+
+	/*Optional third argument --stream=<MiB> caps resident file data for very large inputs*/
+	if (argc > 3 && std::string(argv[3]).rfind("--stream=", 0) == 0)
+	{
+		const std::optional<size_t> limit = parseMebibytes(std::string(argv[3]).substr(9));
+		if (!limit)
+		{
+			std::cerr << "Usage : --stream=<MiB> takes a whole number of MiB greater than 0, not \"" << argv[3] + 9 << "\"" << std::endl;
+			return 1;
+		}
+		options.streamMemoryLimit = *limit;
+	}
+
+	const std::string inputFileName = std::filesystem::current_path().append(argv[1]).string();
+	const std::string outputFileName = std::filesystem::current_path().append(argv[2]).string();
+
+	if (isSharedCache(inputFileName))
+	{
+		try
+		{
+			decodeSharedCache(inputFileName, outputFileName, options);
+		}
+		catch (const std::runtime_error& error)
+		{
+			std::cerr << "Error : " << error.what() << std::endl;
+			return 1;
+		}
+	}
+	else
+	{
+		decodeFile(inputFileName, outputFileName, options);
+	}
+
+	return 0;
+}
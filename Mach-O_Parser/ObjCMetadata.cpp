@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cstring>
+#include "Arena.h"
+#include "ObjCMetadata.h"
+#include "Reader.h"
+
+namespace
+{
+	const size_t StringChunkSize = 256;
+	const size_t MaximumStringLength = 4096;
+	const std::string_view ClassSymbolPrefix = "_OBJC_CLASS_$_";
+
+	std::vector<uint32_t> sortedOrder(const std::vector<uint64_t>& addresses)
+	{
+		std::vector<uint32_t> order(addresses.size());
+		for (size_t idx = 0; idx < order.size(); ++idx)
+		{
+			order[idx] = static_cast<uint32_t>(idx);
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return addresses[lhs] < addresses[rhs]; });
+
+		return order;
+	}
+
+	/*Index into addresses of the entry at address, found through the sorted order*/
+	std::optional<uint32_t> findFixup(const std::vector<uint64_t>& addresses, const std::vector<uint32_t>& order, uint64_t address)
+	{
+		auto found = std::lower_bound(order.begin(), order.end(), address,
+			[&](uint32_t idx, uint64_t value) { return addresses[idx] < value; });
+
+		if (found == order.end() || addresses[*found] != address)
+		{
+			return std::nullopt;
+		}
+
+		return *found;
+	}
+}
+
+ObjCMetadata::ObjCMetadata(std::ifstream& fin, const MachImage& image, const ChainedFixups* fixups)
+	: fin(fin), image(image), fixups(fixups)
+{
+	if (fixups)
+	{
+		rebaseOrder = sortedOrder(fixups->rebaseAddress);
+		bindOrder = sortedOrder(fixups->bindAddress);
+	}
+}
+
+bool ObjCMetadata::hasMetadata() const
+{
+	return findSection(image, "__objc_classlist") || findSection(image, "__objc_catlist") || findSection(image, "__objc_protolist");
+}
+
+void ObjCMetadata::addResident(uint64_t fileOffset, const ArenaVector<uint8_t>& bytes)
+{
+	residentRanges.emplace_back(fileOffset, &bytes);
+}
+
+const uint8_t* ObjCMetadata::residentAt(uint64_t offset, uint64_t& available) const
+{
+	for (const auto& range : residentRanges)
+	{
+		if (offset >= range.first && offset - range.first < range.second->size())
+		{
+			available = range.second->size() - (offset - range.first);
+			return range.second->data() + (offset - range.first);
+		}
+	}
+
+	return nullptr;
+}
+
+template <typename Structure>
+std::optional<Structure> ObjCMetadata::readAt(uint64_t address)
+{
+	/*0 is a null pointer rather than an address, even in images that map something there*/
+	const std::optional<uint64_t> offset = address ? fileOffsetForAddress(image, address) : std::nullopt;
+	if (!offset)
+	{
+		return std::nullopt;
+	}
+
+	uint64_t available = 0;
+	if (const uint8_t* bytes = residentAt(*offset, available))
+	{
+		if (available >= sizeof(Structure))
+		{
+			Structure structure;
+			memcpy(&structure, bytes, sizeof(Structure));
+			return structure;
+		}
+	}
+
+	auto structures = readArrayAt<Structure>(fin, *offset, 1, ArenaAllocator<Structure>(workerArena()));
+	if (structures.empty())
+	{
+		return std::nullopt;
+	}
+
+	return structures.front();
+}
+
+ObjCMetadata::PointerTarget ObjCMetadata::resolvePointer(uint64_t fieldAddress)
+{
+	if (fixups)
+	{
+		/*With chained fixups the stored value is a chain entry, only the decoded fixup means anything*/
+		if (auto rebase = findFixup(fixups->rebaseAddress, rebaseOrder, fieldAddress))
+		{
+			return { fixups->rebaseTarget[*rebase], corpusNames().intern(std::string_view()) };
+		}
+		if (auto bind = findFixup(fixups->bindAddress, bindOrder, fieldAddress))
+		{
+			const ChainedImport& import = fixups->imports[fixups->bindImport[*bind]];
+			return { 0, import.name };
+		}
+		return { 0, corpusNames().intern(std::string_view()) };
+	}
+
+	return { readAt<uint64_t>(fieldAddress).value_or(0), corpusNames().intern(std::string_view()) };
+}
+
+NameId ObjCMetadata::readCString(uint64_t address)
+{
+	const std::optional<uint64_t> offset = address ? fileOffsetForAddress(image, address) : std::nullopt;
+	if (!offset)
+	{
+		return corpusNames().intern(std::string_view());
+	}
+
+	uint64_t available = 0;
+	if (const char* resident = reinterpret_cast<const char*>(residentAt(*offset, available)))
+	{
+		const size_t limit = static_cast<size_t>(std::min<uint64_t>(available, MaximumStringLength));
+		const size_t length = strnlen(resident, limit);
+		if (length < limit || limit == MaximumStringLength)
+		{
+			return corpusNames().intern(std::string_view(resident, length));
+		}
+	}
+
+	ArenaAllocator<char> allocator(workerArena());
+	ArenaVector<char> text(allocator);
+	while (text.size() < MaximumStringLength)
+	{
+		auto chunk = readArrayAt<char>(fin, *offset + text.size(), StringChunkSize, allocator);
+		const size_t length = strnlen(chunk.data(), chunk.size());
+		text.insert(text.end(), chunk.begin(), chunk.begin() + length);
+
+		if (length < StringChunkSize)
+		{
+			break;
+		}
+	}
+
+	return corpusNames().intern(std::string_view(text.data(), text.size()));
+}
+
+std::vector<uint64_t> ObjCMetadata::readPointerSection(std::string_view sectname)
+{
+	std::vector<uint64_t> targets;
+	const Section* sect = findSection(image, sectname);
+	if (!sect || isZerofill(*sect))
+	{
+		return targets;
+	}
+
+	targets.reserve(static_cast<size_t>(sect->size / sizeof(uint64_t)));
+	for (uint64_t address = sect->addr; address + sizeof(uint64_t) <= sect->addr + sect->size; address += sizeof(uint64_t))
+	{
+		targets.push_back(resolvePointer(address).address);
+	}
+
+	return targets;
+}
+
+/*Names a class from a pointer to it, classes in other images are named by their _OBJC_CLASS_$_ symbol*/
+NameId ObjCMetadata::className(const PointerTarget& target)
+{
+	if (target.address != 0)
+	{
+		return objcClass(target.address).name;
+	}
+
+	std::string_view symbol = corpusNames().name(target.import);
+	if (symbol.rfind(ClassSymbolPrefix, 0) == 0)
+	{
+		return corpusNames().intern(symbol.substr(ClassSymbolPrefix.size()));
+	}
+
+	return target.import;
+}
+
+const std::vector<uint64_t>& ObjCMetadata::classAddresses()
+{
+	if (!classList)
+	{
+		classList = readPointerSection("__objc_classlist");
+	}
+
+	return *classList;
+}
+
+const std::vector<ObjCCategory>& ObjCMetadata::categories()
+{
+	if (!categoryList)
+	{
+		categoryList.emplace();
+		for (uint64_t address : readPointerSection("__objc_catlist"))
+		{
+			std::optional<category_64> category = readAt<category_64>(address);
+			if (!category)
+			{
+				continue;
+			}
+
+			categoryList->push_back({
+				readCString(resolvePointer(address + offsetof(category_64, name)).address),
+				className(resolvePointer(address + offsetof(category_64, cls))),
+				resolvePointer(address + offsetof(category_64, instanceMethods)).address,
+				resolvePointer(address + offsetof(category_64, classMethods)).address,
+				resolvePointer(address + offsetof(category_64, protocols)).address });
+		}
+	}
+
+	return *categoryList;
+}
+
+const std::vector<NameId>& ObjCMetadata::protocols()
+{
+	if (!protocolNames)
+	{
+		protocolNames.emplace();
+		for (uint64_t address : readPointerSection("__objc_protolist"))
+		{
+			protocolNames->push_back(readCString(resolvePointer(address + offsetof(protocol_64, name)).address));
+		}
+	}
+
+	return *protocolNames;
+}
+
+const std::vector<NameId>& ObjCMetadata::selectorReferences()
+{
+	if (!selectorRefs)
+	{
+		selectorRefs.emplace();
+		for (uint64_t address : readPointerSection("__objc_selrefs"))
+		{
+			selectorRefs->push_back(readCString(address));
+		}
+	}
+
+	return *selectorRefs;
+}
+
+const ObjCClass& ObjCMetadata::objcClass(uint64_t address)
+{
+	auto cached = classes.find(address);
+	if (cached != classes.end())
+	{
+		return cached->second;
+	}
+
+	/*Inserted before the superclass is looked up, so a malformed class that is its own ancestor still terminates*/
+	ObjCClass& decoded = classes[address];
+	decoded = { address, corpusNames().intern(std::string_view()), corpusNames().intern(std::string_view()), 0, 0, 0, 0 };
+
+	const uint64_t data = resolvePointer(address + offsetof(objc_class_64, data)).address & FAST_DATA_MASK;
+	std::optional<class_ro_64> readOnly = readAt<class_ro_64>(data);
+	if (!readOnly)
+	{
+		return decoded;
+	}
+
+	decoded.flags = readOnly->flags;
+	decoded.name = readCString(resolvePointer(data + offsetof(class_ro_64, name)).address);
+	decoded.instanceMethods = resolvePointer(data + offsetof(class_ro_64, baseMethods)).address;
+	decoded.protocols = resolvePointer(data + offsetof(class_ro_64, baseProtocols)).address;
+
+	/*Class methods live in the metaclass, which isa points at*/
+	const uint64_t metaclass = resolvePointer(address + offsetof(objc_class_64, isa)).address;
+	if (metaclass != 0)
+	{
+		const uint64_t metaData = resolvePointer(metaclass + offsetof(objc_class_64, data)).address & FAST_DATA_MASK;
+		if (metaData != 0)
+		{
+			decoded.classMethods = resolvePointer(metaData + offsetof(class_ro_64, baseMethods)).address;
+		}
+	}
+
+	/*Node based map, so decoded stays valid while the superclass chain inserts more classes*/
+	if (!(readOnly->flags & RO_ROOT))
+	{
+		decoded.superclass = className(resolvePointer(address + offsetof(objc_class_64, superclass)));
+	}
+
+	return decoded;
+}
+
+const std::vector<ObjCMethod>& ObjCMetadata::methodList(uint64_t address)
+{
+	auto cached = methodLists.find(address);
+	if (cached != methodLists.end())
+	{
+		return cached->second;
+	}
+
+	std::vector<ObjCMethod> methods;
+	std::optional<entsize_list_64> list = readAt<entsize_list_64>(address);
+	const uint32_t entrySize = list ? list->entsizeAndFlags & ~uint32_t(METHOD_LIST_FLAGS_MASK) : 0;
+
+	if (list && entrySize != 0)
+	{
+		const bool relative = (list->entsizeAndFlags & METHOD_LIST_IS_RELATIVE) != 0;
+		const bool directSelectors = (list->entsizeAndFlags & METHOD_LIST_SELECTORS_ARE_DIRECT) != 0;
+		const std::optional<uint64_t> offset = fileOffsetForAddress(image, address + sizeof(entsize_list_64));
+
+		/*The whole list is read at once, or taken straight from a resident copy, entries are then decoded from memory*/
+		const uint64_t listSize = uint64_t(list->count) * entrySize;
+		uint64_t available = 0;
+		const uint8_t* resident = offset ? residentAt(*offset, available) : nullptr;
+		const bool inMemory = resident && available >= listSize;
+		auto raw = offset && !inMemory
+			? readArrayAt<uint8_t>(fin, *offset, static_cast<size_t>(listSize), ArenaAllocator<uint8_t>(workerArena()))
+			: ArenaVector<uint8_t>(ArenaAllocator<uint8_t>(workerArena()));
+		const uint8_t* entries = inMemory ? resident : raw.data();
+		const size_t count = inMemory ? size_t(list->count) : raw.size() / entrySize;
+		methods.reserve(count);
+
+		for (size_t idx = 0; idx < count; ++idx)
+		{
+			const uint64_t entryAddress = address + sizeof(entsize_list_64) + idx * entrySize;
+			ObjCMethod method = { corpusNames().intern(std::string_view()), corpusNames().intern(std::string_view()), 0 };
+
+			if (relative && entrySize >= sizeof(method_relative))
+			{
+				method_relative entry;
+				memcpy(&entry, entries + idx * entrySize, sizeof(entry));
+
+				const uint64_t nameField = entryAddress + offsetof(method_relative, nameOffset);
+				const uint64_t typesField = entryAddress + offsetof(method_relative, typesOffset);
+				const uint64_t impField = entryAddress + offsetof(method_relative, impOffset);
+
+				/*Direct selector offsets are relative to the shared cache's selector base, which a single image doesn't carry*/
+				if (!directSelectors)
+				{
+					method.selector = readCString(resolvePointer(nameField + entry.nameOffset).address);
+				}
+				method.types = readCString(typesField + entry.typesOffset);
+				method.implementation = entry.impOffset ? impField + entry.impOffset : 0;
+			}
+			else if (!relative && entrySize >= sizeof(method_64))
+			{
+				method.selector = readCString(resolvePointer(entryAddress + offsetof(method_64, name)).address);
+				method.types = readCString(resolvePointer(entryAddress + offsetof(method_64, types)).address);
+				method.implementation = resolvePointer(entryAddress + offsetof(method_64, imp)).address;
+			}
+
+			methods.push_back(method);
+		}
+	}
+
+	return methodLists.emplace(address, std::move(methods)).first->second;
+}
+
+const std::vector<NameId>& ObjCMetadata::protocolList(uint64_t address)
+{
+	auto cached = protocolLists.find(address);
+	if (cached != protocolLists.end())
+	{
+		return cached->second;
+	}
+
+	std::vector<NameId> names;
+	if (std::optional<uint64_t> count = readAt<uint64_t>(address))
+	{
+		const uint64_t first = address + offsetof(protocol_list_64, list);
+		for (uint64_t idx = 0; idx < *count && fileOffsetForAddress(image, first + idx * sizeof(uint64_t)); ++idx)
+		{
+			const uint64_t protocol = resolvePointer(first + idx * sizeof(uint64_t)).address;
+			names.push_back(readCString(resolvePointer(protocol + offsetof(protocol_64, name)).address));
+		}
+	}
+
+	return protocolLists.emplace(address, std::move(names)).first->second;
+}
+
+const std::vector<NameId>& ObjCMetadata::selectorsImplementedBy(NameId className)
+{
+	auto cached = implementedSelectors.find(className);
+	if (cached != implementedSelectors.end())
+	{
+		return cached->second;
+	}
+
+	if (!classesByName)
+	{
+		classesByName.emplace();
+		for (uint64_t address : classAddresses())
+		{
+			classesByName->emplace(objcClass(address).name, address);
+		}
+	}
+
+	std::vector<NameId> selectors;
+	auto addMethods = [&](uint64_t listAddress)
+	{
+		if (listAddress != 0)
+		{
+			for (const auto& method : methodList(listAddress))
+			{
+				selectors.push_back(method.selector);
+			}
+		}
+	};
+
+	auto found = classesByName->find(className);
+	if (found != classesByName->end())
+	{
+		const ObjCClass& cls = objcClass(found->second);
+		addMethods(cls.instanceMethods);
+		addMethods(cls.classMethods);
+	}
+
+	for (const auto& category : categories())
+	{
+		if (category.className == className)
+		{
+			addMethods(category.instanceMethods);
+			addMethods(category.classMethods);
+		}
+	}
+
+	std::sort(selectors.begin(), selectors.end(),
+		[](NameId lhs, NameId rhs) { return corpusNames().name(lhs) < corpusNames().name(rhs); });
+	selectors.erase(std::unique(selectors.begin(), selectors.end()), selectors.end());
+
+	return implementedSelectors.emplace(className, std::move(selectors)).first->second;
+}
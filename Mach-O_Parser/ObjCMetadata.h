@@ -0,0 +1,106 @@
+#pragma once
+#include <fstream>
+#include <optional>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+#include "ChainedFixups.h"
+#include "Decoder.h"
+#include "objc-runtime.h"
+
+struct ObjCMethod
+{
+	NameId		selector;
+	NameId		types;
+	uint64_t	implementation;		/*vmaddr, 0 when it couldn't be resolved*/
+};
+
+/*Names and list addresses of one class, the lists themselves are decoded on request*/
+struct ObjCClass
+{
+	uint64_t	address;
+	NameId		name;
+	NameId		superclass;			/*the empty name for root classes*/
+	uint32_t	flags;				/*class_ro RO_* flags*/
+	uint64_t	instanceMethods;	/*method list vmaddrs, 0 when the class has none*/
+	uint64_t	classMethods;
+	uint64_t	protocols;			/*protocol list vmaddr*/
+};
+
+struct ObjCCategory
+{
+	NameId		name;
+	NameId		className;			/*the class being extended, which may live in another image*/
+	uint64_t	instanceMethods;
+	uint64_t	classMethods;
+	uint64_t	protocols;
+};
+
+/*Reads Objective-C metadata out of one image on demand.  Nothing is read until it is asked for,
+and every class, method list and protocol list is decoded at most once, so repeated queries
+against the same image only cost a lookup.  Pointers are resolved through the image's chained
+fixups when it has them, binds resolve to the imported symbol rather than an address.*/
+class ObjCMetadata
+{
+public:
+	ObjCMetadata(std::ifstream& fin, const MachImage& image, const ChainedFixups* fixups = nullptr);
+
+	bool hasMetadata() const;
+
+	/*Serves reads inside bytes, a copy of the file from fileOffset on, from memory instead of the file.
+	Streamed decoding retains the __objc_ sections this way.  bytes must outlive the metadata.*/
+	void addResident(uint64_t fileOffset, const ArenaVector<uint8_t>& bytes);
+
+	/*__objc_classlist, __objc_catlist, __objc_protolist and __objc_selrefs in section order*/
+	const std::vector<uint64_t>& classAddresses();
+	const std::vector<ObjCCategory>& categories();
+	const std::vector<NameId>& protocols();
+	const std::vector<NameId>& selectorReferences();
+
+	const ObjCClass& objcClass(uint64_t address);
+	const std::vector<ObjCMethod>& methodList(uint64_t address);
+	const std::vector<NameId>& protocolList(uint64_t address);
+
+	/*Every selector class name implements, its own and its categories', instance and class methods alike, sorted*/
+	const std::vector<NameId>& selectorsImplementedBy(NameId className);
+
+private:
+	/*Where a pointer field leads, either somewhere in this image or to an imported symbol*/
+	struct PointerTarget
+	{
+		uint64_t	address;
+		NameId		import;
+	};
+
+	PointerTarget resolvePointer(uint64_t fieldAddress);
+	NameId readCString(uint64_t address);
+	std::vector<uint64_t> readPointerSection(std::string_view sectname);
+	NameId className(const PointerTarget& target);
+
+	template <typename Structure>
+	std::optional<Structure> readAt(uint64_t address);
+
+	/*Resident bytes from offset on and how many there are, nullptr when offset isn't resident*/
+	const uint8_t* residentAt(uint64_t offset, uint64_t& available) const;
+
+	std::ifstream&			fin;
+	const MachImage&		image;
+	const ChainedFixups*	fixups;
+
+	std::vector<std::pair<uint64_t, const ArenaVector<uint8_t>*>>	residentRanges;
+
+	/*fixup locations sorted by address, indexes into the fixups tables*/
+	std::vector<uint32_t>	rebaseOrder;
+	std::vector<uint32_t>	bindOrder;
+
+	std::optional<std::vector<uint64_t>>		classList;
+	std::optional<std::vector<ObjCCategory>>	categoryList;
+	std::optional<std::vector<NameId>>			protocolNames;
+	std::optional<std::vector<NameId>>			selectorRefs;
+
+	std::unordered_map<uint64_t, ObjCClass>				classes;
+	std::unordered_map<uint64_t, std::vector<ObjCMethod>>	methodLists;
+	std::unordered_map<uint64_t, std::vector<NameId>>		protocolLists;
+	std::optional<std::unordered_map<NameId, uint64_t>>	classesByName;
+	std::unordered_map<NameId, std::vector<NameId>>		implementedSelectors;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+template <typename Structure>
+Structure readInAndReset(std::ifstream& fin)
+{
+	std::streampos originalOffset = fin.tellg();
+	Structure structure;
+	fin.read((char*)&structure, sizeof(structure));
+	fin.seekg(originalOffset);
+
+	return structure;
+}
+
+template <typename Structure>
+Structure readIn(std::ifstream& fin)
+{
+	Structure structure;
+	fin.read((char*)&structure, sizeof(structure));
+
+	return structure;
+}
+
+/*Counts and offsets come straight from the file, so before a large read allocates anything the
+count is clipped to the structures the file can actually hold past offset*/
+inline size_t clipToFile(std::ifstream& fin, uint64_t offset, size_t count, size_t structureSize)
+{
+	const size_t UncheckedBytes = 1 << 16;
+	if (count <= UncheckedBytes / structureSize)
+	{
+		return count;
+	}
+
+	fin.clear();
+	fin.seekg(0, std::ios_base::end);
+	const std::streamoff fileSize = fin.tellg();
+	if (fileSize < 0 || offset >= uint64_t(fileSize))
+	{
+		return 0;
+	}
+
+	return static_cast<size_t>(std::min<uint64_t>(count, (uint64_t(fileSize) - offset) / structureSize));
+}
+
+/*Reads count consecutive structures starting at an absolute file offset, leaving the stream where it was.
+Short reads are trimmed so a truncated file yields fewer entries rather than garbage, and a count
+larger than the file is clipped before the buffer is allocated.
+Pass an ArenaAllocator to place transient buffers in a worker arena.*/
+template <typename Structure, typename Allocator = std::allocator<Structure>>
+std::vector<Structure, Allocator> readArrayAt(std::ifstream& fin, uint64_t offset, size_t count, const Allocator& allocator = Allocator())
+{
+	std::streampos originalOffset = fin.tellg();
+	count = clipToFile(fin, offset, count, sizeof(Structure));
+	std::vector<Structure, Allocator> structures(count, allocator);
+
+	fin.clear();
+	fin.seekg(offset, std::ios_base::beg);
+	fin.read((char*)structures.data(), count * sizeof(Structure));
+	structures.resize(static_cast<size_t>(fin.gcount()) / sizeof(Structure));
+
+	fin.clear();
+	fin.seekg(originalOffset);
+
+	return structures;
+}
+
+/*Decodes an unsigned LEB128 value and advances cursor past it, stopping at end on truncated input*/
+inline uint64_t readUleb128(const uint8_t*& cursor, const uint8_t* end)
+{
+	uint64_t result = 0;
+	unsigned shift = 0;
+
+	while (cursor < end)
+	{
+		uint8_t byte = *cursor++;
+		if (shift < 64)
+		{
+			result |= uint64_t(byte & 0x7f) << shift;
+		}
+		shift += 7;
+
+		if ((byte & 0x80) == 0)
+		{
+			break;
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include "Arena.h"
+#include "Relocations.h"
+#include "Reader.h"
+
+namespace
+{
+	/*Maps a scattered r_value back to the ordinal of the section containing it, 0 if none does*/
+	uint32_t sectionOrdinalForAddress(const MachImage& image, uint64_t address)
+	{
+		for (size_t idx = 0; idx < image.sections.size(); ++idx)
+		{
+			const Section& sect = image.sections[idx];
+			if (address >= sect.addr && address - sect.addr < sect.size)
+			{
+				return static_cast<uint32_t>(idx + 1);
+			}
+		}
+
+		return 0;
+	}
+}
+
+RelocationTable decodeRelocations(std::ifstream& fin, const Section& sect, const MachImage& image, const SymbolTable& symbols)
+{
+	/*Both relocation layouts are two little endian words, so read them as raw words and
+	split the bit fields with shifts and masks instead of going through the structs.*/
+	static_assert(sizeof(relocation_info) == 2 * sizeof(uint32_t), "relocation entries are two words");
+	static_assert(sizeof(scattered_relocation_info) == 2 * sizeof(uint32_t), "relocation entries are two words");
+
+	const auto words = readArrayAt<uint32_t>(fin, sect.reloff, size_t(sect.nreloc) * 2, ArenaAllocator<uint32_t>(workerArena()));
+	return decodeRelocationWords(words.data(), words.size() / 2, image, symbols);
+}
+
+RelocationTable decodeRelocationWords(const uint32_t* raw, size_t count, const MachImage& image, const SymbolTable& symbols)
+{
+	RelocationTable table;
+	table.address.resize(count);
+	table.value.resize(count);
+	table.addend.resize(count);
+	table.target.resize(count);
+	table.targetKind.resize(count);
+	table.type.resize(count);
+	table.length.resize(count);
+	table.pcrel.resize(count);
+	table.scattered.resize(count);
+
+	ArenaVector<uint8_t> isExtern(count, ArenaAllocator<uint8_t>(workerArena()));
+
+	/*Branch free so the compiler can vectorize it, each field is picked from whichever
+	word holds it for the entry's layout.*/
+	for (size_t idx = 0; idx < count; ++idx)
+	{
+		const uint32_t first = raw[2 * idx];
+		const uint32_t second = raw[2 * idx + 1];
+		const uint32_t isScattered = first >> 31;
+
+		table.scattered[idx]	= static_cast<uint8_t>(isScattered);
+		table.address[idx]		= isScattered ? (first & 0x00ffffff) : first;
+		table.value[idx]		= isScattered ? static_cast<int32_t>(second) : 0;
+		table.target[idx]		= isScattered ? 0 : (second & 0x00ffffff);
+		table.type[idx]			= static_cast<uint8_t>(isScattered ? (first >> 24) & 0xf : second >> 28);
+		table.length[idx]		= static_cast<uint8_t>(isScattered ? (first >> 28) & 0x3 : (second >> 25) & 0x3);
+		table.pcrel[idx]		= static_cast<uint8_t>(isScattered ? (first >> 30) & 0x1 : (second >> 24) & 0x1);
+		isExtern[idx]			= static_cast<uint8_t>(isScattered ? 0 : (second >> 27) & 0x1);
+	}
+
+	const bool arm64 = image.header.cputype == CPU_TYPE_ARM64;
+	for (size_t idx = 0; idx < count; ++idx)
+	{
+		if (arm64 && !table.scattered[idx] && table.type[idx] == ARM64_RELOC_ADDEND)
+		{
+			/*r_symbolnum holds a signed 24 bit addend for the entry that follows, not a section ordinal*/
+			if (idx + 1 < count)
+			{
+				table.addend[idx + 1] = static_cast<int32_t>(table.target[idx] << 8) >> 8;
+			}
+			table.targetKind[idx] = RelocationTarget::Addend;
+		}
+		else if (table.scattered[idx])
+		{
+			table.target[idx] = sectionOrdinalForAddress(image, static_cast<uint32_t>(table.value[idx]));
+			table.targetKind[idx] = table.target[idx] ? RelocationTarget::Section : RelocationTarget::Absolute;
+		}
+		else if (isExtern[idx])
+		{
+			table.targetKind[idx] = table.target[idx] < symbols.size() ? RelocationTarget::Symbol : RelocationTarget::Unresolved;
+		}
+		else if (table.target[idx] == R_ABS)
+		{
+			table.targetKind[idx] = RelocationTarget::Absolute;
+		}
+		else
+		{
+			table.targetKind[idx] = table.target[idx] <= image.sections.size() ? RelocationTarget::Section : RelocationTarget::Unresolved;
+		}
+	}
+
+	return table;
+}
+
+void externSymbols(const uint32_t* raw, size_t count, std::vector<uint32_t>& indices)
+{
+	for (size_t idx = 0; idx < count; ++idx)
+	{
+		const uint32_t first = raw[2 * idx];
+		const uint32_t second = raw[2 * idx + 1];
+		if (!(first >> 31) && (second >> 27) & 0x1)
+		{
+			indices.push_back(second & 0x00ffffff);
+		}
+	}
+}
+
+std::string_view relocationTargetName(const RelocationTable& table, size_t entry, const MachImage& image, const SymbolTable& symbols)
+{
+	switch (table.targetKind[entry])
+	{
+	case RelocationTarget::Symbol:
+		return symbols.name(table.target[entry]);
+
+	case RelocationTarget::Section:
+		return corpusNames().name(image.sections[table.target[entry] - 1].name);
+
+	default:
+		return std::string_view();
+	}
+}
+
+RelocationIndex::RelocationIndex(std::ifstream& fin, const MachImage& image, const SymbolTable& symbols)
+	: fin(fin), image(image), symbols(symbols), slots(image.sections.size())
+{
+}
+
+RelocationIndex::Slot& RelocationIndex::decoded(size_t sectionIndex)
+{
+	Slot& slot = slots[sectionIndex];
+	if (!slot.decoded)
+	{
+		const Section& sect = image.sections[sectionIndex];
+		adopt(sectionIndex, sect.nreloc != 0 ? decodeRelocations(fin, sect, image, symbols) : RelocationTable());
+	}
+
+	return slot;
+}
+
+const RelocationTable* RelocationIndex::forSection(size_t sectionIndex)
+{
+	Slot& slot = decoded(sectionIndex);
+	return slot.table ? &*slot.table : nullptr;
+}
+
+std::optional<RelocationAt> RelocationIndex::find(uint64_t address)
+{
+	for (size_t idx = 0; idx < image.sections.size(); ++idx)
+	{
+		const Section& sect = image.sections[idx];
+		if (sect.nreloc == 0 || address < sect.addr || address - sect.addr >= sect.size)
+		{
+			continue;
+		}
+
+		const Slot& slot = decoded(idx);
+		if (!slot.table)
+		{
+			return std::nullopt;
+		}
+
+		const RelocationTable& table = *slot.table;
+		const uint64_t offset = address - sect.addr;
+		auto found = std::lower_bound(slot.byAddress.begin(), slot.byAddress.end(), offset,
+			[&table](uint32_t entry, uint64_t value) { return table.address[entry] < value; });
+
+		if (found == slot.byAddress.end() || table.address[*found] != offset)
+		{
+			return std::nullopt;
+		}
+
+		return RelocationAt{ &table, *found };
+	}
+
+	return std::nullopt;
+}
+
+void RelocationIndex::adopt(size_t sectionIndex, std::optional<RelocationTable> table)
+{
+	Slot& slot = slots[sectionIndex];
+	slot.decoded = true;
+	slot.table = std::move(table);
+	slot.byAddress.clear();
+
+	if (!slot.table)
+	{
+		return;
+	}
+
+	/*Linkers write entries in descending address order, lookups want them ascending*/
+	for (uint32_t entry = 0; entry < slot.table->size(); ++entry)
+	{
+		if (slot.table->targetKind[entry] != RelocationTarget::Addend)
+		{
+			slot.byAddress.push_back(entry);
+		}
+	}
+	std::stable_sort(slot.byAddress.begin(), slot.byAddress.end(),
+		[&slot](uint32_t lhs, uint32_t rhs) { return slot.table->address[lhs] < slot.table->address[rhs]; });
+}
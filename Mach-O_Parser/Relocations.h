@@ -0,0 +1,85 @@
+#pragma once
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "Decoder.h"
+#include "SymbolTable.h"
+
+enum class RelocationTarget : uint8_t
+{
+	Unresolved,		/*Symbol index or section ordinal out of range*/
+	Absolute,		/*R_ABS, or a scattered value that lies in no section*/
+	Symbol,			/*target is an index into the symbol table*/
+	Section,		/*target is a 1-based section ordinal*/
+	Addend			/*ARM64_RELOC_ADDEND, no target of its own, its addend belongs to the next entry*/
+};
+
+/*Relocations of a single section, stored column by column so a pass over one field
+only pulls that field through the cache*/
+struct RelocationTable
+{
+	std::vector<uint32_t>			address;	/*offset in the section of the item being relocated*/
+	std::vector<int32_t>			value;		/*r_value of scattered entries, 0 otherwise*/
+	std::vector<int32_t>			addend;		/*from the ARM64_RELOC_ADDEND entry before this one, 0 otherwise*/
+	std::vector<uint32_t>			target;		/*symbol index or section ordinal, see targetKind*/
+	std::vector<RelocationTarget>	targetKind;
+	std::vector<uint8_t>			type;		/*machine specific r_type*/
+	std::vector<uint8_t>			length;		/*0=byte, 1=word, 2=long, 3=quad*/
+	std::vector<uint8_t>			pcrel;
+	std::vector<uint8_t>			scattered;
+
+	size_t size() const { return address.size(); }
+};
+
+/*Reads and decodes every relocation_info and scattered_relocation_info of one section*/
+RelocationTable decodeRelocations(std::ifstream& fin, const Section& sect, const MachImage& image, const SymbolTable& symbols);
+
+/*Decodes entries already in memory, count pairs of words laid out as in the file*/
+RelocationTable decodeRelocationWords(const uint32_t* words, size_t count, const MachImage& image, const SymbolTable& symbols);
+
+/*Appends the symbol table indices of the extern entries among count pairs of words*/
+void externSymbols(const uint32_t* words, size_t count, std::vector<uint32_t>& indices);
+
+/*Name of the symbol or section a relocation refers to, empty for absolute and unresolved targets*/
+std::string_view relocationTargetName(const RelocationTable& table, size_t entry, const MachImage& image, const SymbolTable& symbols);
+
+/*The entry found by RelocationIndex::find, entry indexes into table*/
+struct RelocationAt
+{
+	const RelocationTable*	table;
+	size_t					entry;
+};
+
+/*Per-section relocation tables that are only decoded the first time a section is asked for,
+each with its entries ordered by address for lookups.  Tables decoded elsewhere, such as from
+streamed entries, can be handed in instead of being read from the file.*/
+class RelocationIndex
+{
+public:
+	RelocationIndex(std::ifstream& fin, const MachImage& image, const SymbolTable& symbols);
+
+	/*sectionIndex is 0-based into MachImage::sections, nullptr for a section whose entries weren't read*/
+	const RelocationTable* forSection(size_t sectionIndex);
+
+	/*The entry relocating the item at address, a vmaddr, nothing when no relocation covers it*/
+	std::optional<RelocationAt> find(uint64_t address);
+
+	/*Supplies a section's table, nothing marks the section as having none rather than reading it later*/
+	void adopt(size_t sectionIndex, std::optional<RelocationTable> table);
+
+private:
+	struct Slot
+	{
+		bool							decoded = false;
+		std::optional<RelocationTable>	table;
+		std::vector<uint32_t>			byAddress;	/*entry indices sorted by address, Addend entries left out*/
+	};
+
+	Slot& decoded(size_t sectionIndex);
+
+	std::ifstream& fin;
+	const MachImage& image;
+	const SymbolTable& symbols;
+	std::vector<Slot> slots;
+};
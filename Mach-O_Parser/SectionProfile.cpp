@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include "SectionProfile.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PROFILE_USE_SSE2 1
+#endif
+
+namespace
+{
+	const size_t ChunkSize = 1 << 20;
+	const uint64_t MinimumStringLength = 4;
+
+	struct Chunk
+	{
+		size_t		section;
+		uint64_t	offset;
+		size_t		size;
+	};
+
+	/*Printable runs of one chunk, kept separately at the edges so runs crossing into the
+	neighbouring chunks can be stitched together afterwards*/
+	struct PrintableRuns
+	{
+		uint64_t	leading = 0;	/*printable bytes at the start of the chunk*/
+		uint64_t	trailing = 0;	/*printable bytes at the end of the chunk*/
+		uint64_t	inner = 0;		/*bytes in long enough runs that touch neither edge*/
+		bool		allPrintable = false;
+	};
+
+	struct ChunkResult
+	{
+		std::array<uint64_t, 256>	histogram;
+		PrintableRuns				runs;
+	};
+
+	bool isPrintable(uint8_t byte)
+	{
+		return (byte >= 0x20 && byte < 0x7f) || byte == '\t' || byte == '\n' || byte == '\r';
+	}
+
+	class RunTracker
+	{
+	public:
+		void extend(uint64_t length) { current += length; }
+
+		void close()
+		{
+			if (!sawBreak)
+			{
+				runs.leading = current;
+				sawBreak = true;
+			}
+			else if (current >= MinimumStringLength)
+			{
+				runs.inner += current;
+			}
+			current = 0;
+		}
+
+		PrintableRuns finish()
+		{
+			if (!sawBreak)
+			{
+				runs.leading = current;
+				runs.allPrintable = true;
+			}
+			runs.trailing = current;
+			return runs;
+		}
+
+	private:
+		PrintableRuns	runs;
+		uint64_t		current = 0;
+		bool			sawBreak = false;
+	};
+
+	/*Feeds the printable classification of data to tracker, which only needs extend() and close()*/
+	template <typename Tracker>
+	void scanPrintable(const uint8_t* data, size_t size, Tracker& tracker)
+	{
+		size_t idx = 0;
+
+#ifdef PROFILE_USE_SSE2
+		/*Classify 16 bytes at a time, whole printable or whole binary blocks skip the per byte walk*/
+		const __m128i belowSpace = _mm_set1_epi8(0x1f);
+		const __m128i delete_ = _mm_set1_epi8(0x7f);
+		const __m128i tab = _mm_set1_epi8('\t');
+		const __m128i newline = _mm_set1_epi8('\n');
+		const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+		for (; idx + 16 <= size; idx += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + idx));
+			/*Signed compares, so bytes of 0x80 and above count as negative and fail the first test*/
+			__m128i printable = _mm_and_si128(_mm_cmpgt_epi8(bytes, belowSpace), _mm_cmplt_epi8(bytes, delete_));
+			printable = _mm_or_si128(printable, _mm_cmpeq_epi8(bytes, tab));
+			printable = _mm_or_si128(printable, _mm_cmpeq_epi8(bytes, newline));
+			printable = _mm_or_si128(printable, _mm_cmpeq_epi8(bytes, carriageReturn));
+
+			const int mask = _mm_movemask_epi8(printable);
+			if (mask == 0xffff)
+			{
+				tracker.extend(16);
+			}
+			else
+			{
+				for (int bit = 0; bit < 16; ++bit)
+				{
+					if (mask & (1 << bit))
+					{
+						tracker.extend(1);
+					}
+					else
+					{
+						tracker.close();
+					}
+				}
+			}
+		}
+#endif
+
+		for (; idx < size; ++idx)
+		{
+			if (isPrintable(data[idx]))
+			{
+				tracker.extend(1);
+			}
+			else
+			{
+				tracker.close();
+			}
+		}
+	}
+
+	/*Stitches the chunk edge runs of one section back together in file order*/
+	uint64_t printableBytes(const std::vector<ChunkResult>& results, const std::vector<Chunk>& chunks, size_t first, size_t last)
+	{
+		uint64_t total = 0;
+		uint64_t openRun = 0;
+
+		for (size_t idx = first; idx < last; ++idx)
+		{
+			const PrintableRuns& runs = results[idx].runs;
+			if (runs.allPrintable)
+			{
+				openRun += chunks[idx].size;
+				continue;
+			}
+
+			const uint64_t joined = openRun + runs.leading;
+			total += joined >= MinimumStringLength ? joined : 0;
+			total += runs.inner;
+			openRun = runs.trailing;
+		}
+
+		return total + (openRun >= MinimumStringLength ? openRun : 0);
+	}
+}
+
+void SectionProfiler::accumulate(const uint8_t* data, size_t size)
+{
+	accumulateHistogram(data, size, profile.histogram);
+	scanPrintable(data, size, *this);
+	profile.size += size;
+}
+
+void SectionProfiler::close()
+{
+	if (currentRun >= MinimumStringLength)
+	{
+		printable += currentRun;
+	}
+	currentRun = 0;
+}
+
+SectionProfile SectionProfiler::finish()
+{
+	close();
+	profile.entropy = shannonEntropy(profile.histogram, profile.size);
+	profile.printableDensity = profile.size ? double(printable) / double(profile.size) : 0.0;
+
+	return profile;
+}
+
+void accumulateHistogram(const uint8_t* data, size_t size, std::array<uint64_t, 256>& histogram)
+{
+	/*Four interleaved sub-histograms, so runs of the same byte value increment different
+	counters and don't wait on each other's stores.  Counts are merged at the end.  They live
+	on the stack, the streamed path calls this once per window.*/
+	uint32_t counts[4][256];
+	uint32_t* sub0 = counts[0];
+	uint32_t* sub1 = counts[1];
+	uint32_t* sub2 = counts[2];
+	uint32_t* sub3 = counts[3];
+
+	size_t idx = 0;
+	while (idx < size)
+	{
+		memset(counts, 0, sizeof(counts));
+
+		/*32-bit sub-counters can't overflow within a 4 GiB block*/
+		const size_t blockEnd = idx + std::min<size_t>(size - idx, size_t(0xffffffff) & ~size_t(7));
+
+		for (; idx + 8 <= blockEnd; idx += 8)
+		{
+			uint64_t word;
+			memcpy(&word, data + idx, sizeof(word));
+
+			++sub0[word & 0xff];
+			++sub1[(word >> 8) & 0xff];
+			++sub2[(word >> 16) & 0xff];
+			++sub3[(word >> 24) & 0xff];
+			++sub0[(word >> 32) & 0xff];
+			++sub1[(word >> 40) & 0xff];
+			++sub2[(word >> 48) & 0xff];
+			++sub3[word >> 56];
+		}
+
+		for (; idx < blockEnd; ++idx)
+		{
+			++sub0[data[idx]];
+		}
+
+		for (size_t value = 0; value < 256; ++value)
+		{
+			histogram[value] += uint64_t(sub0[value]) + sub1[value] + sub2[value] + sub3[value];
+		}
+	}
+}
+
+std::vector<uint8_t> commonBytes(const std::array<uint64_t, 256>& histogram, size_t count)
+{
+	std::vector<uint8_t> values;
+	for (size_t value = 0; value < 256; ++value)
+	{
+		if (histogram[value] != 0)
+		{
+			values.push_back(static_cast<uint8_t>(value));
+		}
+	}
+
+	count = std::min(count, values.size());
+	std::partial_sort(values.begin(), values.begin() + count, values.end(), [&histogram](uint8_t lhs, uint8_t rhs)
+	{
+		return histogram[lhs] > histogram[rhs] || (histogram[lhs] == histogram[rhs] && lhs < rhs);
+	});
+	values.resize(count);
+
+	return values;
+}
+
+double shannonEntropy(const std::array<uint64_t, 256>& histogram, uint64_t size)
+{
+	if (size == 0)
+	{
+		return 0.0;
+	}
+
+	double entropy = 0.0;
+	for (uint64_t count : histogram)
+	{
+		if (count != 0)
+		{
+			const double probability = double(count) / double(size);
+			entropy -= probability * std::log2(probability);
+		}
+	}
+
+	return entropy;
+}
+
+std::vector<SectionProfile> profileSections(const std::string& fileName, const MachImage& image, bool serial)
+{
+	std::vector<SectionProfile> profiles(image.sections.size(), SectionProfile{ {}, 0, 0.0, 0.0 });
+
+	/*Chunks of each section are kept contiguous so the printable runs can be stitched per section*/
+	std::vector<Chunk> chunks;
+	std::vector<size_t> firstChunk(image.sections.size() + 1);
+	for (size_t sectionIdx = 0; sectionIdx < image.sections.size(); ++sectionIdx)
+	{
+		firstChunk[sectionIdx] = chunks.size();
+
+		if (!hasFileContents(image, sectionIdx))
+		{
+			continue;
+		}
+		const Section& sect = image.sections[sectionIdx];
+
+		for (uint64_t done = 0; done < sect.size; done += ChunkSize)
+		{
+			chunks.push_back({ sectionIdx, sect.offset + done, static_cast<size_t>(std::min<uint64_t>(ChunkSize, sect.size - done)) });
+		}
+	}
+	firstChunk[image.sections.size()] = chunks.size();
+
+	std::vector<ChunkResult> results(chunks.size());
+	std::atomic<size_t> nextChunk(0);
+
+	auto worker = [&]()
+	{
+		std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+		std::vector<uint8_t> buffer(ChunkSize);
+
+		for (size_t idx = nextChunk++; idx < chunks.size(); idx = nextChunk++)
+		{
+			fin.clear();
+			fin.seekg(chunks[idx].offset, std::ios_base::beg);
+			fin.read((char*)buffer.data(), chunks[idx].size);
+			const size_t read = static_cast<size_t>(fin.gcount());
+
+			results[idx].histogram.fill(0);
+			accumulateHistogram(buffer.data(), read, results[idx].histogram);
+			RunTracker tracker;
+			scanPrintable(buffer.data(), read, tracker);
+			results[idx].runs = tracker.finish();
+			chunks[idx].size = read;
+		}
+	};
+
+	const size_t threadCount = serial ? 1 : std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), chunks.size()));
+	std::vector<std::thread> workers;
+	for (size_t idx = 1; idx < threadCount; ++idx)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+
+	for (size_t sectionIdx = 0; sectionIdx < image.sections.size(); ++sectionIdx)
+	{
+		SectionProfile& profile = profiles[sectionIdx];
+		for (size_t idx = firstChunk[sectionIdx]; idx < firstChunk[sectionIdx + 1]; ++idx)
+		{
+			profile.size += chunks[idx].size;
+			for (size_t value = 0; value < 256; ++value)
+			{
+				profile.histogram[value] += results[idx].histogram[value];
+			}
+		}
+
+		profile.entropy = shannonEntropy(profile.histogram, profile.size);
+		if (profile.size != 0)
+		{
+			profile.printableDensity = double(printableBytes(results, chunks, firstChunk[sectionIdx], firstChunk[sectionIdx + 1])) / double(profile.size);
+		}
+	}
+
+	return profiles;
+}
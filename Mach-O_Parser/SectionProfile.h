@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+#include "Decoder.h"
+
+/*Byte level statistics of one section, used to spot packed, encrypted or obfuscated content*/
+struct SectionProfile
+{
+	std::array<uint64_t, 256>	histogram;
+	uint64_t					size;
+	double						entropy;			/*Shannon entropy in bits per byte, 0 to 8*/
+	double						printableDensity;	/*fraction of bytes inside runs of at least MinimumStringLength printable characters*/
+};
+
+/*Builds a profile from consecutive pieces of one section, for callers that see the
+section a window at a time rather than all at once*/
+class SectionProfiler
+{
+public:
+	void accumulate(const uint8_t* data, size_t size);
+	SectionProfile finish();
+
+	/*Printable run tracking, called back by the byte classifier*/
+	void extend(uint64_t length) { currentRun += length; }
+	void close();
+
+private:
+	SectionProfile	profile = { {}, 0, 0.0, 0.0 };
+	uint64_t		currentRun = 0;
+	uint64_t		printable = 0;
+};
+
+/*Counts every byte of data into histogram, which is added to rather than cleared*/
+void accumulateHistogram(const uint8_t* data, size_t size, std::array<uint64_t, 256>& histogram);
+
+/*The count most frequent byte values, most frequent first and the lower value first on a tie.
+Values that never occur are left out.*/
+std::vector<uint8_t> commonBytes(const std::array<uint64_t, 256>& histogram, size_t count);
+
+double shannonEntropy(const std::array<uint64_t, 256>& histogram, uint64_t size);
+
+/*Profiles every section with file contents, one entry per MachImage::sections element.
+The sections are cut into fixed size chunks that worker threads read through their own streams,
+or the calling thread reads alone when serial.*/
+std::vector<SectionProfile> profileSections(const std::string& fileName, const MachImage& image, bool serial = false);
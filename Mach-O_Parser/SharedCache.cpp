@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "Arena.h"
+#include "Reader.h"
+#include "SharedCache.h"
+#include "SymbolTable.h"
+
+namespace
+{
+	const char CacheMagicPrefix[] = "dyld_v";
+	const size_t MaximumPathLength = 1024;
+
+	bool hasCacheMagic(const char (&magic)[16])
+	{
+		return std::string_view(magic, strnlen(magic, sizeof(magic))).rfind(CacheMagicPrefix, 0) == 0;
+	}
+}
+
+SharedCache::SharedCache(const std::string& fileName)
+{
+	std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+
+	/*Older caches write a shorter header and put the mappings straight after it, so only
+	the first mappingOffset bytes belong to the header and the rest stays zeroed*/
+	memset(&cacheHeader, 0, sizeof(cacheHeader));
+	auto raw = readArrayAt<char>(fin, 0, sizeof(cacheHeader));
+	memcpy(&cacheHeader, raw.data(), raw.size());
+
+	if (raw.size() < offsetof(dyld_cache_header, dyldBaseAddress) || !hasCacheMagic(cacheHeader.magic))
+	{
+		throw std::runtime_error("not a dyld shared cache");
+	}
+
+	const size_t headerSize = std::min<size_t>(cacheHeader.mappingOffset, sizeof(cacheHeader));
+	memset(reinterpret_cast<char*>(&cacheHeader) + headerSize, 0, sizeof(cacheHeader) - headerSize);
+
+	/*A split cache maps most images from its .01, .02 ... files, which this file alone can't resolve*/
+	if (cacheHeader.subCacheArrayCount != 0)
+	{
+		throw std::runtime_error("split dyld shared caches are not supported, this cache has " + std::to_string(cacheHeader.subCacheArrayCount) + " sub caches");
+	}
+
+	cacheMappings = readArrayAt<dyld_cache_mapping_info>(fin, cacheHeader.mappingOffset, cacheHeader.mappingCount);
+	std::sort(cacheMappings.begin(), cacheMappings.end(),
+		[](const dyld_cache_mapping_info& lhs, const dyld_cache_mapping_info& rhs) { return lhs.address < rhs.address; });
+
+	/*The image table moved when imagesOffsetOld was retired, newer headers zero the old fields*/
+	const bool movedImages = headerSize >= offsetof(dyld_cache_header, imagesCount) + sizeof(cacheHeader.imagesCount);
+	const uint32_t imagesOffset = movedImages ? cacheHeader.imagesOffset : cacheHeader.imagesOffsetOld;
+	const uint32_t imagesCount = movedImages ? cacheHeader.imagesCount : cacheHeader.imagesCountOld;
+	images = readArrayAt<dyld_cache_image_info>(fin, imagesOffset, imagesCount);
+
+	/*A private arena, the caller's worker arena may hold buffers of its own*/
+	Arena pathArena(2 * MaximumPathLength);
+	paths.reserve(images.size());
+	for (const auto& image : images)
+	{
+		auto path = readArrayAt<char>(fin, image.pathFileOffset, MaximumPathLength, ArenaAllocator<char>(pathArena));
+		paths.push_back(corpusNames().intern(std::string_view(path.data(), strnlen(path.data(), path.size()))));
+		pathArena.reset();
+	}
+}
+
+std::optional<uint64_t> SharedCache::fileOffset(uint64_t address) const
+{
+	auto mapping = std::upper_bound(cacheMappings.begin(), cacheMappings.end(), address,
+		[](uint64_t value, const dyld_cache_mapping_info& info) { return value < info.address; });
+
+	if (mapping == cacheMappings.begin())
+	{
+		return std::nullopt;
+	}
+
+	--mapping;
+	if (address - mapping->address >= mapping->size)
+	{
+		return std::nullopt;
+	}
+
+	return mapping->fileOffset + (address - mapping->address);
+}
+
+bool isSharedCache(const std::string& fileName)
+{
+	std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+	auto magic = readArrayAt<char>(fin, 0, sizeof(dyld_cache_header::magic));
+	if (magic.size() != sizeof(dyld_cache_header::magic))
+	{
+		return false;
+	}
+
+	char fixed[sizeof(dyld_cache_header::magic)];
+	memcpy(fixed, magic.data(), sizeof(fixed));
+	return hasCacheMagic(fixed);
+}
+
+void decodeSharedCache(const std::string& inputFileName, const std::string& outputFileName, const DecodeOptions& options)
+{
+	const SharedCache cache(inputFileName);
+	std::vector<std::string> results(cache.imageCount());
+
+	/*Images are already spread across the workers, each one decodes its image alone.  Every image's
+	LC_SYMTAB points at the cache's one string pool, which is read once rather than once per image.*/
+	SharedStringTables sharedStrings;
+	DecodeOptions imageOptions = options;
+	imageOptions.serial = true;
+	imageOptions.sharedStrings = &sharedStrings;
+	std::atomic<size_t> nextImage(0);
+
+	/*Each image only reads its own load commands and the ranges they point at, so workers
+	decode them independently through their own streams and the output is joined in order*/
+	auto worker = [&]()
+	{
+		std::ifstream fin(inputFileName.c_str(), std::ifstream::binary);
+
+		for (size_t idx = nextImage++; idx < cache.imageCount(); idx = nextImage++)
+		{
+			std::ostringstream out;
+			out << "Image : " << cache.imagePath(idx) << std::endl;
+
+			const std::optional<uint64_t> headerOffset = cache.fileOffset(cache.imageAddress(idx));
+			if (!headerOffset)
+			{
+				out << "Image Header : not mapped by this cache file" << std::endl;
+				results[idx] = out.str();
+				continue;
+			}
+
+			fin.clear();
+			fin.seekg(*headerOffset, std::ios_base::beg);
+			if (readInAndReset<uint32_t>(fin) != MH_MAGIC_64)
+			{
+				out << "Image Header : not a 64-bit mach header" << std::endl;
+				results[idx] = out.str();
+				continue;
+			}
+
+			MachImage image = decodeImage(fin);
+			writeImage(fin, out, inputFileName, image, imageOptions);
+			results[idx] = out.str();
+
+			workerArena().reset();
+		}
+	};
+
+	const size_t threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), cache.imageCount()));
+	std::vector<std::thread> workers;
+	for (size_t idx = 1; idx < threadCount; ++idx)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+
+	std::ofstream fout(outputFileName.c_str(), std::ofstream::binary);
+	fout << "Shared Cache : " << std::string_view(cache.header().magic, strnlen(cache.header().magic, sizeof(cache.header().magic))) << std::endl;
+	fout << "Cache Images : " << cache.imageCount() << std::endl;
+	for (const auto& result : results)
+	{
+		fout << result;
+	}
+	fout.close();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Decoder.h"
+#include "dyld_cache_format.h"
+
+/*Header, mappings and image table of a single file dyld shared cache, split caches are refused with a runtime_error*/
+class SharedCache
+{
+public:
+	explicit SharedCache(const std::string& fileName);
+
+	const dyld_cache_header& header() const { return cacheHeader; }
+	const std::vector<dyld_cache_mapping_info>& mappings() const { return cacheMappings; }
+
+	size_t imageCount() const { return images.size(); }
+	uint64_t imageAddress(size_t index) const { return images[index].address; }
+	std::string_view imagePath(size_t index) const { return corpusNames().name(paths[index]); }
+
+	/*Translates an unslid vmaddr to the file offset it is mapped from*/
+	std::optional<uint64_t> fileOffset(uint64_t address) const;
+
+private:
+	dyld_cache_header						cacheHeader;
+	std::vector<dyld_cache_mapping_info>	cacheMappings;	/*sorted by address*/
+	std::vector<dyld_cache_image_info>		images;
+	std::vector<NameId>						paths;
+};
+
+bool isSharedCache(const std::string& fileName);
+
+/*Decodes every image of the cache on a pool of workers and writes them out in image table order*/
+void decodeSharedCache(const std::string& inputFileName, const std::string& outputFileName, const DecodeOptions& options);
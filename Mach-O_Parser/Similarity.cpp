@@ -0,0 +1,615 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+#include "Arena.h"
+#include "ExportsTrie.h"
+#include "Reader.h"
+#include "Similarity.h"
+#include "SymbolTable.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMILARITY_USE_SSE2 1
+#endif
+
+namespace
+{
+	const size_t ChunkSize = 1 << 20;
+	const size_t ShingleSize = 8;
+
+	const uint64_t ImportTag = 0x696d706f72740000ULL;
+	const uint64_t ExportTag = 0x6578706f72740000ULL;
+
+	/*MurmurHash3's 64-bit finalizer, spreads every input bit over the whole word*/
+	uint64_t mix64(uint64_t value)
+	{
+		value ^= value >> 33;
+		value *= 0xff51afd7ed558ccdULL;
+		value ^= value >> 33;
+		value *= 0xc4ceb9fe1a85ec53ULL;
+		value ^= value >> 33;
+		return value;
+	}
+
+	uint64_t hashName(std::string_view name, uint64_t tag)
+	{
+		uint64_t hash = 0xcbf29ce484222325ULL ^ tag;	/*FNV-1a*/
+		for (char character : name)
+		{
+			hash = (hash ^ uint8_t(character)) * 0x100000001b3ULL;
+		}
+		return mix64(hash);
+	}
+
+	/*Slot i applies x -> a[i] * x + b[i] mod 2^32, a bijection because every a[i] is odd*/
+	struct Permutations
+	{
+		alignas(16) uint32_t multipliers[MinHashSize];
+		alignas(16) uint32_t increments[MinHashSize];
+
+		Permutations()
+		{
+			uint64_t state = 0x9e3779b97f4a7c15ULL;	/*fixed seed, signatures must be comparable across runs*/
+			for (size_t idx = 0; idx < MinHashSize; ++idx)
+			{
+				state += 0x9e3779b97f4a7c15ULL;
+				const uint64_t random = mix64(state);
+				multipliers[idx] = static_cast<uint32_t>(random) | 1;
+				increments[idx] = static_cast<uint32_t>(random >> 32);
+			}
+		}
+	};
+
+	const Permutations& permutations()
+	{
+		static const Permutations instance;
+		return instance;
+	}
+
+#ifdef SIMILARITY_USE_SSE2
+	/*SSE2 has neither a 32-bit low multiply nor an unsigned 32-bit minimum, both are built from what it does have*/
+	__m128i multiplyLow32(__m128i lhs, __m128i rhs)
+	{
+		const __m128i even = _mm_mul_epu32(lhs, rhs);
+		const __m128i odd = _mm_mul_epu32(_mm_srli_si128(lhs, 4), _mm_srli_si128(rhs, 4));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	__m128i minimumUnsigned32(__m128i lhs, __m128i rhs)
+	{
+		const __m128i bias = _mm_set1_epi32(int(0x80000000));
+		const __m128i less = _mm_cmplt_epi32(_mm_xor_si128(lhs, bias), _mm_xor_si128(rhs, bias));
+		return _mm_or_si128(_mm_and_si128(less, lhs), _mm_andnot_si128(less, rhs));
+	}
+#endif
+
+	/*Chosen for findSimilar's 0.5 threshold, a pair at Jaccard similarity s shares a band with
+	probability 1 - (1 - s^2)^32: above 99.9% at 0.5, 95% at 0.3 and 27% at 0.1.  Four row bands
+	would find only 64% of the pairs at 0.5.*/
+	const size_t BandRows = 2;
+	const size_t BandCount = MinHashSize / BandRows;
+
+	/*Index file layout: the header, one StoredImage per image, the sorted band entries, then the paths*/
+	const char IndexMagic[8] = { 'M', 'H', 'S', 'I', 'M', 'I', 'D', 'X' };
+	const uint32_t IndexVersion = 1;
+
+	struct IndexHeader
+	{
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	bandRows;		/*a different banding would file the same signature under other keys*/
+		uint64_t	imageCount;
+		uint64_t	bandCount;
+		uint64_t	imagesOffset;
+		uint64_t	bandsOffset;
+	};
+
+	struct StoredImage
+	{
+		MinHash		code;
+		MinHash		names;
+		uint64_t	pathOffset;
+		uint32_t	pathLength;
+		uint8_t		hasCode;
+		uint8_t		hasNames;
+		uint16_t	reserved;
+	};
+
+	uint64_t bandKey(const MinHash& signature, size_t band, uint64_t kind)
+	{
+		uint64_t key = mix64((kind << 32) | band);
+		for (size_t row = 0; row < BandRows; ++row)
+		{
+			key = mix64(key ^ signature[band * BandRows + row]);
+		}
+
+		return key;
+	}
+
+	/*Every image filed under any of signature's band keys, imagesWithKey(key, found) appends those for one key*/
+	template <typename KeyLookup>
+	std::vector<uint32_t> collectCandidates(const ImageSignature& signature, KeyLookup&& imagesWithKey)
+	{
+		std::vector<uint32_t> found;
+		for (size_t band = 0; band < BandCount; ++band)
+		{
+			if (signature.hasCode)
+			{
+				imagesWithKey(bandKey(signature.code, band, 0), found);
+			}
+			if (signature.hasNames)
+			{
+				imagesWithKey(bandKey(signature.names, band, 1), found);
+			}
+		}
+
+		std::sort(found.begin(), found.end());
+		found.erase(std::unique(found.begin(), found.end()), found.end());
+		return found;
+	}
+
+	SimilarityMatch scoreMatch(const ImageSignature& signature, const ImageSignature& candidate, uint32_t image)
+	{
+		const double code = signature.hasCode && candidate.hasCode ? estimateSimilarity(signature.code, candidate.code) : 0.0;
+		const double names = signature.hasNames && candidate.hasNames ? estimateSimilarity(signature.names, candidate.names) : 0.0;
+		return { image, code, names };
+	}
+
+	void rankMatches(std::vector<SimilarityMatch>& matches)
+	{
+		std::sort(matches.begin(), matches.end(),
+			[](const SimilarityMatch& lhs, const SimilarityMatch& rhs)
+			{
+				const double lhsBest = std::max(lhs.code, lhs.names);
+				const double rhsBest = std::max(rhs.code, rhs.names);
+				return lhsBest > rhsBest || (lhsBest == rhsBest && (lhs.code + lhs.names > rhs.code + rhs.names
+					|| (lhs.code + lhs.names == rhs.code + rhs.names && lhs.image < rhs.image)));
+			});
+	}
+}
+
+MinHasher::MinHasher()
+{
+	mins.fill(0xffffffff);
+}
+
+void MinHasher::add(uint64_t elementHash)
+{
+	const uint32_t element = static_cast<uint32_t>(elementHash ^ (elementHash >> 32));
+	const Permutations& slots = permutations();
+	++elements;
+
+#ifdef SIMILARITY_USE_SSE2
+	/*Four permutations per step, the element is broadcast to every lane*/
+	const __m128i broadcast = _mm_set1_epi32(int(element));
+	for (size_t idx = 0; idx < MinHashSize; idx += 4)
+	{
+		const __m128i multiplier = _mm_load_si128(reinterpret_cast<const __m128i*>(slots.multipliers + idx));
+		const __m128i increment = _mm_load_si128(reinterpret_cast<const __m128i*>(slots.increments + idx));
+		const __m128i permuted = _mm_add_epi32(multiplyLow32(multiplier, broadcast), increment);
+
+		__m128i* current = reinterpret_cast<__m128i*>(mins.data() + idx);
+		_mm_storeu_si128(current, minimumUnsigned32(permuted, _mm_loadu_si128(current)));
+	}
+#else
+	for (size_t idx = 0; idx < MinHashSize; ++idx)
+	{
+		mins[idx] = std::min(mins[idx], slots.multipliers[idx] * element + slots.increments[idx]);
+	}
+#endif
+}
+
+void MinHasher::addShingles(const uint8_t* data, size_t size)
+{
+	/*Shingles that start in the bytes carried from the previous call*/
+	if (carried != 0)
+	{
+		uint8_t joined[2 * (ShingleSize - 1)];
+		const size_t taken = std::min(size, ShingleSize - 1);
+		memcpy(joined, carry, carried);
+		memcpy(joined + carried, data, taken);
+
+		for (size_t start = 0; start + ShingleSize <= carried + taken && start < carried; ++start)
+		{
+			uint64_t word;
+			memcpy(&word, joined + start, sizeof(word));
+			add(mix64(word));
+		}
+
+		if (carried + size < ShingleSize)
+		{
+			memcpy(carry + carried, data, size);
+			carried += size;
+			return;
+		}
+	}
+
+	for (size_t start = 0; start + ShingleSize <= size; ++start)
+	{
+		uint64_t word;
+		memcpy(&word, data + start, sizeof(word));
+		add(mix64(word));
+	}
+
+	/*Keep the tail for shingles that straddle into the next call*/
+	if (size >= ShingleSize - 1)
+	{
+		memcpy(carry, data + size - (ShingleSize - 1), ShingleSize - 1);
+		carried = ShingleSize - 1;
+	}
+	else
+	{
+		const size_t keep = std::min(carried, ShingleSize - 1 - size);
+		memmove(carry, carry + carried - keep, keep);
+		memcpy(carry + keep, data, size);
+		carried = keep + size;
+	}
+}
+
+double estimateSimilarity(const MinHash& lhs, const MinHash& rhs)
+{
+	size_t equal = 0;
+	for (size_t idx = 0; idx < MinHashSize; ++idx)
+	{
+		equal += lhs[idx] == rhs[idx];
+	}
+
+	return double(equal) / double(MinHashSize);
+}
+
+std::optional<ImageSignature> signImage(const std::string& fileName)
+{
+	std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+	if (readInAndReset<uint32_t>(fin) != MH_MAGIC_64 || !fin)
+	{
+		return std::nullopt;
+	}
+
+	const MachImage image = decodeImage(fin);
+
+	MinHasher code;
+	std::vector<uint8_t> buffer(ChunkSize);
+	for (size_t idx = 0; idx < image.sections.size(); ++idx)
+	{
+		const Section& sect = image.sections[idx];
+		if (corpusNames().name(sect.segmentName) != "__TEXT" || !hasFileContents(image, idx))
+		{
+			continue;
+		}
+
+		code.resetShingles();
+		fin.clear();
+		fin.seekg(sect.offset, std::ios_base::beg);
+		for (uint64_t done = 0; done < sect.size;)
+		{
+			fin.read((char*)buffer.data(), static_cast<std::streamsize>(std::min<uint64_t>(ChunkSize, sect.size - done)));
+			const size_t read = static_cast<size_t>(fin.gcount());
+			if (read == 0)
+			{
+				break;
+			}
+			code.addShingles(buffer.data(), read);
+			done += read;
+		}
+	}
+
+	/*Imports and exports are hashed with different tags, so importing a name doesn't match exporting it*/
+	std::vector<uint64_t> nameHashes;
+	if (const symtab_command* symtab = findCommand<symtab_command>(image))
+	{
+		fin.clear();
+		SymbolTable symbols(fin, *symtab);
+		for (size_t idx = 0; idx < symbols.size(); ++idx)
+		{
+			const uint8_t type = symbols[idx].n_type;
+			if (!(type & N_STAB) && (type & N_EXT) && (type & N_TYPE) == N_UNDF)
+			{
+				nameHashes.push_back(hashName(symbols.name(idx), ImportTag));
+			}
+		}
+	}
+
+	/*Hashed straight from the trie, interning a corpus worth of export names would only grow corpusNames()*/
+	fin.clear();
+	const std::pair<uint64_t, uint64_t> trieRange = exportsTrieRange(image);
+	const auto trie = readArrayAt<uint8_t>(fin, trieRange.first, static_cast<size_t>(trieRange.second), ArenaAllocator<uint8_t>(workerArena()));
+	for (std::string_view name : exportedNames(trie))
+	{
+		nameHashes.push_back(hashName(name, ExportTag));
+	}
+
+	std::sort(nameHashes.begin(), nameHashes.end());
+	nameHashes.erase(std::unique(nameHashes.begin(), nameHashes.end()), nameHashes.end());
+
+	MinHasher names;
+	for (uint64_t hash : nameHashes)
+	{
+		names.add(hash);
+	}
+
+	workerArena().reset();
+	return ImageSignature{ code.signature(), names.signature(), !code.empty(), !names.empty() };
+}
+
+std::vector<std::optional<ImageSignature>> signImages(const std::vector<std::string>& fileNames)
+{
+	std::vector<std::optional<ImageSignature>> signatures(fileNames.size());
+	std::atomic<size_t> nextFile(0);
+
+	auto worker = [&]()
+	{
+		for (size_t idx = nextFile++; idx < fileNames.size(); idx = nextFile++)
+		{
+			/*A file that can't be decoded is left out like any other file that isn't an image*/
+			try
+			{
+				signatures[idx] = signImage(fileNames[idx]);
+			}
+			catch (const std::exception&)
+			{
+				signatures[idx] = std::nullopt;
+			}
+		}
+	};
+
+	const size_t threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), fileNames.size()));
+	std::vector<std::thread> workers;
+	for (size_t idx = 1; idx < threadCount; ++idx)
+	{
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : workers)
+	{
+		thread.join();
+	}
+
+	return signatures;
+}
+
+
+uint32_t SimilarityIndex::add(const ImageSignature& signature)
+{
+	const uint32_t image = static_cast<uint32_t>(signatures.size());
+	signatures.push_back(signature);
+
+	/*Empty signatures are all 0xffffffff and would share every band, so they aren't filed*/
+	for (size_t band = 0; band < BandCount; ++band)
+	{
+		if (signature.hasCode)
+		{
+			bands.push_back({ bandKey(signature.code, band, 0), image, 0 });
+		}
+		if (signature.hasNames)
+		{
+			bands.push_back({ bandKey(signature.names, band, 1), image, 0 });
+		}
+	}
+
+	return image;
+}
+
+void SimilarityIndex::freeze()
+{
+	std::sort(bands.begin(), bands.end());
+}
+
+std::vector<SimilarityMatch> SimilarityIndex::query(const ImageSignature& signature, double threshold) const
+{
+	const std::vector<uint32_t> found = collectCandidates(signature, [this](uint64_t key, std::vector<uint32_t>& images)
+	{
+		auto first = std::lower_bound(bands.begin(), bands.end(), BandEntry{ key, 0, 0 });
+		for (auto entry = first; entry != bands.end() && entry->key == key; ++entry)
+		{
+			images.push_back(entry->image);
+		}
+	});
+
+	std::vector<SimilarityMatch> matches;
+	for (uint32_t image : found)
+	{
+		const SimilarityMatch match = scoreMatch(signature, signatures[image], image);
+		if (match.code >= threshold || match.names >= threshold)
+		{
+			matches.push_back(match);
+		}
+	}
+
+	rankMatches(matches);
+	return matches;
+}
+
+void SimilarityIndex::write(const std::string& fileName, const std::vector<std::string>& paths) const
+{
+	IndexHeader header = {};
+	memcpy(header.magic, IndexMagic, sizeof(header.magic));
+	header.version = IndexVersion;
+	header.bandRows = BandRows;
+	header.imageCount = signatures.size();
+	header.bandCount = bands.size();
+	header.imagesOffset = sizeof(IndexHeader);
+	header.bandsOffset = header.imagesOffset + signatures.size() * sizeof(StoredImage);
+
+	std::ofstream fout(fileName.c_str(), std::ofstream::binary);
+	fout.write((const char*)&header, sizeof(header));
+
+	uint64_t pathOffset = header.bandsOffset + bands.size() * sizeof(BandEntry);
+	for (size_t idx = 0; idx < signatures.size(); ++idx)
+	{
+		const ImageSignature& signature = signatures[idx];
+		const std::string& path = idx < paths.size() ? paths[idx] : std::string();
+		const StoredImage stored = { signature.code, signature.names, pathOffset, static_cast<uint32_t>(path.size()),
+			uint8_t(signature.hasCode), uint8_t(signature.hasNames), 0 };
+		fout.write((const char*)&stored, sizeof(stored));
+		pathOffset += path.size();
+	}
+
+	fout.write((const char*)bands.data(), static_cast<std::streamsize>(bands.size() * sizeof(BandEntry)));
+	for (size_t idx = 0; idx < signatures.size() && idx < paths.size(); ++idx)
+	{
+		fout.write(paths[idx].data(), static_cast<std::streamsize>(paths[idx].size()));
+	}
+
+	fout.close();
+	if (!fout)
+	{
+		throw std::runtime_error("couldn't write the similarity index " + fileName);
+	}
+}
+
+StoredSimilarityIndex::StoredSimilarityIndex(const std::string& fileName)
+	: fin(fileName.c_str(), std::ifstream::binary)
+{
+	fin.seekg(0, std::ios_base::end);
+	const std::streamoff end = fin.tellg();
+	fileSize = end > 0 ? uint64_t(end) : 0;
+
+	IndexHeader header;
+	if (!readAt(0, header) || memcmp(header.magic, IndexMagic, sizeof(header.magic)) != 0
+		|| header.version != IndexVersion || header.bandRows != BandRows)
+	{
+		throw std::runtime_error(fileName + " is not a similarity index");
+	}
+
+	/*Both tables have to lie inside the file, the counts can't be trusted any further than that*/
+	imageCount = header.imageCount;
+	bandCount = header.bandCount;
+	imagesOffset = header.imagesOffset;
+	bandsOffset = header.bandsOffset;
+	if (imageCount > fileSize / sizeof(StoredImage) || bandCount > fileSize / sizeof(SimilarityIndex::BandEntry)
+		|| imagesOffset > fileSize - imageCount * sizeof(StoredImage) || bandsOffset > fileSize - bandCount * sizeof(SimilarityIndex::BandEntry))
+	{
+		throw std::runtime_error(fileName + " is a truncated similarity index");
+	}
+}
+
+template <typename Structure>
+bool StoredSimilarityIndex::readAt(uint64_t offset, Structure& structure)
+{
+	fin.clear();
+	fin.seekg(static_cast<std::streamoff>(offset), std::ios_base::beg);
+	fin.read((char*)&structure, sizeof(structure));
+	return fin.gcount() == sizeof(structure);
+}
+
+std::vector<SimilarityMatch> StoredSimilarityIndex::query(const ImageSignature& signature, double threshold)
+{
+	typedef SimilarityIndex::BandEntry BandEntry;
+
+	/*Each key is a binary search over the stored band table, a few small reads rather than a load of it*/
+	const std::vector<uint32_t> found = collectCandidates(signature, [this](uint64_t key, std::vector<uint32_t>& images)
+	{
+		uint64_t low = 0;
+		uint64_t high = bandCount;
+		BandEntry entry;
+		while (low < high)
+		{
+			const uint64_t middle = low + (high - low) / 2;
+			if (!readAt(bandsOffset + middle * sizeof(BandEntry), entry))
+			{
+				return;
+			}
+			if (entry.key < key)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		for (uint64_t idx = low; idx < bandCount && readAt(bandsOffset + idx * sizeof(BandEntry), entry) && entry.key == key; ++idx)
+		{
+			images.push_back(entry.image);
+		}
+	});
+
+	std::vector<SimilarityMatch> matches;
+	for (uint32_t image : found)
+	{
+		StoredImage stored;
+		if (image >= imageCount || !readAt(imagesOffset + image * sizeof(StoredImage), stored))
+		{
+			continue;
+		}
+
+		const ImageSignature candidate = { stored.code, stored.names, stored.hasCode != 0, stored.hasNames != 0 };
+		const SimilarityMatch match = scoreMatch(signature, candidate, image);
+		if (match.code >= threshold || match.names >= threshold)
+		{
+			matches.push_back(match);
+		}
+	}
+
+	rankMatches(matches);
+	return matches;
+}
+
+std::string StoredSimilarityIndex::path(uint32_t image)
+{
+	StoredImage stored;
+	if (image >= imageCount || !readAt(imagesOffset + image * sizeof(StoredImage), stored)
+		|| stored.pathOffset > fileSize || stored.pathLength > fileSize - stored.pathOffset)
+	{
+		return std::string();
+	}
+
+	std::string path(stored.pathLength, '\0');
+	fin.clear();
+	fin.seekg(static_cast<std::streamoff>(stored.pathOffset), std::ios_base::beg);
+	fin.read(&path[0], stored.pathLength);
+	return path;
+}
+
+void buildSimilarityIndex(const std::string& corpusDirectory, const std::string& indexFileName)
+{
+	std::vector<std::string> fileNames;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(corpusDirectory, std::filesystem::directory_options::skip_permission_denied))
+	{
+		if (entry.is_regular_file())
+		{
+			fileNames.push_back(entry.path().string());
+		}
+	}
+
+	const std::vector<std::optional<ImageSignature>> signatures = signImages(fileNames);
+
+	SimilarityIndex index;
+	std::vector<std::string> indexedFiles;
+	for (size_t idx = 0; idx < signatures.size(); ++idx)
+	{
+		if (signatures[idx])
+		{
+			index.add(*signatures[idx]);
+			indexedFiles.push_back(fileNames[idx]);
+		}
+	}
+	index.freeze();
+	index.write(indexFileName, indexedFiles);
+}
+
+void findSimilar(const std::string& imageFileName, const std::string& indexFileName, const std::string& outputFileName, double threshold)
+{
+	StoredSimilarityIndex index(indexFileName);
+
+	std::ofstream fout(outputFileName.c_str(), std::ofstream::binary);
+	fout << "Corpus Images : " << index.size() << std::endl;
+
+	const std::optional<ImageSignature> target = signImage(imageFileName);
+	if (target)
+	{
+		for (const auto& match : index.query(*target, threshold))
+		{
+			fout << "Similar : " << index.path(match.image) << std::fixed << std::setprecision(3)
+				<< " code " << match.code << " names " << match.names << std::endl;
+		}
+	}
+
+	fout.close();
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Decoder.h"
+
+const size_t MinHashSize = 64;
+
+/*Minimum of each of MinHashSize hash permutations over a set, two signatures agree in about
+the same fraction of slots as the sets' Jaccard similarity*/
+typedef std::array<uint32_t, MinHashSize> MinHash;
+
+/*Builds a MinHash from set elements that have already been hashed to 64 bits*/
+class MinHasher
+{
+public:
+	MinHasher();
+
+	void add(uint64_t elementHash);
+
+	/*Adds every 8 byte shingle of data, carrying the last 7 bytes over to the next call so
+	a section can be fed in pieces.  resetShingles() starts a new, unrelated byte run.*/
+	void addShingles(const uint8_t* data, size_t size);
+	void resetShingles() { carried = 0; }
+
+	bool empty() const { return elements == 0; }
+	const MinHash& signature() const { return mins; }
+
+private:
+	MinHash		mins;
+	uint64_t	elements = 0;
+	uint8_t		carry[7];
+	size_t		carried = 0;
+};
+
+struct ImageSignature
+{
+	MinHash		code;		/*byte shingles of the __TEXT sections*/
+	MinHash		names;		/*imported and exported symbol names*/
+	bool		hasCode;
+	bool		hasNames;
+};
+
+double estimateSimilarity(const MinHash& lhs, const MinHash& rhs);
+
+/*Decodes fileName and signs it, nothing for files that aren't 64-bit Mach-O images*/
+std::optional<ImageSignature> signImage(const std::string& fileName);
+
+/*Signs every file on a pool of workers, results are parallel to fileNames.  Files that fail to
+decode are left as nothing rather than ending the run.*/
+std::vector<std::optional<ImageSignature>> signImages(const std::vector<std::string>& fileNames);
+
+struct SimilarityMatch
+{
+	uint32_t	image;
+	double		code;
+	double		names;
+};
+
+/*Locality sensitive hashing over MinHash bands.  Each signature is cut into 32 bands of two
+slots and filed under each band's hash, so images sharing any whole band become candidates and
+a query only looks at those rather than the whole corpus.  Band tables are sorted arrays,
+built once by freeze() after the last add().*/
+class SimilarityIndex
+{
+public:
+	uint32_t add(const ImageSignature& signature);
+	void freeze();
+
+	size_t size() const { return signatures.size(); }
+
+	/*Images whose code or name similarity to signature reaches threshold, most similar first*/
+	std::vector<SimilarityMatch> query(const ImageSignature& signature, double threshold) const;
+
+	/*Writes the frozen index for StoredSimilarityIndex, paths names each image in add() order*/
+	void write(const std::string& fileName, const std::vector<std::string>& paths) const;
+
+private:
+	friend class StoredSimilarityIndex;
+
+	struct BandEntry
+	{
+		uint64_t	key;		/*band index and slots hashed together*/
+		uint32_t	image;
+		uint32_t	reserved;	/*written as is, keeps the stored entry free of padding*/
+
+		bool operator<(const BandEntry& other) const { return key < other.key || (key == other.key && image < other.image); }
+	};
+
+	std::vector<ImageSignature>	signatures;
+	std::vector<BandEntry>		bands;		/*code and name bands of every image, sorted by key once frozen*/
+};
+
+/*An index file written by SimilarityIndex::write, queried where it lies.  A query binary searches
+the stored band tables and reads only the candidates' signatures, so it costs about the number of
+candidates and the log of the corpus size rather than the corpus.*/
+class StoredSimilarityIndex
+{
+public:
+	/*Throws std::runtime_error for files that aren't a similarity index*/
+	explicit StoredSimilarityIndex(const std::string& fileName);
+
+	size_t size() const { return static_cast<size_t>(imageCount); }
+
+	std::vector<SimilarityMatch> query(const ImageSignature& signature, double threshold);
+	std::string path(uint32_t image);
+
+private:
+	template <typename Structure>
+	bool readAt(uint64_t offset, Structure& structure);
+
+	std::ifstream	fin;
+	uint64_t		imageCount;
+	uint64_t		bandCount;
+	uint64_t		imagesOffset;
+	uint64_t		bandsOffset;
+	uint64_t		fileSize;
+};
+
+/*Signs every 64-bit Mach-O file under corpusDirectory and writes the index of them to indexFileName*/
+void buildSimilarityIndex(const std::string& corpusDirectory, const std::string& indexFileName);
+
+/*Signs imageFileName alone and writes the indexed images similar to it*/
+void findSimilar(const std::string& imageFileName, const std::string& indexFileName, const std::string& outputFileName, double threshold = 0.5);
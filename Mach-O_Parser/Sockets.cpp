@@ -0,0 +1,100 @@
+#include <stdexcept>
+#ifdef _WIN32
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#else
+#include <csignal>
+#endif
+#include "Sockets.h"
+
+SocketLibrary::SocketLibrary()
+{
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		throw std::runtime_error("WSAStartup failed");
+	}
+
+#ifndef _WIN32
+	signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+SocketLibrary::~SocketLibrary()
+{
+	WSACleanup();
+}
+
+bool setNonBlocking(SOCKET socket)
+{
+	u_long mode = 1;
+	return ioctlsocket(socket, FIONBIO, &mode) != SOCKET_ERROR;
+}
+
+#ifdef _WIN32
+bool socketPair(SOCKET& first, SOCKET& second)
+{
+	static std::atomic<unsigned> nextPair(0);
+	const std::string path = (std::filesystem::temp_directory_path() /
+		("macho-pair-" + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(nextPair++))).string();
+
+	sockaddr_un address = {};
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path, path.c_str(), path.size());
+
+	SOCKET listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	std::error_code ignored;
+	std::filesystem::remove(path, ignored);
+
+	first = INVALID_SOCKET;
+	second = INVALID_SOCKET;
+	if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != SOCKET_ERROR
+		&& listen(listener, 1) != SOCKET_ERROR)
+	{
+		/*Nothing else knows the path, so the one connection the listener accepts is this one*/
+		first = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (first != INVALID_SOCKET && connect(first, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != SOCKET_ERROR)
+		{
+			second = accept(listener, nullptr, nullptr);
+		}
+	}
+
+	closesocket(listener);
+	std::filesystem::remove(path, ignored);
+
+	if (second == INVALID_SOCKET)
+	{
+		if (first != INVALID_SOCKET)
+		{
+			closesocket(first);
+		}
+		return false;
+	}
+
+	return true;
+}
+#else
+bool socketPair(SOCKET& first, SOCKET& second)
+{
+	SOCKET pair[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+	{
+		return false;
+	}
+
+	first = pair[0];
+	second = pair[1];
+	return true;
+}
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <cerrno>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*The handful of Winsock names the daemon uses, on top of their POSIX counterparts*/
+typedef int SOCKET;
+typedef pollfd WSAPOLLFD;
+typedef unsigned long u_long;
+struct WSADATA {};
+const SOCKET INVALID_SOCKET = -1;
+const int SOCKET_ERROR = -1;
+const int WSAEWOULDBLOCK = EWOULDBLOCK;
+#define MAKEWORD(low, high) ((low) | ((high) << 8))
+inline int WSAStartup(int, WSADATA*) { return 0; }
+inline int WSACleanup() { return 0; }
+inline int WSAGetLastError() { return errno == EAGAIN ? EWOULDBLOCK : errno; }
+inline int WSAPoll(WSAPOLLFD* sockets, unsigned long count, int timeout) { return poll(sockets, count, timeout); }
+inline int closesocket(SOCKET socket) { return close(socket); }
+inline int ioctlsocket(SOCKET socket, unsigned long request, u_long* argument)
+{
+	int value = static_cast<int>(*argument);
+	return ioctl(socket, request, &value);
+}
+#endif
+
+/*Starts Winsock for as long as it lives.  Outside Windows it ignores SIGPIPE instead, so a peer
+that hangs up mid-reply shows up as a failed send rather than ending the process.*/
+class SocketLibrary
+{
+public:
+	SocketLibrary();
+	~SocketLibrary();
+
+	SocketLibrary(const SocketLibrary&) = delete;
+	SocketLibrary& operator=(const SocketLibrary&) = delete;
+};
+
+bool setNonBlocking(SOCKET socket);
+
+/*A connected pair of stream sockets.  Winsock has no socketpair(), there the pair is connected
+through a listener on a temporary Unix socket path that is removed again straight away.*/
+bool socketPair(SOCKET& first, SOCKET& second);
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "Streaming.h"
+
+namespace
+{
+	const size_t MinimumWindowSize = 4096;
+
+	struct FilledWindow
+	{
+		uint64_t	offset;
+		size_t		size;
+		size_t		buffer;
+	};
+}
+
+StreamScheduler::StreamScheduler(const std::string& fileName, const StreamOptions& options)
+	: fileName(fileName), memoryLimit(options.memoryLimit), preferredWindow(options.windowSize)
+{
+	if (options.memoryLimit < 2 * MinimumWindowSize)
+	{
+		throw std::invalid_argument("stream memory limit must hold at least two windows");
+	}
+}
+
+void StreamScheduler::schedule(uint64_t offset, uint64_t size, Consumer consumer)
+{
+	if (size != 0)
+	{
+		ranges.push_back({ offset, size, std::move(consumer) });
+	}
+}
+
+bool StreamScheduler::retain(uint64_t offset, uint64_t size, ArenaVector<uint8_t>& into)
+{
+	if (!reserve(size))
+	{
+		return false;
+	}
+
+	into.assign(static_cast<size_t>(size), 0);
+	retainRange(offset, size, into.data(), [&into](size_t received) { into.resize(received); });
+
+	return true;
+}
+
+bool StreamScheduler::retain(uint64_t offset, uint64_t size, ArenaVector<uint32_t>& into)
+{
+	size -= size % sizeof(uint32_t);
+	if (!reserve(size))
+	{
+		return false;
+	}
+
+	into.assign(static_cast<size_t>(size / sizeof(uint32_t)), 0);
+	retainRange(offset, size, reinterpret_cast<uint8_t*>(into.data()), [&into](size_t received) { into.resize(received / sizeof(uint32_t)); });
+
+	return true;
+}
+
+bool StreamScheduler::reserve(uint64_t size)
+{
+	if (size > unreserved())
+	{
+		return false;
+	}
+
+	retained += size;
+	return true;
+}
+
+uint64_t StreamScheduler::unreserved() const
+{
+	return memoryLimit - retained - 2 * MinimumWindowSize;
+}
+
+void StreamScheduler::retainRange(uint64_t offset, uint64_t size, uint8_t* data, std::function<void(size_t)> trim)
+{
+	const size_t index = retainedRanges.size();
+	retainedRanges.push_back({ data, offset, 0, std::move(trim) });
+	schedule(offset, size, [this, index](uint64_t offset, const uint8_t* data, size_t size)
+	{
+		RetainedRange& range = retainedRanges[index];
+		memcpy(range.data + (offset - range.offset), data, size);
+		range.received = static_cast<size_t>(offset - range.offset) + size;
+	});
+}
+
+void StreamScheduler::run()
+{
+	std::stable_sort(ranges.begin(), ranges.end(), [](const Range& lhs, const Range& rhs) { return lhs.offset < rhs.offset; });
+
+	/*Two windows is the least that lets reading overlap with consuming*/
+	const size_t available = static_cast<size_t>(memoryLimit - retained);
+	window = std::max(MinimumWindowSize, std::min(preferredWindow, available / 2));
+	windows = available / window;
+	std::vector<std::vector<uint8_t>> buffers(windows, std::vector<uint8_t>(window));
+
+	/*Overlapping and touching ranges are merged so each byte is read only once*/
+	std::vector<std::pair<uint64_t, uint64_t>> spans;
+	for (const auto& range : ranges)
+	{
+		const uint64_t end = range.offset + range.size;
+		if (!spans.empty() && range.offset <= spans.back().second)
+		{
+			spans.back().second = std::max(spans.back().second, end);
+		}
+		else
+		{
+			spans.emplace_back(range.offset, end);
+		}
+	}
+
+	std::mutex lock;
+	std::condition_variable changed;
+	std::vector<size_t> freeBuffers;
+	std::deque<FilledWindow> filled;
+	bool readerDone = false;
+	bool aborted = false;
+
+	for (size_t idx = 0; idx < buffers.size(); ++idx)
+	{
+		freeBuffers.push_back(idx);
+	}
+
+	std::thread reader([&]()
+	{
+		std::ifstream fin(fileName.c_str(), std::ifstream::binary);
+
+		for (const auto& span : spans)
+		{
+			fin.clear();
+			fin.seekg(span.first, std::ios_base::beg);
+
+			for (uint64_t offset = span.first; offset < span.second;)
+			{
+				size_t buffer;
+				{
+					/*Backpressure, wait for the consumer to hand a window back*/
+					std::unique_lock<std::mutex> guard(lock);
+					changed.wait(guard, [&]() { return !freeBuffers.empty() || aborted; });
+					if (aborted)
+					{
+						return;
+					}
+					buffer = freeBuffers.back();
+					freeBuffers.pop_back();
+				}
+
+				const size_t wanted = static_cast<size_t>(std::min<uint64_t>(window, span.second - offset));
+				fin.read((char*)buffers[buffer].data(), wanted);
+				const size_t read = static_cast<size_t>(fin.gcount());
+
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (read != 0)
+					{
+						filled.push_back({ offset, read, buffer });
+					}
+					else
+					{
+						freeBuffers.push_back(buffer);
+					}
+				}
+				changed.notify_all();
+
+				if (read < wanted)
+				{
+					break;	/*truncated file, the rest of this span doesn't exist*/
+				}
+				offset += read;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			readerDone = true;
+		}
+		changed.notify_all();
+	});
+
+	std::exception_ptr failure;
+	size_t firstOpen = 0;
+
+	try
+	{
+		for (;;)
+		{
+			FilledWindow current;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				changed.wait(guard, [&]() { return !filled.empty() || readerDone; });
+				if (filled.empty())
+				{
+					break;
+				}
+				current = filled.front();
+				filled.pop_front();
+			}
+
+			/*Windows arrive in increasing offset order, so ranges that ended before this one never match again*/
+			const uint64_t windowEnd = current.offset + current.size;
+			while (firstOpen < ranges.size() && ranges[firstOpen].offset + ranges[firstOpen].size <= current.offset)
+			{
+				++firstOpen;
+			}
+
+			for (size_t idx = firstOpen; idx < ranges.size() && ranges[idx].offset < windowEnd; ++idx)
+			{
+				const uint64_t start = std::max(ranges[idx].offset, current.offset);
+				const uint64_t end = std::min(ranges[idx].offset + ranges[idx].size, windowEnd);
+				if (start < end)
+				{
+					ranges[idx].consumer(start, buffers[current.buffer].data() + (start - current.offset), static_cast<size_t>(end - start));
+				}
+			}
+
+			totalRead += current.size;
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				freeBuffers.push_back(current.buffer);
+			}
+			changed.notify_all();
+		}
+	}
+	catch (...)
+	{
+		failure = std::current_exception();
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			aborted = true;
+		}
+		changed.notify_all();
+	}
+
+	reader.join();
+	ranges.clear();
+
+	/*A truncated file delivers only a prefix of a retained range*/
+	for (auto& range : retainedRanges)
+	{
+		range.trim(range.received);
+	}
+	retainedRanges.clear();
+
+	if (failure)
+	{
+		std::rethrow_exception(failure);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Arena.h"
+
+struct StreamOptions
+{
+	size_t memoryLimit = size_t(64) << 20;	/*most bytes of file data held at once, windows and retained tables together*/
+	size_t windowSize = size_t(4) << 20;	/*shrunk when what the limit leaves can't hold at least two windows*/
+};
+
+/*Reads the scheduled ranges of a file once, in file offset order, through a fixed pool of
+window buffers.  A reader thread fills windows while the caller hands them to consumers, and
+the reader blocks whenever every window is still in use, so resident file data never exceeds
+StreamOptions::memoryLimit however large the file is.*/
+class StreamScheduler
+{
+public:
+	/*Receives consecutive pieces of its range in order, each piece only valid during the call*/
+	typedef std::function<void(uint64_t offset, const uint8_t* data, size_t size)> Consumer;
+
+	StreamScheduler(const std::string& fileName, const StreamOptions& options);
+
+	void schedule(uint64_t offset, uint64_t size, Consumer consumer);
+
+	/*Schedules a copy of a range for tables a decoder needs whole, such as an export trie.  The copy
+	is charged against the memory limit for the life of the scheduler and refused, returning false,
+	when it would leave less than two windows.  into must outlive run(), which completes it and trims
+	it to what the file actually holds.*/
+	bool retain(uint64_t offset, uint64_t size, ArenaVector<uint8_t>& into);
+
+	/*Same for tables of 32-bit words, such as relocation entries, so they can be read in place.  A
+	trailing partial word is left out.*/
+	bool retain(uint64_t offset, uint64_t size, ArenaVector<uint32_t>& into);
+
+	/*Charges size bytes a consumer keeps from what it is handed, such as the few entries it picks
+	out of a table, against the memory limit for the life of the scheduler.  Refused like retain().*/
+	bool reserve(uint64_t size);
+
+	/*What the limit has left beyond the two windows a pass needs*/
+	uint64_t unreserved() const;
+
+	/*Streams every scheduled range as one pass in file offset order, overlapping ranges share the
+	same reads.  Windows are sized from what retained tables leave of the limit and released after
+	the pass, so a later pass can schedule work that depends on what an earlier one read.*/
+	void run();
+
+	uint64_t bytesRead() const { return totalRead; }
+	uint64_t bytesRetained() const { return retained; }
+	size_t windowSize() const { return window; }
+	size_t windowCount() const { return windows; }
+
+private:
+	struct Range
+	{
+		uint64_t	offset;
+		uint64_t	size;
+		Consumer	consumer;
+	};
+
+	struct RetainedRange
+	{
+		uint8_t*					data;
+		uint64_t					offset;
+		size_t						received;
+		std::function<void(size_t)>	trim;	/*resizes the table to the bytes received*/
+	};
+
+	void retainRange(uint64_t offset, uint64_t size, uint8_t* data, std::function<void(size_t)> trim);
+
+	std::string					fileName;
+	size_t						memoryLimit;
+	size_t						preferredWindow;
+	size_t						window = 0;
+	size_t						windows = 0;
+	std::vector<Range>			ranges;
+	std::vector<RetainedRange>	retainedRanges;
+	uint64_t					retained = 0;	/*bytes retained or reserved*/
+	uint64_t					totalRead = 0;
+};
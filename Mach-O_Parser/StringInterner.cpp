@@ -0,0 +1,83 @@
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include "StringInterner.h"
+
+/*An id is the shard in the low bits and the position within that shard above them*/
+NameId StringInterner::intern(std::string_view name)
+{
+	const size_t hash = std::hash<std::string_view>()(name);
+	const size_t shardIndex = (hash ^ (hash >> 16)) & (ShardCount - 1);
+	Shard& shard = shards[shardIndex];
+
+	{
+		std::shared_lock<std::shared_mutex> reading(shard.lock);
+		auto found = shard.ids.find(name);
+		if (found != shard.ids.end())
+		{
+			return found->second;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> writing(shard.lock);
+	auto found = shard.ids.find(name);
+	if (found != shard.ids.end())
+	{
+		return found->second;
+	}
+
+	if (shard.names.size() >= (size_t(1) << (32 - ShardBits)))
+	{
+		throw std::length_error("string interner shard is full");
+	}
+
+	const std::string_view stored = shard.storage.copy(name);
+	const NameId id = static_cast<NameId>((shard.names.size() << ShardBits) | shardIndex);
+	shard.names.push_back(stored);
+	shard.ids.emplace(stored, id);
+
+	return id;
+}
+
+std::string_view StringInterner::name(NameId id) const
+{
+	const Shard& shard = shards[id & (ShardCount - 1)];
+	std::shared_lock<std::shared_mutex> reading(shard.lock);
+
+	const size_t index = id >> ShardBits;
+	return index < shard.names.size() ? shard.names[index] : std::string_view();
+}
+
+size_t StringInterner::size() const
+{
+	size_t total = 0;
+	for (const auto& shard : shards)
+	{
+		std::shared_lock<std::shared_mutex> reading(shard.lock);
+		total += shard.names.size();
+	}
+
+	return total;
+}
+
+namespace
+{
+	thread_local StringInterner* scopedNames = nullptr;
+}
+
+StringInterner& corpusNames()
+{
+	static StringInterner interner;
+	return scopedNames ? *scopedNames : interner;
+}
+
+NameScope::NameScope(StringInterner& names)
+	: previous(scopedNames)
+{
+	scopedNames = &names;
+}
+
+NameScope::~NameScope()
+{
+	scopedNames = previous;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Arena.h"
+
+typedef uint32_t NameId;
+
+/*Maps each distinct name to a 32-bit id that is stable for the life of the process, so
+repeated segment, section, dylib and symbol names are stored once and compare as integers.
+Safe to use from any number of threads, names are spread over shards that lock independently.*/
+class StringInterner
+{
+public:
+	NameId intern(std::string_view name);
+	std::string_view name(NameId id) const;
+	size_t size() const;
+
+private:
+	static constexpr unsigned ShardBits = 6;
+	static constexpr size_t ShardCount = size_t(1) << ShardBits;
+
+	struct Shard
+	{
+		mutable std::shared_mutex					lock;
+		std::unordered_map<std::string_view, NameId>	ids;
+		std::vector<std::string_view>				names;
+		Arena										storage{ 1 << 16 };
+	};
+
+	std::array<Shard, ShardCount> shards;
+};
+
+/*The interner shared by every image decoded in this process, or the one a NameScope on the
+calling thread points it at*/
+StringInterner& corpusNames();
+
+/*Points corpusNames() on the calling thread at names until the scope ends, so a long running
+process can give each image names that are freed with it.  Threads the scope's owner starts
+still see the shared interner, work under a scope has to stay on its thread.*/
+class NameScope
+{
+public:
+	explicit NameScope(StringInterner& names);
+	~NameScope();
+
+	NameScope(const NameScope&) = delete;
+	NameScope& operator=(const NameScope&) = delete;
+
+private:
+	StringInterner* previous;
+};
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include "Arena.h"
+#include "Reader.h"
+#include "StubIndex.h"
+
+namespace
+{
+	bool slotKind(const Section& sect, StubKind& kind, uint32_t& stride)
+	{
+		switch (sect.flags & SECTION_TYPE)
+		{
+		case S_SYMBOL_STUBS:
+			kind = StubKind::Stub;
+			stride = sect.reserved2;	/*stub size*/
+			return stride != 0;
+
+		case S_NON_LAZY_SYMBOL_POINTERS:
+			kind = StubKind::NonLazyPointer;
+			stride = sizeof(uint64_t);
+			return true;
+
+		case S_LAZY_SYMBOL_POINTERS:
+		case S_LAZY_DYLIB_SYMBOL_POINTERS:
+			kind = StubKind::LazyPointer;
+			stride = sizeof(uint64_t);
+			return true;
+
+		case S_THREAD_LOCAL_VARIABLE_POINTERS:
+			kind = StubKind::ThreadLocalPointer;
+			stride = sizeof(uint64_t);
+			return true;
+
+		default:
+			return false;
+		}
+	}
+}
+
+StubIndex::StubIndex(std::ifstream& fin, const MachImage& image, const SymbolTable& symbols)
+{
+	const dysymtab_command* dysymtab = findCommand<dysymtab_command>(image);
+	if (!dysymtab || dysymtab->nindirectsyms == 0)
+	{
+		return;
+	}
+
+	const auto indirect = readArrayAt<uint32_t>(fin, dysymtab->indirectsymoff, dysymtab->nindirectsyms, ArenaAllocator<uint32_t>(workerArena()));
+	build(indirect.data(), indirect.size(), image, symbols);
+}
+
+StubIndex::StubIndex(const uint32_t* indirect, size_t indirectCount, const MachImage& image, const SymbolTable& symbols)
+{
+	build(indirect, indirectCount, image, symbols);
+}
+
+std::vector<uint32_t> StubIndex::referencedSymbols(const uint32_t* indirect, size_t indirectCount)
+{
+	std::vector<uint32_t> indices;
+	for (size_t idx = 0; idx < indirectCount; ++idx)
+	{
+		if (!(indirect[idx] & (INDIRECT_SYMBOL_LOCAL | INDIRECT_SYMBOL_ABS)))
+		{
+			indices.push_back(indirect[idx]);
+		}
+	}
+
+	return indices;
+}
+
+void StubIndex::build(const uint32_t* indirect, size_t indirectCount, const MachImage& image, const SymbolTable& symbols)
+{
+	const NameId noName = corpusNames().intern(std::string_view());
+
+	for (const auto& sect : image.sections)
+	{
+		StubKind kind;
+		uint32_t stride;
+		if (!slotKind(sect, kind, stride) || sect.reserved1 >= indirectCount)
+		{
+			continue;
+		}
+
+		/*reserved1 is where this section's run starts in the indirect table, one entry per slot*/
+		const uint64_t count = std::min<uint64_t>(sect.size / stride, indirectCount - sect.reserved1);
+		ranges.push_back({ sect.addr, count, stride, static_cast<uint32_t>(targets.size()) });
+
+		for (uint64_t slot = 0; slot < count; ++slot)
+		{
+			const uint32_t symbolIndex = indirect[sect.reserved1 + slot];
+			if ((symbolIndex & (INDIRECT_SYMBOL_LOCAL | INDIRECT_SYMBOL_ABS)) || symbolIndex >= symbols.size())
+			{
+				targets.push_back({ noName, 0, kind });
+			}
+			else
+			{
+				targets.push_back({ symbols.nameId(symbolIndex), static_cast<uint8_t>(GET_LIBRARY_ORDINAL(symbols[symbolIndex].n_desc)), kind });
+			}
+		}
+	}
+
+	/*Sections are normally in address order already, if not the slots are renumbered so
+	targets stays in address order as well and slotAddress can search by firstSlot*/
+	auto byAddress = [](const SlotRange& lhs, const SlotRange& rhs) { return lhs.address < rhs.address; };
+	if (!std::is_sorted(ranges.begin(), ranges.end(), byAddress))
+	{
+		std::sort(ranges.begin(), ranges.end(), byAddress);
+
+		std::vector<StubTarget> ordered;
+		ordered.reserve(targets.size());
+		for (auto& range : ranges)
+		{
+			ordered.insert(ordered.end(), targets.begin() + range.firstSlot, targets.begin() + range.firstSlot + range.count);
+			range.firstSlot = static_cast<uint32_t>(ordered.size() - range.count);
+		}
+		targets = std::move(ordered);
+	}
+}
+
+const StubTarget* StubIndex::lookup(uint64_t address) const
+{
+	auto range = std::upper_bound(ranges.begin(), ranges.end(), address,
+		[](uint64_t value, const SlotRange& candidate) { return value < candidate.address; });
+
+	if (range == ranges.begin())
+	{
+		return nullptr;
+	}
+
+	--range;
+	const uint64_t slot = (address - range->address) / range->stride;
+	if (slot >= range->count)
+	{
+		return nullptr;
+	}
+
+	return &targets[range->firstSlot + slot];
+}
+
+uint64_t StubIndex::slotAddress(size_t slot) const
+{
+	auto range = std::upper_bound(ranges.begin(), ranges.end(), slot,
+		[](size_t value, const SlotRange& candidate) { return value < candidate.firstSlot; });
+
+	--range;
+	return range->address + (slot - range->firstSlot) * range->stride;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <fstream>
+#include <vector>
+#include "Decoder.h"
+#include "SymbolTable.h"
+
+enum class StubKind : uint8_t
+{
+	Stub,				/*S_SYMBOL_STUBS, code that jumps through a pointer*/
+	NonLazyPointer,		/*S_NON_LAZY_SYMBOL_POINTERS, the GOT*/
+	LazyPointer,		/*S_LAZY_SYMBOL_POINTERS and S_LAZY_DYLIB_SYMBOL_POINTERS*/
+	ThreadLocalPointer	/*S_THREAD_LOCAL_VARIABLE_POINTERS*/
+};
+
+/*The symbol behind one stub or pointer slot*/
+struct StubTarget
+{
+	NameId		symbol;			/*the empty name for INDIRECT_SYMBOL_LOCAL and INDIRECT_SYMBOL_ABS slots*/
+	uint8_t		libraryOrdinal;	/*GET_LIBRARY_ORDINAL of the symbol, 1-based into MachImage::dylibNames*/
+	StubKind	kind;
+};
+
+/*Maps stub and symbol pointer addresses to the imports they reach, built once from the
+indirect symbol table.  Every slot is resolved up front, so a lookup is a binary search over
+the stub and pointer sections followed by an index computation.*/
+class StubIndex
+{
+public:
+	StubIndex() = default;
+	StubIndex(std::ifstream& fin, const MachImage& image, const SymbolTable& symbols);
+
+	/*Builds the index from an indirect symbol table already in memory, as streamed decoding gathers it*/
+	StubIndex(const uint32_t* indirect, size_t indirectCount, const MachImage& image, const SymbolTable& symbols);
+
+	/*Symbol table indices the indirect table refers to, the only symbols a sparse table needs for stubs*/
+	static std::vector<uint32_t> referencedSymbols(const uint32_t* indirect, size_t indirectCount);
+
+	/*Target of the slot containing address, nullptr when address is in no stub or pointer section*/
+	const StubTarget* lookup(uint64_t address) const;
+
+	size_t size() const { return targets.size(); }
+	uint64_t slotAddress(size_t slot) const;	/*slots are numbered in address order*/
+	const StubTarget& target(size_t slot) const { return targets[slot]; }
+
+private:
+	void build(const uint32_t* indirect, size_t indirectCount, const MachImage& image, const SymbolTable& symbols);
+
+	/*One stub or pointer section, its slots are targets[firstSlot, firstSlot + count)*/
+	struct SlotRange
+	{
+		uint64_t	address;
+		uint64_t	count;
+		uint32_t	stride;
+		uint32_t	firstSlot;
+	};
+
+	std::vector<SlotRange>	ranges;		/*sorted by address, never overlapping*/
+	std::vector<StubTarget>	targets;
+};
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "SymbolTable.h"
+#include "Reader.h"
+
+namespace
+{
+	/*Longest name a sparse table gathers, so a string table without terminators can't grow one without bound*/
+	const size_t MaximumStreamedNameLength = 1 << 16;
+}
+
+std::shared_ptr<const std::vector<char>> SharedStringTables::table(std::ifstream& fin, const symtab_command& symtab)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	auto& found = tables[std::make_pair(symtab.stroff, symtab.strsize)];
+	if (!found)
+	{
+		found = std::make_shared<const std::vector<char>>(readArrayAt<char>(fin, symtab.stroff, symtab.strsize));
+	}
+
+	return found;
+}
+
+SymbolTable::SymbolTable(std::ifstream& fin, const symtab_command& symtab)
+	: symbols(readArrayAt<nlist_64>(fin, symtab.symoff, symtab.nsyms)),
+	  strings(std::make_shared<const std::vector<char>>(readArrayAt<char>(fin, symtab.stroff, symtab.strsize)))
+{
+	count = symbols.size();
+}
+
+SymbolTable::SymbolTable(std::ifstream& fin, const symtab_command& symtab, SharedStringTables& shared)
+	: symbols(readArrayAt<nlist_64>(fin, symtab.symoff, symtab.nsyms)),
+	  strings(shared.table(fin, symtab))
+{
+	count = symbols.size();
+}
+
+bool SymbolTable::scheduleSymbols(std::ifstream& fin, const symtab_command& symtab, std::vector<uint32_t> wanted, StreamScheduler& scheduler)
+{
+	count = clipToFile(fin, symtab.symoff, symtab.nsyms, sizeof(nlist_64));
+
+	std::sort(wanted.begin(), wanted.end());
+	wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+	wanted.erase(std::lower_bound(wanted.begin(), wanted.end(), count), wanted.end());
+	if (!scheduler.reserve(uint64_t(wanted.size()) * (sizeof(nlist_64) + sizeof(uint32_t))))
+	{
+		return false;
+	}
+	kept = std::move(wanted);
+	symbols.assign(kept.size(), nlist_64());
+
+	/*Entries can straddle two windows, so each one is assembled byte by byte as pieces arrive*/
+	const uint64_t symoff = symtab.symoff;
+	scheduler.schedule(symoff, uint64_t(count) * sizeof(nlist_64), [this, symoff](uint64_t offset, const uint8_t* data, size_t size)
+	{
+		const uint64_t first = (offset - symoff) / sizeof(nlist_64);
+		const uint64_t last = (offset - symoff + size + sizeof(nlist_64) - 1) / sizeof(nlist_64);
+
+		for (auto found = std::lower_bound(kept.begin(), kept.end(), first); found != kept.end() && *found < last; ++found)
+		{
+			const uint64_t entryStart = symoff + uint64_t(*found) * sizeof(nlist_64);
+			const uint64_t start = std::max(entryStart, offset);
+			const uint64_t end = std::min(entryStart + sizeof(nlist_64), offset + size);
+
+			uint8_t* entry = reinterpret_cast<uint8_t*>(&symbols[found - kept.begin()]);
+			memcpy(entry + (start - entryStart), data + (start - offset), static_cast<size_t>(end - start));
+		}
+	});
+
+	return true;
+}
+
+void SymbolTable::scheduleStrings(const symtab_command& symtab, StreamScheduler& scheduler)
+{
+	/*Names are gathered in string table order, several at once since linkers merge a name into
+	the tail of a longer one, then packed into a small table the kept entries are pointed at*/
+	struct Gathered
+	{
+		uint32_t	strx;
+		size_t		symbol;
+		std::string	text;
+		bool		done;
+	};
+
+	auto gathered = std::make_shared<std::vector<Gathered>>();
+	uint64_t mostPacked = 1;
+	for (size_t idx = 0; idx < symbols.size(); ++idx)
+	{
+		if (symbols[idx].n_strx < symtab.strsize)
+		{
+			gathered->push_back({ symbols[idx].n_strx, idx, std::string(), false });
+			mostPacked += std::min<uint64_t>(symtab.strsize - symbols[idx].n_strx, MaximumStreamedNameLength) + 1;
+		}
+		symbols[idx].n_strx = 0;
+	}
+
+	/*The packed names are charged against the memory limit up front.  mostPacked is the most they
+	can come to, when that won't fit they get half of what is left and names past it are dropped.*/
+	const uint64_t budget = mostPacked <= scheduler.unreserved() ? mostPacked : scheduler.unreserved() / 2;
+	scheduler.reserve(budget);
+	dropped = 0;
+	std::sort(gathered->begin(), gathered->end(), [](const Gathered& lhs, const Gathered& rhs) { return lhs.strx < rhs.strx; });
+	auto packed = std::make_shared<std::vector<char>>(1, '\0');
+	packed->reserve(static_cast<size_t>(budget));
+	strings = packed;
+
+	const uint64_t stroff = symtab.stroff;
+	const uint64_t strsize = symtab.strsize;
+	auto nextToOpen = std::make_shared<size_t>(0);
+	auto firstOpen = std::make_shared<size_t>(0);
+	scheduler.schedule(stroff, symtab.strsize, [this, gathered, packed, nextToOpen, firstOpen, stroff, strsize, budget](uint64_t offset, const uint8_t* data, size_t size)
+	{
+		const uint64_t pieceEnd = offset - stroff + size;
+		while (*nextToOpen < gathered->size() && (*gathered)[*nextToOpen].strx < pieceEnd)
+		{
+			++*nextToOpen;
+		}
+
+		for (size_t idx = *firstOpen; idx < *nextToOpen; ++idx)
+		{
+			Gathered& name = (*gathered)[idx];
+			if (name.done)
+			{
+				continue;
+			}
+
+			const uint64_t start = std::max<uint64_t>(name.strx + name.text.size(), offset - stroff);
+			const char* first = reinterpret_cast<const char*>(data + (start - (offset - stroff)));
+			const size_t available = static_cast<size_t>(pieceEnd - start);
+			const size_t length = strnlen(first, available);
+
+			name.text.append(first, std::min(length, MaximumStreamedNameLength - name.text.size()));
+			name.done = length < available || name.text.size() == MaximumStreamedNameLength || pieceEnd == strsize;
+
+			if (name.done && packed->size() + name.text.size() + 1 > budget)
+			{
+				++dropped;
+				std::string().swap(name.text);
+			}
+			else if (name.done)
+			{
+				symbols[name.symbol].n_strx = static_cast<uint32_t>(packed->size());
+				packed->insert(packed->end(), name.text.begin(), name.text.end());
+				packed->push_back('\0');
+				std::string().swap(name.text);
+			}
+		}
+
+		while (*firstOpen < *nextToOpen && (*gathered)[*firstOpen].done)
+		{
+			++*firstOpen;
+		}
+	});
+}
+
+size_t SymbolTable::slot(size_t index) const
+{
+	if (kept.empty())
+	{
+		return index < symbols.size() ? index : symbols.size();
+	}
+
+	auto found = std::lower_bound(kept.begin(), kept.end(), index);
+	return found != kept.end() && *found == index ? size_t(found - kept.begin()) : symbols.size();
+}
+
+const nlist_64& SymbolTable::operator[](size_t index) const
+{
+	static const nlist_64 missing = {};
+	const size_t position = slot(index);
+
+	return position < symbols.size() ? symbols[position] : missing;
+}
+
+std::string_view SymbolTable::name(size_t index) const
+{
+	const size_t position = slot(index);
+	if (position >= symbols.size() || !strings || symbols[position].n_strx >= strings->size())
+	{
+		return std::string_view();
+	}
+
+	const char* start = strings->data() + symbols[position].n_strx;
+	return std::string_view(start, strnlen(start, strings->size() - symbols[position].n_strx));
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "loader.h"
+#include "Streaming.h"
+#include "StringInterner.h"
+
+/*String tables that several images point their LC_SYMTAB at, each read once and shared by all of them.
+Every image of a dyld shared cache names its symbols from the cache's one pool, which runs to tens of MB.
+Safe to use from many threads.*/
+class SharedStringTables
+{
+public:
+	/*The table symtab points at, read through fin the first time any image asks for it*/
+	std::shared_ptr<const std::vector<char>> table(std::ifstream& fin, const symtab_command& symtab);
+
+private:
+	std::mutex	lock;	/*held while a table is read, the other images need the same one anyway*/
+	std::map<std::pair<uint32_t, uint32_t>, std::shared_ptr<const std::vector<char>>>	tables;	/*by stroff and strsize*/
+};
+
+/*The LC_SYMTAB symbol and string tables, read in one go so lookups never touch the file*/
+class SymbolTable
+{
+public:
+	SymbolTable() = default;
+	SymbolTable(std::ifstream& fin, const symtab_command& symtab);
+
+	/*Reads only the nlist entries, names come from a string table shared with other images*/
+	SymbolTable(std::ifstream& fin, const symtab_command& symtab, SharedStringTables& shared);
+
+	/*Streaming flavour that keeps only the symbols at the given indices.  The first pass gathers their
+	nlist entries, and once it has run scheduleStrings() gathers just the names those entries point at.
+	size() is the full symbol count either way, symbols that weren't asked for read as empty.  Both
+	charge what they keep against the scheduler's memory limit, scheduleSymbols() keeps nothing and
+	returns false when the entries don't fit, and names that don't fit read as empty and are counted
+	by droppedNames().*/
+	bool scheduleSymbols(std::ifstream& fin, const symtab_command& symtab, std::vector<uint32_t> wanted, StreamScheduler& scheduler);
+	void scheduleStrings(const symtab_command& symtab, StreamScheduler& scheduler);
+	size_t droppedNames() const { return dropped; }
+
+	size_t size() const { return count; }
+	const nlist_64& operator[](size_t index) const;
+
+	/*Name of the symbol at index, empty if the index or its string offset is out of range*/
+	std::string_view name(size_t index) const;
+
+	/*Same name interned in corpusNames()*/
+	NameId nameId(size_t index) const { return corpusNames().intern(name(index)); }
+
+private:
+	/*Position of index in symbols, or symbols.size() for a symbol a sparse table doesn't hold*/
+	size_t slot(size_t index) const;
+
+	std::vector<nlist_64> symbols;
+	std::vector<uint32_t> kept;		/*sorted indices of the entries in symbols for a sparse table, empty for a whole one*/
+	std::shared_ptr<const std::vector<char>> strings;	/*shared for the images of a shared cache*/
+	size_t count = 0;
+	size_t dropped = 0;
+};
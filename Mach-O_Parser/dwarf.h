@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * The subset of the DWARF 2-5 constants needed to find each compilation
+ * unit's line program and run it.  dSYM bundles keep the debug sections in a
+ * __DWARF segment of an otherwise empty Mach-O image, named __debug_* rather
+ * than .debug_*.
+ */
+
+/* unit types, DWARF 5 unit headers */
+#define DW_UT_compile           0x01
+#define DW_UT_type              0x02
+#define DW_UT_partial           0x03
+#define DW_UT_skeleton          0x04
+#define DW_UT_split_compile     0x05
+#define DW_UT_split_type        0x06
+
+/* tags */
+#define DW_TAG_compile_unit     0x11
+#define DW_TAG_partial_unit     0x3c
+#define DW_TAG_skeleton_unit    0x4a
+
+/* attributes */
+#define DW_AT_name              0x03
+#define DW_AT_stmt_list         0x10
+#define DW_AT_low_pc            0x11
+#define DW_AT_high_pc           0x12
+#define DW_AT_comp_dir          0x1b
+#define DW_AT_str_offsets_base  0x72
+#define DW_AT_addr_base         0x73
+
+/* attribute forms */
+#define DW_FORM_addr            0x01
+#define DW_FORM_block2          0x03
+#define DW_FORM_block4          0x04
+#define DW_FORM_data2           0x05
+#define DW_FORM_data4           0x06
+#define DW_FORM_data8           0x07
+#define DW_FORM_string          0x08
+#define DW_FORM_block           0x09
+#define DW_FORM_block1          0x0a
+#define DW_FORM_data1           0x0b
+#define DW_FORM_flag            0x0c
+#define DW_FORM_sdata           0x0d
+#define DW_FORM_strp            0x0e
+#define DW_FORM_udata           0x0f
+#define DW_FORM_ref_addr        0x10
+#define DW_FORM_ref1            0x11
+#define DW_FORM_ref2            0x12
+#define DW_FORM_ref4            0x13
+#define DW_FORM_ref8            0x14
+#define DW_FORM_ref_udata       0x15
+#define DW_FORM_indirect        0x16
+#define DW_FORM_sec_offset      0x17
+#define DW_FORM_exprloc         0x18
+#define DW_FORM_flag_present    0x19
+#define DW_FORM_strx            0x1a
+#define DW_FORM_addrx           0x1b
+#define DW_FORM_ref_sup4        0x1c
+#define DW_FORM_strp_sup        0x1d
+#define DW_FORM_data16          0x1e
+#define DW_FORM_line_strp       0x1f
+#define DW_FORM_ref_sig8        0x20
+#define DW_FORM_implicit_const  0x21
+#define DW_FORM_loclistx        0x22
+#define DW_FORM_rnglistx        0x23
+#define DW_FORM_ref_sup8        0x24
+#define DW_FORM_strx1           0x25
+#define DW_FORM_strx2           0x26
+#define DW_FORM_strx3           0x27
+#define DW_FORM_strx4           0x28
+#define DW_FORM_addrx1          0x29
+#define DW_FORM_addrx2          0x2a
+#define DW_FORM_addrx3          0x2b
+#define DW_FORM_addrx4          0x2c
+
+/* standard line number opcodes */
+#define DW_LNS_copy                 0x01
+#define DW_LNS_advance_pc           0x02
+#define DW_LNS_advance_line         0x03
+#define DW_LNS_set_file             0x04
+#define DW_LNS_set_column           0x05
+#define DW_LNS_negate_stmt          0x06
+#define DW_LNS_set_basic_block      0x07
+#define DW_LNS_const_add_pc         0x08
+#define DW_LNS_fixed_advance_pc     0x09
+#define DW_LNS_set_prologue_end     0x0a
+#define DW_LNS_set_epilogue_begin   0x0b
+#define DW_LNS_set_isa              0x0c
+
+/* extended line number opcodes */
+#define DW_LNE_end_sequence         0x01
+#define DW_LNE_set_address          0x02
+#define DW_LNE_define_file          0x03
+#define DW_LNE_set_discriminator    0x04
+
+/* DWARF 5 line table directory and file entry content types */
+#define DW_LNCT_path                0x1
+#define DW_LNCT_directory_index     0x2
+#define DW_LNCT_timestamp           0x3
+#define DW_LNCT_size                0x4
+#define DW_LNCT_MD5                 0x5
@@ -0,0 +1,146 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * Chained fixups replace the LC_DYLD_INFO rebase and bind opcodes.  The
+ * LC_DYLD_CHAINED_FIXUPS load command points at a dyld_chained_fixups_header
+ * in __LINKEDIT.  Each page of each segment that needs fixing up records the
+ * offset of its first fixup, and every fixup stores the distance to the next
+ * one in its own "next" field, so the fixups of a page form a linked list
+ * threaded through the pointers themselves.
+ */
+
+/* header of the LC_DYLD_CHAINED_FIXUPS payload */
+struct dyld_chained_fixups_header
+{
+    uint32_t    fixups_version;     /*  0 */
+    uint32_t    starts_offset;      /*  offset of dyld_chained_starts_in_image in chain_data */
+    uint32_t    imports_offset;     /*  offset of imports table in chain_data */
+    uint32_t    symbols_offset;     /*  offset of symbol strings in chain_data */
+    uint32_t    imports_count;      /*  number of imported symbol names */
+    uint32_t    imports_format;     /*  DYLD_CHAINED_IMPORT* */
+    uint32_t    symbols_format;     /*  0 => uncompressed, 1 => zlib compressed */
+};
+
+/* This struct is embedded in LC_DYLD_CHAINED_FIXUPS payload */
+struct dyld_chained_starts_in_image
+{
+    uint32_t    seg_count;
+    uint32_t    seg_info_offset[1];  /*  each entry is offset into this struct for that segment
+                                         followed by pool of dyld_chain_starts_in_segment data */
+};
+
+/* This struct is embedded in dyld_chain_starts_in_image
+   and passed down to the kernel for page-in linking */
+struct dyld_chained_starts_in_segment
+{
+    uint32_t    size;               /*  size of this (amount kernel needs to copy) */
+    uint16_t    page_size;          /*  0x1000 or 0x4000 */
+    uint16_t    pointer_format;     /*  DYLD_CHAINED_PTR_* */
+    uint64_t    segment_offset;     /*  offset in memory to start of segment */
+    uint32_t    max_valid_pointer;  /*  for 32-bit OS, any value beyond this is not a pointer */
+    uint16_t    page_count;         /*  how many pages are in array */
+    uint16_t    page_start[1];      /*  each entry is offset in each page of first element in chain
+                                        or DYLD_CHAINED_PTR_START_NONE if no fixups on page */
+ /* uint16_t    chain_starts[1];        some 32-bit formats may require multiple starts per page.
+                                        for those, if high bit is set in page_starts[], then it
+                                        is index into chain_starts[] which is a list of starts
+                                        the last of which has the high bit set */
+};
+
+enum
+{
+    DYLD_CHAINED_PTR_START_NONE   = 0xFFFF, /* used in page_start[] to denote a page with no fixups */
+    DYLD_CHAINED_PTR_START_MULTI  = 0x8000, /* used in page_start[] to denote a page which has multiple starts */
+    DYLD_CHAINED_PTR_START_LAST   = 0x8000, /* used in chain_starts[] to denote last start in list for page */
+};
+
+/* values for dyld_chained_starts_in_segment.pointer_format */
+enum
+{
+    DYLD_CHAINED_PTR_ARM64E                 =  1,   /* stride 8, unauth target is vmaddr */
+    DYLD_CHAINED_PTR_64                     =  2,   /* target is vmaddr */
+    DYLD_CHAINED_PTR_32                     =  3,
+    DYLD_CHAINED_PTR_32_CACHE               =  4,
+    DYLD_CHAINED_PTR_32_FIRMWARE            =  5,
+    DYLD_CHAINED_PTR_64_OFFSET              =  6,   /* target is vm offset */
+    DYLD_CHAINED_PTR_ARM64E_KERNEL          =  7,   /* stride 4, unauth target is vm offset */
+    DYLD_CHAINED_PTR_64_KERNEL_CACHE        =  8,
+    DYLD_CHAINED_PTR_ARM64E_USERLAND        =  9,   /* stride 8, unauth target is vm offset */
+    DYLD_CHAINED_PTR_ARM64E_FIRMWARE        = 10,   /* stride 4, unauth target is vmaddr */
+    DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE    = 11,   /* stride 1, x86_64 kernel caches */
+    DYLD_CHAINED_PTR_ARM64E_USERLAND24      = 12,   /* stride 8, unauth target is vm offset, 24-bit bind */
+    DYLD_CHAINED_PTR_ARM64E_SHARED_CACHE    = 13,   /* stride 8, regular/auth targets both vm offsets. Only A keys supported */
+    DYLD_CHAINED_PTR_ARM64E_SEGMENTED       = 14,   /* stride 4, rebase offsets use segIndex and segOffset */
+};
+
+/* values for dyld_chained_fixups_header.imports_format */
+enum
+{
+    DYLD_CHAINED_IMPORT          = 1,
+    DYLD_CHAINED_IMPORT_ADDEND   = 2,
+    DYLD_CHAINED_IMPORT_ADDEND64 = 3,
+};
+
+/* values for dyld_chained_fixups_header.symbols_format */
+enum
+{
+    DYLD_CHAINED_SYMBOL_UNCOMPRESSED    = 0,
+    DYLD_CHAINED_SYMBOL_ZLIB            = 1,
+};
+
+/* DYLD_CHAINED_IMPORT */
+struct dyld_chained_import
+{
+    uint32_t    lib_ordinal :  8,
+                weak_import :  1,
+                name_offset : 23;
+};
+
+/* DYLD_CHAINED_IMPORT_ADDEND */
+struct dyld_chained_import_addend
+{
+    uint32_t    lib_ordinal :  8,
+                weak_import :  1,
+                name_offset : 23;
+    int32_t     addend;
+};
+
+/* DYLD_CHAINED_IMPORT_ADDEND64 */
+struct dyld_chained_import_addend64
+{
+    uint64_t    lib_ordinal : 16,
+                weak_import :  1,
+                reserved    : 15,
+                name_offset : 32;
+    uint64_t    addend;
+};
+
+/*
+ * The pointer layouts below are not read through structs.  Each format packs
+ * its fields into a 32 or 64-bit word, the decoder extracts them with shifts.
+ *
+ *  DYLD_CHAINED_PTR_64 / DYLD_CHAINED_PTR_64_OFFSET
+ *      rebase  target:36 high8:8 reserved:7 next:12 bind:0
+ *      bind    ordinal:24 addend:8 reserved:19 next:12 bind:1
+ *  DYLD_CHAINED_PTR_64_KERNEL_CACHE / DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE
+ *      rebase  target:30 cacheLevel:2 diversity:16 addrDiv:1 key:2 next:12 isAuth:1
+ *  DYLD_CHAINED_PTR_ARM64E family
+ *      rebase      target:43 high8:8 next:11 bind:0 auth:0
+ *      bind        ordinal:16 zero:16 addend:19 next:11 bind:1 auth:0
+ *      auth rebase target:32 diversity:16 addrDiv:1 key:2 next:11 bind:0 auth:1
+ *      auth bind   ordinal:16 zero:16 diversity:16 addrDiv:1 key:2 next:11 bind:1 auth:1
+ *      (USERLAND24 widens ordinal to 24 bits and narrows zero to 8)
+ *  DYLD_CHAINED_PTR_ARM64E_SHARED_CACHE
+ *      rebase      runtimeOffset:34 high8:8 unused:10 next:11 auth:0
+ *      auth rebase runtimeOffset:34 diversity:16 addrDiv:1 keyIsData:1 next:11 auth:1
+ *  DYLD_CHAINED_PTR_ARM64E_SEGMENTED
+ *      rebase  targetSegOffset:28 targetSegIndex:4 padding:19 next:12 auth:1
+ *  DYLD_CHAINED_PTR_32
+ *      rebase  target:26 next:5 bind:0
+ *      bind    ordinal:20 addend:6 next:5 bind:1
+ *  DYLD_CHAINED_PTR_32_CACHE
+ *      rebase  target:30 next:2
+ *  DYLD_CHAINED_PTR_32_FIRMWARE
+ *      rebase  target:26 next:6
+ */
@@ -361,6 +361,16 @@ struct dysymtab_command
     uint32_t nlocrel;	/* number of local relocation entries */
 };
 
+/*
+ * An indirect symbol table entry is simply a 32bit index into the symbol table
+ * to the symbol that the pointer or stub is referring to.  Unless it is for a
+ * non-lazy symbol pointer section for a defined symbol which strip(1) as
+ * removed.  In which case it has the value INDIRECT_SYMBOL_LOCAL.  If the
+ * symbol was also absolute INDIRECT_SYMBOL_ABS is or'ed with that.
+ */
+#define INDIRECT_SYMBOL_LOCAL	0x80000000
+#define INDIRECT_SYMBOL_ABS	0x40000000
+
 /*
  * The uuid load command contains a single 128-bit unique random number that
  * identifies an object produced by the static link editor.
@@ -456,6 +466,133 @@ struct section
 	uint32_t	reserved2;		/* reserved */
 };
 
+struct section_64               /*  for 64-bit architectures */
+{
+	char		sectname[16];	/*  name of this section */
+	char		segname[16];	/*  segment this section goes in */
+	uint64_t	addr;			/*  memory address of this section */
+	uint64_t	size;			/*  size in bytes of this section */
+	uint32_t	offset;			/*  file offset of this section */
+	uint32_t	align;			/*  section alignment (power of 2) */
+	uint32_t	reloff;			/*  file offset of relocation entries */
+	uint32_t	nreloc;			/*  number of relocation entries */
+	uint32_t	flags;			/*  flags (section type and attributes)*/
+	uint32_t	reserved1;		/*  reserved (for offset or index) */
+	uint32_t	reserved2;		/*  reserved (for count or sizeof) */
+	uint32_t	reserved3;		/*  reserved */
+};
+
+/*
+ * This is the symbol table entry structure for 64-bit architectures.
+ */
+struct nlist_64
+{
+	uint32_t	n_strx;		/*  index into the string table */
+	uint8_t		n_type;		/*  type flag, see below */
+	uint8_t		n_sect;		/*  section number or NO_SECT */
+	uint16_t	n_desc;		/*  see <mach-o/stab.h> */
+	uint64_t	n_value;	/*  value of this symbol (or stab offset) */
+};
+
+/*
+ * The n_type field really contains four fields:
+ *	unsigned char N_STAB:3,
+ *		      N_PEXT:1,
+ *		      N_TYPE:3,
+ *		      N_EXT:1;
+ */
+#define	N_STAB	0xe0  /* if any of these bits set, a symbolic debugging entry */
+#define	N_PEXT	0x10  /* private external symbol bit */
+#define	N_TYPE	0x0e  /* mask for the type bits */
+#define	N_EXT	0x01  /* external symbol bit, set for external symbols */
+
+/* Values for N_TYPE bits of the n_type field. */
+#define	N_UNDF	0x0		/* undefined, n_sect == NO_SECT */
+#define	N_ABS	0x2		/* absolute, n_sect == NO_SECT */
+#define	N_SECT	0xe		/* defined in section number n_sect */
+#define	N_PBUD	0xc		/* prebound undefined (defined in a dylib) */
+#define	N_INDR	0xa		/* indirect */
+
+/*
+ * For undefined symbols in two-level namespace images the high 8 bits of
+ * n_desc hold the ordinal of the library the symbol is expected to come from.
+ */
+#define GET_LIBRARY_ORDINAL(n_desc) (((n_desc) >> 8) & 0xff)
+#define SELF_LIBRARY_ORDINAL	0x0
+#define DYNAMIC_LOOKUP_ORDINAL	0xfe
+#define EXECUTABLE_ORDINAL	0xff
+
+/*
+ * Format of a relocation entry of a Mach-O file.  Modified from the 4.3BSD
+ * format.  The modifications from the original format were changing the value
+ * of the r_symbolnum field for "local" (r_extern == 0) relocation entries.
+ * This modification is required to support symbols in an arbitrary number of
+ * sections not just the three sections (text, data and bss) in a 4.3BSD file.
+ * Also the last 4 bits have had the r_type tag added to them.
+ *
+ * r_symbolnum is the symbol table index of the symbol when r_extern is 1,
+ * otherwise it is the ordinal (1-based) of the section the item refers to.
+ */
+struct relocation_info
+{
+	int32_t		r_address;			/*  offset in the section to what is being
+										relocated */
+	uint32_t	r_symbolnum	: 24,	/*  symbol index if r_extern == 1 or section
+										ordinal if r_extern == 0 */
+				r_pcrel		: 1,	/*  was relocated pc relative already */
+				r_length	: 2,	/*  0=byte, 1=word, 2=long, 3=quad */
+				r_extern	: 1,	/*  does not include value of sym referenced */
+				r_type		: 4;	/*  if not 0, machine specific relocation type */
+};
+#define	R_ABS	0		/* absolute relocation type for Mach-O files */
+
+/*
+ * When the high bit of r_address is set the entry is really a
+ * scattered_relocation_info.  Scattered entries carry the address of the
+ * item being referenced in r_value instead of a symbol or section ordinal.
+ * Only little endian hosts are supported, so the field order below is the
+ * little endian layout.
+ */
+#define R_SCATTERED 0x80000000	/* mask to be applied to the r_address field
+								   of a relocation_info structure to tell that
+								   is is really a scattered_relocation_info
+								   stucture */
+struct scattered_relocation_info
+{
+	uint32_t	r_address	: 24,	/*  offset in the section to what is being
+										relocated */
+				r_type		: 4,	/*  if not 0, machine specific relocation type */
+				r_length	: 2,	/*  0=byte, 1=word, 2=long, 3=quad */
+				r_pcrel		: 1,	/*  was relocated pc relative already */
+				r_scattered	: 1;	/*  1=scattered, 0=non-scattered (see above) */
+	int32_t		r_value;			/*  the value the item to be relocated is
+										refering to (without any offset added) */
+};
+
+/*
+ * The arm64 cputype and its relocation types, from <mach/machine.h> and
+ * <mach-o/arm64/reloc.h>.  An ARM64_RELOC_ADDEND entry carries a signed 24
+ * bit addend in r_symbolnum for the PAGE21 or PAGEOFF12 entry after it.
+ */
+#define CPU_ARCH_ABI64	0x01000000
+#define CPU_TYPE_ARM	((cpu_type_t) 12)
+#define CPU_TYPE_ARM64	(CPU_TYPE_ARM | CPU_ARCH_ABI64)
+
+enum reloc_type_arm64
+{
+	ARM64_RELOC_UNSIGNED,				/* for pointers */
+	ARM64_RELOC_SUBTRACTOR,				/* must be followed by a ARM64_RELOC_UNSIGNED */
+	ARM64_RELOC_BRANCH26,				/* a B/BL instruction with 26-bit displacement */
+	ARM64_RELOC_PAGE21,					/* pc-rel distance to page of target */
+	ARM64_RELOC_PAGEOFF12,				/* offset within page, scaled by r_length */
+	ARM64_RELOC_GOT_LOAD_PAGE21,		/* pc-rel distance to page of GOT slot */
+	ARM64_RELOC_GOT_LOAD_PAGEOFF12,		/* offset within page of GOT slot, scaled by r_length */
+	ARM64_RELOC_POINTER_TO_GOT,			/* for pointers to GOT slots */
+	ARM64_RELOC_TLVP_LOAD_PAGE21,		/* pc-rel distance to page of TLVP slot */
+	ARM64_RELOC_TLVP_LOAD_PAGEOFF12,	/* offset within page of TLVP slot, scaled by r_length */
+	ARM64_RELOC_ADDEND					/* must be followed by PAGE21 or PAGEOFF12 */
+};
+
 /*
  * The dyld_info_command contains the file offsets and sizes of
  * the new compressed form of the information dyld needs to
@@ -664,4 +801,63 @@ struct entry_point_command
 #define LC_MAIN					(0x28 | LC_REQ_DYLD)	/* replacement for LC_UNIXTHREAD */
 #define LC_DATA_IN_CODE			0x29					/* table of non-instructions in __text */
 #define LC_SOURCE_VERSION		0x2A					/* source version used to build binary */
-#define LC_DYLIB_CODE_SIGN_DRS	0x2B					/* Code signing DRs copied from linked dylibs */
\ No newline at end of file
+#define LC_DYLIB_CODE_SIGN_DRS	0x2B					/* Code signing DRs copied from linked dylibs */
+#define LC_DYLD_EXPORTS_TRIE	(0x33 | LC_REQ_DYLD)	/* used with linkedit_data_command, payload is trie */
+#define LC_DYLD_CHAINED_FIXUPS	(0x34 | LC_REQ_DYLD)	/* used with linkedit_data_command */
+
+/*
+ * The following are used on the flags byte of a terminal node
+ * in the export information.
+ */
+#define EXPORT_SYMBOL_FLAGS_KIND_MASK				0x03
+#define EXPORT_SYMBOL_FLAGS_KIND_REGULAR			0x00
+#define EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL		0x01
+#define EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE			0x02
+#define EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION			0x04
+#define EXPORT_SYMBOL_FLAGS_REEXPORT				0x08
+#define EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER		0x10
+#define EXPORT_SYMBOL_FLAGS_STATIC_RESOLVER			0x20
+
+/*
+ * The flags field of a section structure is separated into two parts a section
+ * type and section attributes.  The section types are mutually exclusive (it
+ * can only have one type) but the section attributes are not (it may have more
+ * than one attribute).
+ */
+#define SECTION_TYPE		 0x000000ff	/* 256 section types */
+#define SECTION_ATTRIBUTES	 0xffffff00	/*  24 section attributes */
+
+/* Constants for the type of a section */
+#define	S_REGULAR						0x0		/* regular section */
+#define	S_ZEROFILL						0x1		/* zero fill on demand section */
+#define	S_CSTRING_LITERALS				0x2		/* section with only literal C strings*/
+#define	S_4BYTE_LITERALS				0x3		/* section with only 4 byte literals */
+#define	S_8BYTE_LITERALS				0x4		/* section with only 8 byte literals */
+#define	S_LITERAL_POINTERS				0x5		/* section with only pointers to literals */
+#define	S_NON_LAZY_SYMBOL_POINTERS		0x6		/* section with only non-lazy symbol pointers */
+#define	S_LAZY_SYMBOL_POINTERS			0x7		/* section with only lazy symbol pointers */
+#define	S_SYMBOL_STUBS					0x8		/* section with only symbol stubs, byte size
+												   of stub in the reserved2 field */
+#define	S_MOD_INIT_FUNC_POINTERS		0x9		/* section with only function pointers for
+												   initialization*/
+#define	S_MOD_TERM_FUNC_POINTERS		0xa		/* section with only function pointers for
+												   termination */
+#define	S_COALESCED						0xb		/* section contains symbols that are to be
+												   coalesced */
+#define	S_GB_ZEROFILL					0xc		/* zero fill on demand section (that can be
+												   larger than 4 gigabytes) */
+#define	S_INTERPOSING					0xd		/* section with only pairs of function pointers
+												   for interposing */
+#define	S_16BYTE_LITERALS				0xe		/* section with only 16 byte literals */
+#define	S_DTRACE_DOF					0xf		/* section contains DTrace Object Format */
+#define	S_LAZY_DYLIB_SYMBOL_POINTERS	0x10	/* section with only lazy symbol pointers to
+												   lazy loaded dylibs */
+#define S_THREAD_LOCAL_REGULAR					0x11	/* template of initial values for TLVs */
+#define S_THREAD_LOCAL_ZEROFILL					0x12	/* template of initial values for TLVs */
+#define S_THREAD_LOCAL_VARIABLES				0x13	/* TLV descriptors */
+#define S_THREAD_LOCAL_VARIABLE_POINTERS		0x14	/* pointers to TLV descriptors */
+#define S_THREAD_LOCAL_INIT_FUNCTION_POINTERS	0x15	/* functions to call to initialize TLV values */
+
+/* Symbols with a n_sect field of NO_SECT are not in any section */
+#define	NO_SECT		0		/* symbol is not in any section */
+#define MAX_SECT	255		/* 1 thru 255 inclusive */
\ No newline at end of file
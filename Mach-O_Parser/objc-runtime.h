@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * On-disk layout of the Objective-C 2.0 metadata the compiler emits into the
+ * __objc_* sections of 64-bit images.  Every pointer field holds a vmaddr,
+ * which the image's rebase information (or its chained fixups) may encode,
+ * so readers resolve them rather than using the stored value directly.
+ */
+
+/* __objc_classlist and __objc_nlclslist point at these, isa points at the metaclass */
+struct objc_class_64
+{
+    uint64_t    isa;
+    uint64_t    superclass;
+    uint64_t    cache;
+    uint64_t    vtable;
+    uint64_t    data;           /*  class_ro_64, the low bits are Swift and runtime flags */
+};
+
+#define FAST_DATA_MASK  0x00007ffffffffff8ULL
+
+struct class_ro_64
+{
+    uint32_t    flags;          /*  RO_* */
+    uint32_t    instanceStart;
+    uint32_t    instanceSize;
+    uint32_t    reserved;
+    uint64_t    ivarLayout;
+    uint64_t    name;
+    uint64_t    baseMethods;    /*  method_list_64 */
+    uint64_t    baseProtocols;  /*  protocol_list_64 */
+    uint64_t    ivars;
+    uint64_t    weakIvarLayout;
+    uint64_t    baseProperties;
+};
+
+#define RO_META         (1<<0)
+#define RO_ROOT         (1<<1)
+
+/* header of every method, ivar and property list, entries follow it */
+struct entsize_list_64
+{
+    uint32_t    entsizeAndFlags;
+    uint32_t    count;
+};
+
+/* method lists keep flags in the high half and the low bits of entsizeAndFlags */
+#define METHOD_LIST_FLAGS_MASK              0xffff0003
+#define METHOD_LIST_IS_RELATIVE             0x80000000  /*  entries are method_relative */
+#define METHOD_LIST_SELECTORS_ARE_DIRECT    0x40000000  /*  relative names are offsets from the shared cache selector base */
+
+struct method_64
+{
+    uint64_t    name;           /*  SEL, pointer to the selector string */
+    uint64_t    types;
+    uint64_t    imp;
+};
+
+/* each offset is relative to the address of the field holding it */
+struct method_relative
+{
+    int32_t     nameOffset;     /*  to a selector reference, which points at the selector string */
+    int32_t     typesOffset;
+    int32_t     impOffset;
+};
+
+struct protocol_list_64
+{
+    uint64_t    count;
+    uint64_t    list[1];        /*  protocol_64 pointers */
+};
+
+struct protocol_64
+{
+    uint64_t    isa;
+    uint64_t    name;
+    uint64_t    protocols;
+    uint64_t    instanceMethods;
+    uint64_t    classMethods;
+    uint64_t    optionalInstanceMethods;
+    uint64_t    optionalClassMethods;
+    uint64_t    instanceProperties;
+    uint32_t    size;
+    uint32_t    flags;
+};
+
+/* __objc_catlist points at these */
+struct category_64
+{
+    uint64_t    name;
+    uint64_t    cls;
+    uint64_t    instanceMethods;
+    uint64_t    classMethods;
+    uint64_t    protocols;
+    uint64_t    instanceProperties;
+};